@@ -8,10 +8,14 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "esp_attr.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "spi_arbiter.h"
 
 /*******************************************************************************/
 /*                                   MACROS                                     */
@@ -19,9 +23,13 @@
 
 #define LIS2DH12TR_LOG_TAG ("LIS2DH12TR")
 
-#define LIS2DH12TR_SPI_freqeuncy  (1000000)
+#ifndef LIS2DH12TR_SPI_freqeuncy
+#define LIS2DH12TR_SPI_freqeuncy (8000000) // Sensor supports up to 10 MHz
+#endif
 #define LIS2DH12TR_SPI_IO_NUM     (13)
-#define LIS2DH12TR_SPI_QUEUE_SIZE (1)
+#define LIS2DH12TR_SPI_QUEUE_SIZE (1) // Only one FIFO burst is in flight at a time
+
+#define LIS2DH12TR_SAMPLE_BYTES (6) // OUT_X_L .. OUT_Z_H
 
 /*******************************************************************************/
 /*                                 DATA TYPES                                  */
@@ -57,6 +65,23 @@ int32_t _lsi2dh12_core_write(void *handle, uint8_t Reg, const uint8_t *Bufp, uin
  */
 int32_t _lsi2dh12_core_read(void *handle, uint8_t Reg, uint8_t *Bufp, uint16_t len);
 
+/**
+ * @brief
+ * Internal function that converts one little-endian raw sample into G-s
+ * 
+ * @param raw Pointer to the 6 output bytes of a single sample (X_L, X_H, Y_L, Y_H, Z_L, Z_H)
+ * @param acc_output Reference to a structure with the x,y,z accelerations stored in terms of G-s
+ */
+static void _lis2dh12_raw_to_acc(const uint8_t *raw, LIS2DH12TR_accelerations *acc_output);
+
+/**
+ * @brief
+ * SPI post-transaction callback, runs in the driver ISR and signals the end of a FIFO burst
+ * 
+ * @param trans Transaction that has just completed
+ */
+static void _lis2dh12_spi_post_cb(spi_transaction_t *trans);
+
 /*******************************************************************************/
 /*                          STATIC DATA & CONSTANTS                            */
 /*******************************************************************************/
@@ -77,6 +102,26 @@ static spi_device_handle_t _esp_spi_hdev;
 
 static bool isInitialized = false;
 
+/**
+ * @brief 
+ * DMA receive buffer for FIFO bursts, large enough to hold the whole sensor FIFO
+ */
+static WORD_ALIGNED_ATTR DMA_ATTR uint8_t _fifo_burst_buffer[LIS2DH12TR_FIFO_SIZE * LIS2DH12TR_SAMPLE_BYTES];
+
+/**
+ * @brief 
+ * Transaction descriptor of the queued FIFO burst, it must stay valid until the burst is finished
+ */
+static spi_transaction_t _fifo_burst_transaction;
+
+static bool _fifo_burst_pending = false;
+
+/**
+ * @brief 
+ * Given from the SPI post callback once the queued FIFO burst has completed
+ */
+static SemaphoreHandle_t _fifo_burst_done = NULL;
+
 /*******************************************************************************/
 /*                                 GLOBAL DATA                                 */
 /*******************************************************************************/
@@ -95,9 +140,15 @@ LIS2DH12TR_init_status LIS2DH12TR_init() {
             .queue_size                                                     = LIS2DH12TR_SPI_QUEUE_SIZE,
             .flags                                                          = 0,
             .pre_cb                                                         = NULL,
-            .post_cb                                                        = NULL,
+            .post_cb                                                        = _lis2dh12_spi_post_cb,
             .address_bits                                                   = 8 };
 
+        _fifo_burst_done = xSemaphoreCreateBinary();
+        if(_fifo_burst_done == NULL) {
+            ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to create the FIFO burst semaphore");
+            return LIS2DH12TR_SPI_ERROR;
+        }
+
         ESP_ERROR_CHECK(spi_bus_add_device(VSPI_HOST, &spi_device_config, &_esp_spi_hdev));
 
         _lsi2dh12_core_ctx.write_reg = _lsi2dh12_core_write;
@@ -150,14 +201,262 @@ LIS2DH12TR_reading_status LIS2DH12TR_read_acc(LIS2DH12TR_accelerations *acc_outp
     }
 }
 
+LIS2DH12TR_init_status LIS2DH12TR_fifo_enable(uint8_t watermark) {
+    if(watermark == 0 || watermark >= LIS2DH12TR_FIFO_SIZE) {
+        watermark = LIS2DH12TR_FIFO_SIZE - 1;
+    }
+
+    // Go through bypass mode first so that any stale FIFO content gets discarded
+    if(lis2dh12_fifo_mode_set(&_lsi2dh12_core_ctx, LIS2DH12_BYPASS_MODE) != 0
+            || lis2dh12_fifo_watermark_set(&_lsi2dh12_core_ctx, watermark) != 0
+            || lis2dh12_fifo_set(&_lsi2dh12_core_ctx, PROPERTY_ENABLE) != 0
+            || lis2dh12_fifo_mode_set(&_lsi2dh12_core_ctx, LIS2DH12_DYNAMIC_STREAM_MODE) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to configure the FIFO");
+        return LIS2DH12TR_SPI_ERROR;
+    }
+
+    ESP_LOGI(LIS2DH12TR_LOG_TAG, "FIFO enabled in stream mode, watermark: %hhu", watermark);
+    return LIS2DH12TR_OK;
+}
+
+LIS2DH12TR_reading_status LIS2DH12TR_fifo_level(uint8_t *level) {
+    *level = 0;
+
+    lis2dh12_fifo_src_reg_t fifo_src;
+    if(lis2dh12_fifo_status_get(&_lsi2dh12_core_ctx, &fifo_src) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Error while obtaining FIFO status from the device...");
+        return LIS2DH12TR_READING_ERROR;
+    }
+
+    // FSS saturates at 31, the overrun flag tells that all 32 slots are occupied
+    if(fifo_src.ovrn_fifo) {
+        *level = LIS2DH12TR_FIFO_SIZE;
+    } else if(!fifo_src.empty) {
+        *level = fifo_src.fss;
+    }
+
+    return *level ? LIS2DH12TR_READING_OK : LIS2DH12TR_READING_EMPTY;
+}
+
+LIS2DH12TR_reading_status LIS2DH12TR_fifo_burst_start(uint8_t sample_count) {
+    if(_fifo_burst_pending || sample_count == 0) {
+        return LIS2DH12TR_READING_ERROR;
+    }
+
+    if(sample_count > LIS2DH12TR_FIFO_SIZE) {
+        sample_count = LIS2DH12TR_FIFO_SIZE;
+    }
+
+    // With the FIFO enabled the auto-incremented address wraps from OUT_Z_H back to OUT_X_L,
+    // so every requested sample can be pulled out in one transaction
+    memset(&_fifo_burst_transaction, 0, sizeof(_fifo_burst_transaction));
+    _fifo_burst_transaction.addr      = LIS2DH12_OUT_X_L | 0xC0;
+    _fifo_burst_transaction.length    = 8 * sample_count * LIS2DH12TR_SAMPLE_BYTES;
+    _fifo_burst_transaction.rx_buffer = _fifo_burst_buffer;
+    _fifo_burst_transaction.user      = (void *) (uintptr_t) sample_count;
+
+    // The bus is held until the burst is finished, display chunks are only sent in between
+    spi_arbiter_acquire(SPI_ARBITER_CLIENT_SENSOR);
+    esp_err_t _err_value = spi_device_queue_trans(_esp_spi_hdev, &_fifo_burst_transaction, portMAX_DELAY);
+
+    if(_err_value != ESP_OK) {
+        spi_arbiter_release(SPI_ARBITER_CLIENT_SENSOR);
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to queue the FIFO burst, error cause: %s", esp_err_to_name(_err_value));
+        return LIS2DH12TR_READING_ERROR;
+    }
+
+    _fifo_burst_pending = true;
+    return LIS2DH12TR_READING_OK;
+}
+
+LIS2DH12TR_reading_status LIS2DH12TR_fifo_burst_finish(LIS2DH12TR_accelerations *acc_output, uint8_t *sample_count) {
+    *sample_count = 0;
+
+    if(!_fifo_burst_pending) {
+        return LIS2DH12TR_READING_EMPTY;
+    }
+
+    // The calling task sleeps until the post callback reports the end of the DMA transfer. The driver
+    // queues the result right after the callback in the same ISR, so collecting it does not wait.
+    xSemaphoreTake(_fifo_burst_done, portMAX_DELAY);
+
+    spi_transaction_t *done;
+    esp_err_t _err_value = spi_device_get_trans_result(_esp_spi_hdev, &done, portMAX_DELAY);
+    _fifo_burst_pending  = false;
+    spi_arbiter_release(SPI_ARBITER_CLIENT_SENSOR);
+
+    if(_err_value != ESP_OK) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "FIFO burst failed, error cause: %s", esp_err_to_name(_err_value));
+        return LIS2DH12TR_READING_ERROR;
+    }
+
+    uint8_t count = (uint8_t) (uintptr_t) done->user;
+    for(uint8_t i = 0; i < count; i++) {
+        _lis2dh12_raw_to_acc(&_fifo_burst_buffer[i * LIS2DH12TR_SAMPLE_BYTES], &acc_output[i]);
+    }
+
+    *sample_count = count;
+    return LIS2DH12TR_READING_OK;
+}
+
+LIS2DH12TR_reading_status LIS2DH12TR_read_fifo(LIS2DH12TR_accelerations *acc_output,
+        uint8_t max_samples,
+        uint8_t *sample_count) {
+    *sample_count = 0;
+
+    uint8_t level;
+    LIS2DH12TR_reading_status status = LIS2DH12TR_fifo_level(&level);
+    if(status != LIS2DH12TR_READING_OK) {
+        return status;
+    }
+
+    if(level > max_samples) {
+        level = max_samples;
+    }
+
+    status = LIS2DH12TR_fifo_burst_start(level);
+    if(status != LIS2DH12TR_READING_OK) {
+        return status;
+    }
+
+    return LIS2DH12TR_fifo_burst_finish(acc_output, sample_count);
+}
+
+LIS2DH12TR_init_status LIS2DH12TR_int1_enable(LIS2DH12TR_int1_source source) {
+    lis2dh12_ctrl_reg3_t ctrl_reg3;
+
+    if(lis2dh12_pin_int1_config_get(&_lsi2dh12_core_ctx, &ctrl_reg3) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to read the INT1 configuration");
+        return LIS2DH12TR_SPI_ERROR;
+    }
+
+    ctrl_reg3.i1_zyxda = (source == LIS2DH12TR_INT1_DATA_READY) ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+    ctrl_reg3.i1_wtm   = (source == LIS2DH12TR_INT1_FIFO_WATERMARK) ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+
+    if(lis2dh12_pin_int1_config_set(&_lsi2dh12_core_ctx, &ctrl_reg3) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to write the INT1 configuration");
+        return LIS2DH12TR_SPI_ERROR;
+    }
+
+    return LIS2DH12TR_OK;
+}
+
+LIS2DH12TR_init_status LIS2DH12TR_impact_int1_enable(float threshold_g, uint8_t duration_samples) {
+    int32_t threshold_lsb = (int32_t) (threshold_g * 1000.f / LIS2DH12TR_THS_MG + 0.5f);
+    if(threshold_lsb < 1) {
+        threshold_lsb = 1;
+    } else if(threshold_lsb > 127) {
+        threshold_lsb = 127;
+    }
+
+    if(duration_samples > 127) {
+        duration_samples = 127;
+    }
+
+    // Any axis above the threshold (OR combination), gravity removed by the high-pass filter
+    lis2dh12_int1_cfg_t int1_cfg = { 0 };
+    int1_cfg.xhie                = PROPERTY_ENABLE;
+    int1_cfg.yhie                = PROPERTY_ENABLE;
+    int1_cfg.zhie                = PROPERTY_ENABLE;
+
+    lis2dh12_ctrl_reg3_t ctrl_reg3;
+
+    if(lis2dh12_high_pass_mode_set(&_lsi2dh12_core_ctx, LIS2DH12_NORMAL) != 0
+            || lis2dh12_high_pass_int_conf_set(&_lsi2dh12_core_ctx, LIS2DH12_ON_INT1_GEN) != 0
+            || lis2dh12_int1_gen_threshold_set(&_lsi2dh12_core_ctx, (uint8_t) threshold_lsb) != 0
+            || lis2dh12_int1_gen_duration_set(&_lsi2dh12_core_ctx, duration_samples) != 0
+            || lis2dh12_int1_gen_conf_set(&_lsi2dh12_core_ctx, &int1_cfg) != 0
+            || lis2dh12_int1_pin_notification_mode_set(&_lsi2dh12_core_ctx, LIS2DH12_INT1_LATCHED) != 0
+            || lis2dh12_pin_int1_config_get(&_lsi2dh12_core_ctx, &ctrl_reg3) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to configure the impact trigger");
+        return LIS2DH12TR_SPI_ERROR;
+    }
+
+    ctrl_reg3.i1_ia1 = PROPERTY_ENABLE;
+
+    if(lis2dh12_pin_int1_config_set(&_lsi2dh12_core_ctx, &ctrl_reg3) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to route the impact trigger to INT1");
+        return LIS2DH12TR_SPI_ERROR;
+    }
+
+    ESP_LOGI(LIS2DH12TR_LOG_TAG,
+            "Impact trigger armed: %ld mg, %hhu samples",
+            (long) (threshold_lsb * LIS2DH12TR_THS_MG),
+            duration_samples);
+    return LIS2DH12TR_OK;
+}
+
+LIS2DH12TR_reading_status LIS2DH12TR_impact_source_get(bool *triggered) {
+    *triggered = false;
+
+    lis2dh12_int1_src_t int1_src;
+    if(lis2dh12_int1_gen_source_get(&_lsi2dh12_core_ctx, &int1_src) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Error while obtaining INT1 source from the device...");
+        return LIS2DH12TR_READING_ERROR;
+    }
+
+    *triggered = int1_src.ia;
+    return LIS2DH12TR_READING_OK;
+}
+
+LIS2DH12TR_init_status LIS2DH12TR_activity_int2_enable(float threshold_g, uint32_t inactive_ms) {
+    int32_t threshold_lsb = (int32_t) (threshold_g * 1000.f / LIS2DH12TR_THS_MG + 0.5f);
+    if(threshold_lsb < 1) {
+        threshold_lsb = 1;
+    } else if(threshold_lsb > 127) {
+        threshold_lsb = 127;
+    }
+
+    // Sleep delay is (8 * ACT_DUR + 1) / ODR
+    uint32_t samples      = inactive_ms * LIS2DH12TR_ODR_HZ / 1000;
+    uint32_t duration_lsb = samples > 1 ? (samples - 1) / 8 : 0;
+    if(duration_lsb > 255) {
+        duration_lsb = 255;
+    }
+
+    lis2dh12_ctrl_reg6_t ctrl_reg6;
+
+    if(lis2dh12_act_threshold_set(&_lsi2dh12_core_ctx, (uint8_t) threshold_lsb) != 0
+            || lis2dh12_act_timeout_set(&_lsi2dh12_core_ctx, (uint8_t) duration_lsb) != 0
+            || lis2dh12_pin_int2_config_get(&_lsi2dh12_core_ctx, &ctrl_reg6) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to configure the activity detection");
+        return LIS2DH12TR_SPI_ERROR;
+    }
+
+    ctrl_reg6.i2_act = PROPERTY_ENABLE;
+
+    if(lis2dh12_pin_int2_config_set(&_lsi2dh12_core_ctx, &ctrl_reg6) != 0) {
+        ESP_LOGE(LIS2DH12TR_LOG_TAG, "Failed to route the activity state to INT2");
+        return LIS2DH12TR_SPI_ERROR;
+    }
+
+    ESP_LOGI(LIS2DH12TR_LOG_TAG,
+            "Activity detection enabled: %ld mg, sleep after %lu ms",
+            (long) (threshold_lsb * LIS2DH12TR_THS_MG),
+            (unsigned long) ((8 * duration_lsb + 1) * 1000 / LIS2DH12TR_ODR_HZ));
+    return LIS2DH12TR_OK;
+}
+
 /*******************************************************************************/
 /*                             PRIVATE FUNCTIONS                               */
 /*******************************************************************************/
 
+static void _lis2dh12_raw_to_acc(const uint8_t *raw, LIS2DH12TR_accelerations *acc_output) {
+    int16_t x = (int16_t) ((raw[1] << 8) | raw[0]);
+    int16_t y = (int16_t) ((raw[3] << 8) | raw[2]);
+    int16_t z = (int16_t) ((raw[5] << 8) | raw[4]);
+
+    acc_output->x_acc = lis2dh12_from_fs8_hr_to_mg(x) / 1000.f;
+    acc_output->y_acc = lis2dh12_from_fs8_hr_to_mg(y) / 1000.f;
+    acc_output->z_acc = lis2dh12_from_fs8_hr_to_mg(z) / 1000.f;
+}
+
 int32_t _lsi2dh12_core_write(void *handle, uint8_t Reg, const uint8_t *Bufp, uint16_t len) {
     spi_transaction_t spi_tranaction = { .addr = Reg | 0x60, .tx_buffer = Bufp, .length = 8 * len };
 
+    spi_arbiter_acquire(SPI_ARBITER_CLIENT_SENSOR);
     esp_err_t _err_value = spi_device_polling_transmit(*(spi_device_handle_t *) handle, &spi_tranaction);
+    spi_arbiter_release(SPI_ARBITER_CLIENT_SENSOR);
 
     if(_err_value != ESP_OK) {
         ESP_LOGE(LIS2DH12TR_LOG_TAG,
@@ -172,7 +471,9 @@ int32_t _lsi2dh12_core_write(void *handle, uint8_t Reg, const uint8_t *Bufp, uin
 int32_t _lsi2dh12_core_read(void *handle, uint8_t Reg, uint8_t *Bufp, uint16_t len) {
     spi_transaction_t spi_tranaction = { .addr = Reg | 0xC0, .rx_buffer = Bufp, .rxlength = 0, .length = 8 * len };
 
+    spi_arbiter_acquire(SPI_ARBITER_CLIENT_SENSOR);
     esp_err_t _err_value = spi_device_polling_transmit(*(spi_device_handle_t *) handle, &spi_tranaction);
+    spi_arbiter_release(SPI_ARBITER_CLIENT_SENSOR);
 
     if(_err_value != ESP_OK) {
         ESP_LOGE(LIS2DH12TR_LOG_TAG,
@@ -187,3 +488,14 @@ int32_t _lsi2dh12_core_read(void *handle, uint8_t Reg, uint8_t *Bufp, uint16_t l
 /*******************************************************************************/
 /*                             INTERRUPT HANDLERS                              */
 /*******************************************************************************/
+
+static void IRAM_ATTR _lis2dh12_spi_post_cb(spi_transaction_t *trans) {
+    // Register accesses go through the same device but are polled, only the queued burst is signalled
+    if(trans != &_fifo_burst_transaction) {
+        return;
+    }
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(_fifo_burst_done, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
@@ -5,10 +5,18 @@
 /*                                  INCLUDES                                    */
 /*******************************************************************************/
 
+#include <stdbool.h>
+#include <stdint.h>
+
 /*******************************************************************************/
 /*                                   MACROS                                    */
 /*******************************************************************************/
 
+#define LIS2DH12TR_ODR_HZ       (100) // Output data rate configured by LIS2DH12TR_init()
+#define LIS2DH12TR_SLEEP_ODR_HZ (10)  // Low-power ODR the sensor drops to while inactive
+#define LIS2DH12TR_FIFO_SIZE    (32)  // Depth of the on-chip FIFO in samples
+#define LIS2DH12TR_THS_MG       (62)  // Interrupt threshold LSB at the configured 8 g full scale
+
 /*******************************************************************************/
 /*                                 DATA TYPES                                  */
 /*******************************************************************************/
@@ -25,6 +33,11 @@ typedef enum {
     LIS2DH12TR_READING_OK
 } LIS2DH12TR_reading_status;
 
+typedef enum {
+    LIS2DH12TR_INT1_DATA_READY,    // New X/Y/Z sample available (i1_zyxda)
+    LIS2DH12TR_INT1_FIFO_WATERMARK // FIFO level reached the watermark (i1_wtm)
+} LIS2DH12TR_int1_source;
+
 typedef struct {
     float x_acc; // Acceleration in X axis [G]
     float y_acc; // Acceleration in Y axis [G]
@@ -57,6 +70,118 @@ LIS2DH12TR_init_status LIS2DH12TR_init();
  */
 LIS2DH12TR_reading_status LIS2DH12TR_read_acc(LIS2DH12TR_accelerations *acc_output);
 
+/**
+ * @brief 
+ * Enable the on-chip FIFO in stream mode with the given watermark level.
+ * The sensor keeps buffering samples at full ODR until they are drained
+ * with LIS2DH12TR_read_fifo().
+ * 
+ * @param watermark FIFO level (1 - 31 samples) at which the watermark flag is raised
+ * @return Status of the configuration process
+ */
+LIS2DH12TR_init_status LIS2DH12TR_fifo_enable(uint8_t watermark);
+
+/**
+ * @brief 
+ * Drain the samples queued in the sensor FIFO using a single multi-byte SPI burst.
+ * 
+ * @note
+ * Samples are returned oldest first. LIS2DH12TR_fifo_enable() must be called beforehand.
+ * 
+ * @param acc_output Array that receives the x,y,z accelerations stored in terms of G-s
+ * @param max_samples Capacity of acc_output (at most LIS2DH12TR_FIFO_SIZE samples are read)
+ * @param sample_count Number of samples written into acc_output
+ * @return Status of the reading process (LIS2DH12TR_READING_EMPTY if the FIFO held no samples)
+ */
+LIS2DH12TR_reading_status LIS2DH12TR_read_fifo(LIS2DH12TR_accelerations *acc_output,
+        uint8_t max_samples,
+        uint8_t *sample_count);
+
+/**
+ * @brief 
+ * Read the number of samples currently queued in the sensor FIFO.
+ * 
+ * @param level Number of queued samples (0 - LIS2DH12TR_FIFO_SIZE)
+ * @return Status of the reading process (LIS2DH12TR_READING_EMPTY if the FIFO held no samples)
+ */
+LIS2DH12TR_reading_status LIS2DH12TR_fifo_level(uint8_t *level);
+
+/**
+ * @brief 
+ * Queue a DMA burst that drains the given number of samples from the sensor FIFO and return
+ * immediately. The caller can do other work while the transfer runs.
+ * 
+ * @note
+ * Only one burst can be in flight. No other sensor access is allowed until
+ * LIS2DH12TR_fifo_burst_finish() has been called.
+ * 
+ * @param sample_count Number of samples to drain, usually taken from LIS2DH12TR_fifo_level()
+ * @return Status of the queueing process
+ */
+LIS2DH12TR_reading_status LIS2DH12TR_fifo_burst_start(uint8_t sample_count);
+
+/**
+ * @brief 
+ * Wait for the burst queued by LIS2DH12TR_fifo_burst_start() to complete and convert its samples.
+ * The calling task sleeps on the SPI completion interrupt instead of spinning.
+ * 
+ * @param acc_output Array that receives the x,y,z accelerations, sized for the requested sample count
+ * @param sample_count Number of samples written into acc_output
+ * @return Status of the reading process (LIS2DH12TR_READING_EMPTY if no burst was pending)
+ */
+LIS2DH12TR_reading_status LIS2DH12TR_fifo_burst_finish(LIS2DH12TR_accelerations *acc_output, uint8_t *sample_count);
+
+/**
+ * @brief 
+ * Route the selected event to the INT1 pin (active high).
+ * 
+ * @note
+ * The data-ready line is cleared by reading the output registers, the watermark
+ * line is cleared once the FIFO level drops below the watermark.
+ * 
+ * @param source Event that drives the INT1 pin
+ * @return Status of the configuration process
+ */
+LIS2DH12TR_init_status LIS2DH12TR_int1_enable(LIS2DH12TR_int1_source source);
+
+/**
+ * @brief 
+ * Arm the INT1 inertial event generator as a hardware impact trigger.
+ * The high-pass filtered acceleration on any axis has to exceed the threshold for the
+ * given number of samples. The event is latched and routed to the INT1 pin next to the
+ * source selected with LIS2DH12TR_int1_enable().
+ * 
+ * @param threshold_g Impact threshold in G-s, quantised to LIS2DH12TR_THS_MG steps (1 - 127 LSB)
+ * @param duration_samples Minimum event duration in ODR periods (0 - 127)
+ * @return Status of the configuration process
+ */
+LIS2DH12TR_init_status LIS2DH12TR_impact_int1_enable(float threshold_g, uint8_t duration_samples);
+
+/**
+ * @brief 
+ * Read and clear the latched INT1 inertial event.
+ * 
+ * @param triggered Set to true if the impact threshold was exceeded since the previous call
+ * @return Status of the reading process
+ */
+LIS2DH12TR_reading_status LIS2DH12TR_impact_source_get(bool *triggered);
+
+/**
+ * @brief 
+ * Enable the sleep-to-wake function and report the activity state on the INT2 pin.
+ * Once the acceleration stays below the threshold for the given time the sensor drops to
+ * LIS2DH12TR_SLEEP_ODR_HZ in low-power mode and raises INT2. The first sample above the
+ * threshold returns it to the configured ODR and releases INT2.
+ * 
+ * @note
+ * The FIFO and the INT1 event generator keep running at the low ODR while the sensor sleeps.
+ * 
+ * @param threshold_g Activity threshold in G-s, quantised to LIS2DH12TR_THS_MG steps (1 - 127 LSB)
+ * @param inactive_ms Time below the threshold before the sensor goes to sleep (at most 20.4 s)
+ * @return Status of the configuration process
+ */
+LIS2DH12TR_init_status LIS2DH12TR_activity_int2_enable(float threshold_g, uint32_t inactive_ms);
+
 /*******************************************************************************/
 /*                          PUBLIC FUNCTION PROTOTYPES                         */
 /*******************************************************************************/
@@ -23,7 +23,10 @@
 
 #include "esp_log.h"
 #include "veml7700.h"
+#include "i2c_scheduler.h"
 #include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #define VEML7700_I2C_ADDR UINT8_C(0x10) /*!< Sensor slave I2C address */
 
@@ -63,6 +66,11 @@
 #define VEML7700_GAIN_OPTIONS_COUNT 4 /*!< Possible gain values count */
 #define VEML7700_IT_OPTIONS_COUNT   6 /*!< Possible integration time values count */
 
+#define VEML7700_SATURATION_COUNTS       65535 /*!< Full scale ALS count, the reading is only a lower bound */
+#define VEML7700_RANGE_HEADROOM          2.0f  /*!< Target range maximum relative to the current reading */
+#define VEML7700_RANGE_HIGH_WATER_COUNTS 52428 /*!< 80 % of full scale, more counts call for a coarser range */
+#define VEML7700_RANGE_MIN_COUNTS        1000  /*!< Fewer counts than this call for a finer range */
+
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
 
@@ -71,7 +79,7 @@
  * 
  */
 static const uint8_t gain_values
-        [VEML7700_GAIN_OPTIONS_COUNT] = { VEML7700_GAIN_2, VEML7700_GAIN_1, VEML7700_GAIN_1_8, VEML7700_GAIN_1_4 };
+        [VEML7700_GAIN_OPTIONS_COUNT] = { VEML7700_GAIN_2, VEML7700_GAIN_1, VEML7700_GAIN_1_4, VEML7700_GAIN_1_8 };
 /**
  * @brief List of all possible values for configuring sensor integration time.
  * 
@@ -82,6 +90,11 @@ static const uint8_t integration_time_values[VEML7700_IT_OPTIONS_COUNT] = { VEML
     VEML7700_IT_100MS,
     VEML7700_IT_50MS,
     VEML7700_IT_25MS };
+/**
+ * @brief Integration times in ms, in the order of integration_time_values.
+ * 
+ */
+static const uint16_t integration_time_ms[VEML7700_IT_OPTIONS_COUNT] = { 800, 400, 200, 100, 50, 25 };
 
 /**
  * @brief Proper resolution multipliers mapped to gain-integration time combination.
@@ -96,7 +109,7 @@ static const float resolution_map[VEML7700_IT_OPTIONS_COUNT][VEML7700_GAIN_OPTIO
     { 0.0144, 0.0288, 0.1152, 0.2304 },
     { 0.0288, 0.0576, 0.2304, 0.4608 },
     { 0.0576, 0.1152, 0.4608, 0.9216 },
-    { 9.1152, 0.2304, 0.9216, 1.8432 }
+    { 0.1152, 0.2304, 0.9216, 1.8432 }
 };
 /**
  * @brief Maximum luminocity mapped to gain-integration time combination.
@@ -138,19 +151,20 @@ struct veml7700_privdata_t {
 
 //Forward declarations
 static struct veml7700_config veml7700_get_default_config();
-static esp_err_t veml7700_optimize_configuration(veml7700_handle_t dev, double *lux);
+static esp_err_t veml7700_optimize_configuration(veml7700_handle_t dev, uint16_t counts);
 static uint32_t veml7700_get_current_maximum_lux();
-static uint32_t veml7700_get_lower_maximum_lux(veml7700_handle_t dev, double *lux);
 static uint32_t veml7700_get_lowest_maximum_lux();
 static uint32_t veml7700_get_maximum_lux();
+static void veml7700_predict_range(float required_lux, int *it_index, int *gain_index);
+static void veml7700_wait_integration(veml7700_handle_t dev);
 static int veml7700_get_gain_index(uint8_t gain);
 static int veml7700_get_it_index(uint8_t integration_time);
 static uint8_t indexOf(uint8_t elm, const uint8_t *ar, uint8_t len);
-static void decrease_resolution(veml7700_handle_t dev);
-static void increase_resolution(veml7700_handle_t dev);
 static esp_err_t veml7700_i2c_read_reg(veml7700_handle_t dev, uint8_t reg_addr, uint16_t *reg_data);
 static esp_err_t veml7700_i2c_write_reg(veml7700_handle_t dev, uint8_t reg_addr, uint16_t reg_data);
 static esp_err_t veml7700_send_config(veml7700_handle_t dev);
+static esp_err_t veml7700_read_counts(veml7700_handle_t dev, uint8_t reg_addr, uint16_t *counts);
+static esp_err_t veml7700_read_auto(veml7700_handle_t dev, uint8_t reg_addr, float *lux);
 
 
 /**
@@ -173,80 +187,104 @@ static struct veml7700_config veml7700_get_default_config() {
 }
 
 /**
- * @brief Auto-resolution adjustment algorithm implementation for
- * VEML7700 light sensor.
+ * @brief Predictive auto-resolution algorithm for VEML7700 light sensor.
  * 
- * @note  Does not match official recommended algorithm.
+ * Keeps the current range while the reading sits comfortably inside it. Otherwise
+ * the target range is computed from the reading and configured in one step, a
+ * saturated reading goes straight to the widest range. The decision to keep the
+ * range is made on the raw counts, without any floating point.
  * 
  * @param dev Handle for the device
- * @param lux Luminocity value for which we are optimizing.
+ * @param counts Raw ALS or white count for which we are optimizing.
  * 
- * @return esp_err_t 
+ * @return esp_err_t ESP_OK if the configuration changed, ESP_FAIL if it is already optimal
  */
-static esp_err_t veml7700_optimize_configuration(veml7700_handle_t dev, double *lux) {
-    if(ceil(*lux) >= veml7700_get_current_maximum_lux(dev)) { // Decrease resolution
-        // Make sure we haven't reached the upper luminocity limit
-        if(dev->configuration.maximum_lux == veml7700_get_maximum_lux(dev)) {
+static esp_err_t veml7700_optimize_configuration(veml7700_handle_t dev, uint16_t counts) {
+    uint32_t current_max = dev->configuration.maximum_lux;
+    int it_index, gain_index;
+
+    if(counts >= VEML7700_SATURATION_COUNTS) {
+        if(current_max == veml7700_get_maximum_lux()) {
             ESP_LOGD(VEML7700_TAG, "Already configured for maximum luminocity.");
             return ESP_FAIL;
         }
-        decrease_resolution(dev);
-    } else if(*lux < veml7700_get_lower_maximum_lux(dev, lux)) { // Increase resolution
-        // Make sure this isn't the smallest maximum
-        if(dev->configuration.maximum_lux == veml7700_get_lowest_maximum_lux(dev)) {
-            ESP_LOGD(VEML7700_TAG, "Already configured with maximum resolution.");
+        it_index   = VEML7700_IT_OPTIONS_COUNT - 1;
+        gain_index = VEML7700_GAIN_OPTIONS_COUNT - 1;
+    } else {
+        bool below_high_water = counts < VEML7700_RANGE_HIGH_WATER_COUNTS;
+        bool enough_counts    = counts >= VEML7700_RANGE_MIN_COUNTS || current_max == veml7700_get_lowest_maximum_lux();
+        if(below_high_water && enough_counts) {
+            ESP_LOGD(VEML7700_TAG, "Configuration already optimal.");
             return ESP_FAIL;
         }
-        increase_resolution(dev);
-    } else {
+        float required_lux = counts * dev->configuration.resolution * VEML7700_RANGE_HEADROOM;
+        veml7700_predict_range(required_lux, &it_index, &gain_index);
+    }
+
+    if(integration_time_values[it_index] == dev->configuration.integration_time
+            && gain_values[gain_index] == dev->configuration.gain) {
         ESP_LOGD(VEML7700_TAG, "Configuration already optimal.");
         return ESP_FAIL;
     }
 
-    ESP_LOGD(VEML7700_TAG, "Configuration optimized.");
+    dev->configuration.integration_time = integration_time_values[it_index];
+    dev->configuration.gain             = gain_values[gain_index];
+    if(veml7700_send_config(dev) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGD(VEML7700_TAG, "Configuration optimized, maximum luminocity %" PRIu32 ".", dev->configuration.maximum_lux);
     return ESP_OK;
 }
 
 /**
- * @brief Read the maximum lux for the currentl configuration.
+ * @brief Find the range with the finest resolution that still covers a light level.
  * 
- * @param dev Handle for the device
- * @return uint32_t The maximum lux value.
+ * Of two ranges with the same resolution the shorter integration time wins, its
+ * results arrive sooner.
+ * 
+ * @param required_lux Light level the range maximum must reach.
+ * @param it_index Index of the chosen integration time.
+ * @param gain_index Index of the chosen gain.
  */
-static uint32_t veml7700_get_current_maximum_lux(veml7700_handle_t dev) {
-    int gain_index = veml7700_get_gain_index(dev->configuration.gain);
-    int it_index   = veml7700_get_it_index(dev->configuration.integration_time);
-
-    return maximums_map[it_index][gain_index];
+static void veml7700_predict_range(float required_lux, int *it_index, int *gain_index) {
+    // Widest range unless a finer one fits
+    *it_index   = VEML7700_IT_OPTIONS_COUNT - 1;
+    *gain_index = VEML7700_GAIN_OPTIONS_COUNT - 1;
+
+    for(int it = 0; it < VEML7700_IT_OPTIONS_COUNT; it++) {
+        for(int gain = 0; gain < VEML7700_GAIN_OPTIONS_COUNT; gain++) {
+            if(maximums_map[it][gain] < required_lux)
+                continue;
+            if(resolution_map[it][gain] <= resolution_map[*it_index][*gain_index]) {
+                *it_index   = it;
+                *gain_index = gain;
+            }
+        }
+    }
 }
 
 /**
- * @brief Get the next smallest maximum lux limit value.
- * 
- * Used to identify if a better range is possible for the current 
- * light levels.
+ * @brief Block until a result of the current configuration is available.
  * 
  * @param dev Handle for the device
- * @param lux The referent lux value, usually the last result.
+ */
+static void veml7700_wait_integration(veml7700_handle_t dev) {
+    uint32_t it_ms = veml7700_get_integration_time_ms(dev);
+    vTaskDelay(pdMS_TO_TICKS(it_ms + it_ms / 10) + 1);
+}
+
+/**
+ * @brief Read the maximum lux for the currentl configuration.
  * 
- * @return uint32_t The next smallest maximum lux value.
+ * @param dev Handle for the device
+ * @return uint32_t The maximum lux value.
  */
-static uint32_t veml7700_get_lower_maximum_lux(veml7700_handle_t dev, double *lux) {
+static uint32_t veml7700_get_current_maximum_lux(veml7700_handle_t dev) {
     int gain_index = veml7700_get_gain_index(dev->configuration.gain);
     int it_index   = veml7700_get_it_index(dev->configuration.integration_time);
 
-    // Find the next smallest 'maximum' value in the mapped maximum luminocities
-    if((gain_index > 0) && (it_index > 0)) {
-        if(maximums_map[it_index][gain_index - 1] >= maximums_map[it_index - 1][gain_index]) {
-            return maximums_map[it_index][gain_index - 1];
-        } else {
-            return maximums_map[it_index - 1][gain_index];
-        }
-    } else if((gain_index > 0) && (it_index == 0)) {
-        return maximums_map[it_index][gain_index - 1];
-    } else {
-        return maximums_map[it_index - 1][gain_index];
-    }
+    return maximums_map[it_index][gain_index];
 }
 
 /**
@@ -315,73 +353,6 @@ static uint8_t indexOf(uint8_t elm, const uint8_t *ar, uint8_t len) {
     return -1;
 }
 
-/**
- * @brief Decrease either gain and/or integration time in configuration.
- * 
- * @note  Does not match official recommended algorithm.
- * 
- * @param dev Handle for the device
- * @return void 
- */
-static void decrease_resolution(veml7700_handle_t dev) {
-    // Identify the indexes of the currently configured values
-    int gain_index = veml7700_get_gain_index(dev->configuration.gain);
-    int it_index   = veml7700_get_it_index(dev->configuration.integration_time);
-
-    ESP_LOGD(VEML7700_TAG, "Decreasing sensor resolution...\n");
-
-    // If this is the last gain or integration time setting, increment the other property
-    if(gain_index == 3) {
-        dev->configuration.integration_time = integration_time_values[it_index + 1];
-    } else if(it_index == 5) {
-        dev->configuration.gain = gain_values[gain_index + 1];
-    } else {
-        // Check which adjacent value is bigger than the current, but choose the smaller if both are
-        if(resolution_map[it_index + 1][gain_index] > dev->configuration.resolution) {
-            if(resolution_map[it_index + 1][gain_index] <= resolution_map[it_index][gain_index + 1]) {
-                dev->configuration.integration_time = integration_time_values[it_index + 1];
-            }
-        } else if(resolution_map[it_index][gain_index + 1] > dev->configuration.resolution) {
-            if(resolution_map[it_index][gain_index + 1] <= resolution_map[it_index + 1][gain_index]) {
-                dev->configuration.gain = gain_values[gain_index + 1];
-            }
-        } else {
-            ESP_LOGE(VEML7700_TAG, "Failed to decrease sensor resolution.");
-        }
-    }
-
-    // Update the sensor configuration
-    veml7700_send_config(dev);
-}
-
-/**
- * @brief Increase either gain and/or integration time in configuration.
- * 
- * @note Does not match official recommended algorithm.
- * 
- * @param dev Handle for the device
- * @return void 
- */
-static void increase_resolution(veml7700_handle_t dev) {
-    int gain_index = veml7700_get_gain_index(dev->configuration.gain);
-    int it_index   = veml7700_get_it_index(dev->configuration.integration_time);
-
-    if((gain_index > 0) && (it_index > 0)) {
-        if(maximums_map[it_index][gain_index - 1] >= maximums_map[it_index - 1][gain_index]) {
-            dev->configuration.gain = gain_values[gain_index - 1];
-        } else {
-            dev->configuration.integration_time = integration_time_values[it_index - 1];
-        }
-    } else if((gain_index > 0) && (it_index == 0)) {
-        dev->configuration.gain = gain_values[gain_index - 1];
-    } else {
-        dev->configuration.integration_time = integration_time_values[it_index - 1];
-    }
-
-    // Update the sensor configuration
-    veml7700_send_config(dev);
-}
-
 /**
  * @brief I2C register read protocol implementation for VEML7700 IC.
  * 
@@ -410,7 +381,11 @@ static esp_err_t veml7700_i2c_read_reg(veml7700_handle_t dev, uint8_t reg_addr,
     i2c_master_read(cmd, read_data, 2, I2C_MASTER_LAST_NACK);
     i2c_master_stop(cmd);
 
-    espRc = i2c_master_cmd_begin(dev->i2c_master_num, cmd, 2000 / portTICK_PERIOD_MS);
+    espRc = i2c_scheduler_acquire(dev->addr);
+    if(espRc == ESP_OK) {
+        espRc = i2c_master_cmd_begin(dev->i2c_master_num, cmd, 2000 / portTICK_PERIOD_MS);
+        i2c_scheduler_release(dev->addr);
+    }
 
     *reg_data = read_data[0] | (read_data[1] << 8);
     i2c_cmd_link_delete(cmd);
@@ -445,7 +420,11 @@ static esp_err_t veml7700_i2c_write_reg(veml7700_handle_t dev, uint8_t reg_addr,
 
     i2c_master_stop(cmd);
 
-    espRc = i2c_master_cmd_begin(dev->i2c_master_num, cmd, 1000 / portTICK_PERIOD_MS);
+    espRc = i2c_scheduler_acquire(dev->addr);
+    if(espRc == ESP_OK) {
+        espRc = i2c_master_cmd_begin(dev->i2c_master_num, cmd, 1000 / portTICK_PERIOD_MS);
+        i2c_scheduler_release(dev->addr);
+    }
 
     i2c_cmd_link_delete(cmd);
 
@@ -471,6 +450,54 @@ void veml7700_release(veml7700_handle_t dev) {
     free(dev);
 }
 
+/**
+ * @brief Read a raw ALS or white count.
+ * 
+ * @param dev Handle for the device
+ * @param reg_addr VEML7700_ALS_DATA or VEML7700_WHITE_DATA
+ * @param counts The raw count
+ * 
+ * @return esp_err_t 
+ */
+static esp_err_t veml7700_read_counts(veml7700_handle_t dev, uint8_t reg_addr, uint16_t *counts) {
+    esp_err_t i2c_result = veml7700_i2c_read_reg(dev, reg_addr, counts);
+    if(i2c_result != ESP_OK) {
+        ESP_LOGW(VEML7700_TAG, "veml7700_i2c_read() returned %d", i2c_result);
+    }
+    return i2c_result;
+}
+
+/**
+ * @brief Read a count, re-range if needed and convert it to lux with one float multiply.
+ * 
+ * @param dev Handle for the device
+ * @param reg_addr VEML7700_ALS_DATA or VEML7700_WHITE_DATA
+ * @param lux The result in lux.
+ * 
+ * @return esp_err_t 
+ */
+static esp_err_t veml7700_read_auto(veml7700_handle_t dev, uint8_t reg_addr, float *lux) {
+    uint16_t counts;
+    esp_err_t result = veml7700_read_counts(dev, reg_addr, &counts);
+    if(result != ESP_OK)
+        return result;
+
+    ESP_LOGD(VEML7700_TAG, "Configured maximum luminocity: %" PRIu32 "\n", dev->configuration.maximum_lux);
+    ESP_LOGD(VEML7700_TAG, "Configured resolution: %0.4f\n", dev->configuration.resolution);
+
+    // Calculate and automatically reconfigure the optimal sensor configuration
+    if(veml7700_optimize_configuration(dev, counts) == ESP_OK) {
+        // Read again once the new range has integrated a full result
+        veml7700_wait_integration(dev);
+        result = veml7700_read_counts(dev, reg_addr, &counts);
+        if(result != ESP_OK)
+            return result;
+    }
+
+    *lux = counts * dev->configuration.resolution;
+    return ESP_OK;
+}
+
 static esp_err_t veml7700_send_config(veml7700_handle_t dev) {
     uint16_t config_data =
             ((dev->configuration.gain << 11) | (dev->configuration.integration_time << 6) | (dev->configuration.persistance << 4)
@@ -485,68 +512,135 @@ static esp_err_t veml7700_send_config(veml7700_handle_t dev) {
 }
 
 esp_err_t veml7700_set_config(veml7700_handle_t dev, struct veml7700_config *configuration) {
+    // The lookup tables are indexed by these, e.g. a corrupted persisted range must not reach them
+    if(veml7700_get_gain_index(configuration->gain) >= VEML7700_GAIN_OPTIONS_COUNT
+            || veml7700_get_it_index(configuration->integration_time) >= VEML7700_IT_OPTIONS_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
     dev->configuration = *configuration;
     return veml7700_send_config(dev);
 }
 
-esp_err_t veml7700_read_als_lux(veml7700_handle_t dev, double *lux) {
-    esp_err_t i2c_result;
-    uint16_t reg_data;
+void veml7700_get_config(veml7700_handle_t dev, struct veml7700_config *configuration) {
+    *configuration = dev->configuration;
+}
 
-    i2c_result = veml7700_i2c_read_reg(dev, VEML7700_ALS_DATA, &reg_data);
-    if(i2c_result != 0) {
-        ESP_LOGW(VEML7700_TAG, "veml7700_i2c_read() returned %d", i2c_result);
+uint32_t veml7700_get_integration_time_ms(veml7700_handle_t dev) {
+    return integration_time_ms[veml7700_get_it_index(dev->configuration.integration_time)];
+}
+
+esp_err_t veml7700_read_als_lux_f(veml7700_handle_t dev, float *lux) {
+    uint16_t counts;
+    esp_err_t i2c_result = veml7700_read_counts(dev, VEML7700_ALS_DATA, &counts);
+    if(i2c_result != ESP_OK)
         return i2c_result;
-    }
 
-    *lux = reg_data * dev->configuration.resolution;
+    *lux = counts * dev->configuration.resolution;
 
     return ESP_OK;
 }
 
-esp_err_t veml7700_read_als_lux_auto(veml7700_handle_t dev, double *lux) {
-    veml7700_read_als_lux(dev, lux);
+esp_err_t veml7700_read_als_lux_auto_f(veml7700_handle_t dev, float *lux) {
+    return veml7700_read_auto(dev, VEML7700_ALS_DATA, lux);
+}
 
-    ESP_LOGD(VEML7700_TAG, "Configured maximum luminocity: %" PRIu32 "\n", dev->configuration.maximum_lux);
-    ESP_LOGD(VEML7700_TAG, "Configured resolution: %0.4f\n", dev->configuration.resolution);
+esp_err_t veml7700_read_white_lux_f(veml7700_handle_t dev, float *lux) {
+    uint16_t counts;
+    esp_err_t i2c_result = veml7700_read_counts(dev, VEML7700_WHITE_DATA, &counts);
+    if(i2c_result != ESP_OK)
+        return i2c_result;
 
-    // Calculate and automatically reconfigure the optimal sensor configuration
-    esp_err_t optimize = veml7700_optimize_configuration(dev, lux);
-    if(optimize == ESP_OK) {
-        // Read again
-        return veml7700_read_als_lux(dev, lux);
-    }
+    *lux = counts * dev->configuration.resolution;
 
     return ESP_OK;
 }
 
-esp_err_t veml7700_read_white_lux(veml7700_handle_t dev, double *lux) {
-    esp_err_t i2c_result;
-    uint16_t reg_data;
+esp_err_t veml7700_read_white_lux_auto_f(veml7700_handle_t dev, float *lux) {
+    return veml7700_read_auto(dev, VEML7700_WHITE_DATA, lux);
+}
 
-    i2c_result = veml7700_i2c_read_reg(dev, VEML7700_WHITE_DATA, &reg_data);
-    if(i2c_result != 0) {
-        ESP_LOGW(VEML7700_TAG, "veml7700_i2c_read() returned %d", i2c_result);
-        return i2c_result;
-    }
+esp_err_t veml7700_read_als_lux(veml7700_handle_t dev, double *lux) {
+    float value;
+    esp_err_t result = veml7700_read_als_lux_f(dev, &value);
+    if(result == ESP_OK)
+        *lux = value;
+    return result;
+}
 
-    *lux = reg_data * dev->configuration.resolution;
+esp_err_t veml7700_read_als_lux_auto(veml7700_handle_t dev, double *lux) {
+    float value;
+    esp_err_t result = veml7700_read_als_lux_auto_f(dev, &value);
+    if(result == ESP_OK)
+        *lux = value;
+    return result;
+}
 
-    return ESP_OK;
+esp_err_t veml7700_read_white_lux(veml7700_handle_t dev, double *lux) {
+    float value;
+    esp_err_t result = veml7700_read_white_lux_f(dev, &value);
+    if(result == ESP_OK)
+        *lux = value;
+    return result;
 }
 
 esp_err_t veml7700_read_white_lux_auto(veml7700_handle_t dev, double *lux) {
-    veml7700_read_white_lux(dev, lux);
+    float value;
+    esp_err_t result = veml7700_read_white_lux_auto_f(dev, &value);
+    if(result == ESP_OK)
+        *lux = value;
+    return result;
+}
 
-    ESP_LOGD(VEML7700_TAG, "Configured maximum luminocity: %" PRIu32 "\n", dev->configuration.maximum_lux);
-    ESP_LOGD(VEML7700_TAG, "Configured resolution: %0.4f\n", dev->configuration.resolution);
+esp_err_t veml7700_set_als_thresholds(veml7700_handle_t dev, float low_lux, float high_lux) {
+    float resolution = dev->configuration.resolution;
+    float low_count  = floorf(low_lux / resolution);
+    float high_count = ceilf(high_lux / resolution);
 
-    // Calculate and automatically reconfigure the optimal sensor configuration
-    esp_err_t optimize = veml7700_optimize_configuration(dev, lux);
-    if(optimize == ESP_OK) {
-        // Read again
-        return veml7700_read_white_lux(dev, lux);
+    // Saturate at the register range, a window beyond it never fires on that side
+    low_count  = low_count < 0 ? 0 : (low_count > UINT16_MAX ? UINT16_MAX : low_count);
+    high_count = high_count < 0 ? 0 : (high_count > UINT16_MAX ? UINT16_MAX : high_count);
+
+    esp_err_t err = veml7700_i2c_write_reg(dev, VEML7700_ALS_THREHOLD_LOW, (uint16_t) low_count);
+    if(err != ESP_OK)
+        return err;
+
+    return veml7700_i2c_write_reg(dev, VEML7700_ALS_THREHOLD_HIGH, (uint16_t) high_count);
+}
+
+esp_err_t veml7700_set_interrupt(veml7700_handle_t dev, bool enable, uint8_t persistence) {
+    switch(persistence) {
+        case 1:
+            dev->configuration.persistance = VEML7700_PERS_1;
+            break;
+        case 2:
+            dev->configuration.persistance = VEML7700_PERS_2;
+            break;
+        case 4:
+            dev->configuration.persistance = VEML7700_PERS_4;
+            break;
+        case 8:
+            dev->configuration.persistance = VEML7700_PERS_8;
+            break;
+        default:
+            return ESP_ERR_INVALID_ARG;
     }
+    dev->configuration.interrupt_enable = enable;
+
+    return veml7700_send_config(dev);
+}
+
+esp_err_t veml7700_read_interrupt_status(veml7700_handle_t dev, bool *high, bool *low) {
+    uint16_t reg_data;
+
+    esp_err_t i2c_result = veml7700_i2c_read_reg(dev, VEML7700_INTERRUPTSTATUS, &reg_data);
+    if(i2c_result != ESP_OK) {
+        ESP_LOGW(VEML7700_TAG, "veml7700_i2c_read() returned %d", i2c_result);
+        return i2c_result;
+    }
+
+    *high = (reg_data & VEML7700_INTERRUPT_HIGH) != 0;
+    *low  = (reg_data & VEML7700_INTERRUPT_LOW) != 0;
 
     return ESP_OK;
 }
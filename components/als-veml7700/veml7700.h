@@ -18,6 +18,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -79,10 +80,26 @@ void veml7700_release(veml7700_handle_t dev);
  * 
  * @param configuration The configuration to be written.
  * 
- * @return esp_err_t 
+ * @return esp_err_t ESP_ERR_INVALID_ARG for an unknown gain or integration time
  */
 esp_err_t veml7700_set_config(veml7700_handle_t dev, struct veml7700_config *configuration);
 
+/**
+ * @brief Read the active sensor configuration, including ranges picked by auto-ranging.
+ * 
+ * @param dev Device handle to use
+ * @param configuration Where to store the configuration.
+ */
+void veml7700_get_config(veml7700_handle_t dev, struct veml7700_config *configuration);
+
+/**
+ * @brief Read the integration time of the active configuration.
+ * 
+ * @param dev Device handle to use
+ * @return uint32_t Integration time in ms, a new result is available this often.
+ */
+uint32_t veml7700_get_integration_time_ms(veml7700_handle_t dev);
+
 /**
  * @brief Read the ALS data once.
  * 
@@ -97,6 +114,8 @@ esp_err_t veml7700_read_als_lux(veml7700_handle_t dev, double *lux);
  * @brief Read the ALS data once. Optimize resolution if neccessary.
  * 
  * @attention This function alters the sensor configuration as it sees fit.
+ * The target range is predicted from the reading and set in one step, the
+ * call then blocks for one integration time of the new range.
  * 
  * @param dev Device handle to use
  * @param lux The ALS read result in lux.
@@ -127,6 +146,94 @@ esp_err_t veml7700_read_white_lux(veml7700_handle_t dev, double *lux);
  */
 esp_err_t veml7700_read_white_lux_auto(veml7700_handle_t dev, double *lux);
 
+/**
+ * @brief Read the ALS data once, single precision.
+ * 
+ * The ESP32 FPU only handles single precision, prefer the _f variants over
+ * the double ones, which are kept for compatibility and convert the result.
+ * 
+ * @param dev Device handle to use
+ * @param lux The ALS read result in lux.
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t veml7700_read_als_lux_f(veml7700_handle_t dev, float *lux);
+
+/**
+ * @brief Read the ALS data once, single precision. Optimize resolution if neccessary.
+ * 
+ * @attention This function alters the sensor configuration as it sees fit.
+ * 
+ * @param dev Device handle to use
+ * @param lux The ALS read result in lux.
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t veml7700_read_als_lux_auto_f(veml7700_handle_t dev, float *lux);
+
+/**
+ * @brief Read the White light data once, single precision.
+ * 
+ * @param dev Device handle to use
+ * @param lux The White light read result in lux.
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t veml7700_read_white_lux_f(veml7700_handle_t dev, float *lux);
+
+/**
+ * @brief Read the White light data once, single precision. Optimize resolution if neccessary.
+ * 
+ * @attention This function alters the sensor configuration as it sees fit.
+ * 
+ * @param dev Device handle to use
+ * @param lux The White light read result in lux.
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t veml7700_read_white_lux_auto_f(veml7700_handle_t dev, float *lux);
+
+/**
+ * @brief Program the ALS interrupt window.
+ * 
+ * The thresholds are converted to counts with the current resolution, reconfiguring
+ * the gain or integration time afterwards requires programming them again.
+ * 
+ * @param dev Device handle to use
+ * @param low_lux An ALS result below this raises the low interrupt.
+ * @param high_lux An ALS result above this raises the high interrupt.
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t veml7700_set_als_thresholds(veml7700_handle_t dev, float low_lux, float high_lux);
+
+/**
+ * @brief Enable or disable the ALS threshold interrupt.
+ * 
+ * The sensor has no interrupt pin, a crossing is only latched in the interrupt
+ * status register, see veml7700_read_interrupt_status().
+ * 
+ * @param dev Device handle to use
+ * @param enable true to enable the interrupt
+ * @param persistence Consecutive results outside the window before it fires: 1, 2, 4 or 8
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t veml7700_set_interrupt(veml7700_handle_t dev, bool enable, uint8_t persistence);
+
+/**
+ * @brief Read and clear the ALS interrupt status.
+ * 
+ * A single register read, much cheaper than reading and ranging a result.
+ * 
+ * @param dev Device handle to use
+ * @param high Set if the high threshold was crossed.
+ * @param low Set if the low threshold was crossed.
+ * 
+ * @return esp_err_t 
+ */
+esp_err_t veml7700_read_interrupt_status(veml7700_handle_t dev, bool *high, bool *low);
+
 /**
  * @brief Read the currently configured and used sensor resolution.
  * 
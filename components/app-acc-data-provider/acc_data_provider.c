@@ -3,34 +3,330 @@
  * @brief Centralized accelerometer data provider to reduce SPI bus contention
  */
 #include "acc_data_provider.h"
+#include "acc_history.h"
 #include "LIS2DH12TR.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
 #include <math.h>
+#include <stdatomic.h>
+#include <sys/param.h>
 #include <string.h>
 
 #define TAG                 "ACC_DATA_PROVIDER"
 #define ACC_TASK_STACK_SIZE 2048
 #define ACC_TASK_PRIORITY   10 // Higher priority than consumers
 
-// The shared data structure
-static acc_data_t shared_acc_data = { 0 };
+// Event group bit set while the sensor samples at full rate
+#define ACC_ACTIVE_BIT (1 << 0)
 
-// Mutex to protect shared data access
-static SemaphoreHandle_t data_mutex = NULL;
+#if ACC_USE_ACTIVITY && !ACC_USE_INT1
+#error "ACC_USE_ACTIVITY requires ACC_USE_INT1"
+#endif
 
-// Filter coefficient
+// Double-buffered snapshot, the writer fills the slot readers are not pointed at
+static acc_data_t snapshot_buf[2] = { 0 };
+
+// Per-slot write sequence, odd while the provider is filling that slot
+static atomic_uint_fast32_t snapshot_slot_seq[2] = { 0 };
+
+// Publication sequence, its lowest bit selects the slot holding the latest snapshot
+static atomic_uint_fast32_t snapshot_seq = 0;
+
+// Provider task, woken from the INT1 interrupt
+static TaskHandle_t provider_task_handle = NULL;
+
+#if ACC_USE_INT1
+// Impact trigger requested by a consumer, applied from the provider task
+static portMUX_TYPE impact_lock              = portMUX_INITIALIZER_UNLOCKED;
+static bool impact_config_pending            = false;
+static float impact_threshold_g              = 0.0f;
+static uint8_t impact_duration_samples       = 0;
+static acc_impact_callback_t impact_callback = NULL;
+#endif
+
+// Activity state consumers sleep on while the vehicle is parked
+static EventGroupHandle_t activity_events = NULL;
+
+#if ACC_USE_ACTIVITY
+// Sleep-to-wake state, owned by the provider task
+static bool sensor_active            = true;
+static volatile int64_t int2_edge_us = 0;
+static int64_t wake_edge_us          = 0;
+static bool wake_pending             = false;
+static int64_t inactive_since_us     = 0;
+static portMUX_TYPE power_lock       = portMUX_INITIALIZER_UNLOCKED;
+static acc_power_stats_t power_stats = { 0 };
+#endif
+
+// Number of acc_data_get() copies that were torn by a concurrent publish and had to be retried
+static atomic_uint_fast32_t snapshot_read_retries = 0;
+
+// Filter coefficient, chosen so the low-pass keeps a ~0.9 s time constant at the effective sample rate
+#if ACC_ACQUISITION_MODE == ACC_ACQUISITION_FIFO
+#define FILTER_ALPHA 0.989f
+#else
 #define FILTER_ALPHA 0.8f
+#endif
 
-esp_err_t acc_data_provider_init(void) {
-    // Create the mutex
-    data_mutex = xSemaphoreCreateMutex();
-    if(!data_mutex) {
-        ESP_LOGE(TAG, "Failed to create data mutex");
+#if ACC_USE_INT1
+/**
+ * @brief INT1 interrupt handler, wakes the provider task
+ */
+static void IRAM_ATTR acc_int1_isr_handler(void *arg) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    if(provider_task_handle) {
+        vTaskNotifyGiveFromISR(provider_task_handle, &higher_priority_task_woken);
+    }
+
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+/**
+ * @brief Route the sensor event to INT1 and hook the GPIO interrupt
+ */
+static esp_err_t acc_int1_init(void) {
+#if ACC_ACQUISITION_MODE == ACC_ACQUISITION_FIFO
+    LIS2DH12TR_int1_source source = LIS2DH12TR_INT1_FIFO_WATERMARK;
+#else
+    LIS2DH12TR_int1_source source = LIS2DH12TR_INT1_DATA_READY;
+#endif
+
+    if(LIS2DH12TR_int1_enable(source) != LIS2DH12TR_OK) {
+        ESP_LOGE(TAG, "Failed to route LIS2DH12TR interrupt to INT1");
         return ESP_FAIL;
     }
 
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << ACC_INT1_GPIO),
+        .mode         = GPIO_MODE_INPUT,
+        .pull_up_en   = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type    = GPIO_INTR_POSEDGE,
+    };
+
+    esp_err_t err = gpio_config(&io_conf);
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    // The ISR service may already be installed by another driver
+    err = gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
+    if(err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+
+    return gpio_isr_handler_add(ACC_INT1_GPIO, acc_int1_isr_handler, NULL);
+}
+#endif
+
+#if ACC_USE_ACTIVITY
+/**
+ * @brief INT2 interrupt handler, timestamps the activity change and wakes the provider task
+ */
+static void IRAM_ATTR acc_int2_isr_handler(void *arg) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    int2_edge_us = esp_timer_get_time();
+
+    if(provider_task_handle) {
+        vTaskNotifyGiveFromISR(provider_task_handle, &higher_priority_task_woken);
+    }
+
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+/**
+ * @brief Enable the sensor's sleep-to-wake function and hook its INT2 output
+ */
+static esp_err_t acc_int2_init(void) {
+    if(LIS2DH12TR_activity_int2_enable(ACC_ACTIVITY_THRESHOLD_G, ACC_INACTIVITY_TIMEOUT_MS) != LIS2DH12TR_OK) {
+        ESP_LOGE(TAG, "Failed to route LIS2DH12TR activity state to INT2");
+        return ESP_FAIL;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << ACC_INT2_GPIO),
+        .mode         = GPIO_MODE_INPUT,
+        .pull_up_en   = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type    = GPIO_INTR_ANYEDGE,
+    };
+
+    esp_err_t err = gpio_config(&io_conf);
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    // The ISR service is installed by acc_int1_init()
+    return gpio_isr_handler_add(ACC_INT2_GPIO, acc_int2_isr_handler, NULL);
+}
+
+/**
+ * @brief Follow the INT2 level and publish activity changes to the consumers
+ *
+ * @return bool true while the sensor samples at full rate
+ */
+static bool acc_activity_update(void) {
+    bool active = gpio_get_level(ACC_INT2_GPIO) != ACC_INT2_INACTIVE_LEVEL;
+    if(active == sensor_active) {
+        return active;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    sensor_active  = active;
+
+    if(active) {
+        // Without a fresh edge the change was found by the fallback poll, measure from now
+        wake_edge_us = int2_edge_us > inactive_since_us ? int2_edge_us : now_us;
+        wake_pending = true;
+
+        portENTER_CRITICAL(&power_lock);
+        power_stats.inactive_ms += (uint32_t) ((now_us - inactive_since_us) / 1000);
+        portEXIT_CRITICAL(&power_lock);
+
+        xEventGroupSetBits(activity_events, ACC_ACTIVE_BIT);
+        ESP_LOGI(TAG, "Activity detected, back to %d Hz", LIS2DH12TR_ODR_HZ);
+    } else {
+        inactive_since_us = now_us;
+        xEventGroupClearBits(activity_events, ACC_ACTIVE_BIT);
+        ESP_LOGI(TAG, "No activity, sensor sleeping at %d Hz", LIS2DH12TR_SLEEP_ODR_HZ);
+    }
+
+    return active;
+}
+
+/**
+ * @brief Record the latency of a wake-up once the first full-rate samples are published
+ */
+static void acc_activity_wake_complete(void) {
+    uint32_t latency_us = (uint32_t) (esp_timer_get_time() - wake_edge_us);
+    bool over_budget    = latency_us > ACC_WAKE_LATENCY_BUDGET_MS * 1000;
+
+    wake_pending = false;
+
+    portENTER_CRITICAL(&power_lock);
+    power_stats.wake_count++;
+    power_stats.last_wake_us = latency_us;
+    if(latency_us > power_stats.max_wake_us) {
+        power_stats.max_wake_us = latency_us;
+    }
+    if(over_budget) {
+        power_stats.over_budget++;
+    }
+    portEXIT_CRITICAL(&power_lock);
+
+    if(over_budget) {
+        ESP_LOGW(TAG, "Wake-up took %lu us, budget is %d ms", (unsigned long) latency_us, ACC_WAKE_LATENCY_BUDGET_MS);
+    }
+}
+#endif
+
+#if ACC_ACQUISITION_MODE == ACC_ACQUISITION_FIFO
+/**
+ * @brief Capture time of a FIFO sample, counted back from the newest one
+ *
+ * Right after a wake-up the FIFO still holds the samples the sensor took at its sleep ODR
+ * up to the INT2 edge, those are spaced by the sleep period instead of the full-rate one.
+ *
+ * @param newest_us Capture time of the newest sample in the FIFO
+ * @param age Number of samples between this one and the newest
+ * @return int64_t Capture time in microseconds
+ */
+static int64_t acc_fifo_sample_time(int64_t newest_us, uint32_t age) {
+    int64_t age_us = (int64_t) age * 1000000 / LIS2DH12TR_ODR_HZ;
+
+#if ACC_USE_ACTIVITY
+    if(wake_pending && newest_us - age_us < wake_edge_us) {
+        uint32_t full_rate = (uint32_t) ((newest_us - wake_edge_us) * LIS2DH12TR_ODR_HZ / 1000000) + 1;
+        return wake_edge_us - (int64_t) (age - full_rate) * 1000000 / LIS2DH12TR_SLEEP_ODR_HZ;
+    }
+#endif
+
+    return newest_us - age_us;
+}
+#endif
+
+#if ACC_USE_INT1
+/**
+ * @brief Program a pending impact trigger configuration, runs in the provider task
+ */
+static void acc_impact_apply_config(void) {
+    portENTER_CRITICAL(&impact_lock);
+    bool pending          = impact_config_pending;
+    float threshold_g     = impact_threshold_g;
+    uint8_t duration      = impact_duration_samples;
+    impact_config_pending = false;
+    portEXIT_CRITICAL(&impact_lock);
+
+    if(pending && LIS2DH12TR_impact_int1_enable(threshold_g, duration) != LIS2DH12TR_OK) {
+        ESP_LOGE(TAG, "Failed to arm the impact trigger");
+    }
+}
+#endif
+
+/**
+ * @brief Run one raw sample through the filter and derived values, then append it to the history
+ */
+static void acc_data_process_sample(const LIS2DH12TR_accelerations *raw_acc, int64_t capture_us, acc_data_t *data) {
+    // Copy raw values
+    memcpy(&data->raw_acc, raw_acc, sizeof(LIS2DH12TR_accelerations));
+
+    // Apply low-pass filter to each axis
+    data->filtered_acc_x = FILTER_ALPHA * data->filtered_acc_x + (1 - FILTER_ALPHA) * raw_acc->x_acc;
+    data->filtered_acc_y = FILTER_ALPHA * data->filtered_acc_y + (1 - FILTER_ALPHA) * raw_acc->y_acc;
+    data->filtered_acc_z = FILTER_ALPHA * data->filtered_acc_z + (1 - FILTER_ALPHA) * raw_acc->z_acc;
+
+    // Calculate magnitudes
+    data->magnitude = sqrtf(data->filtered_acc_x * data->filtered_acc_x + data->filtered_acc_y * data->filtered_acc_y
+                            + data->filtered_acc_z * data->filtered_acc_z);
+
+    data->magnitude_horizontal =
+            sqrtf(data->filtered_acc_x * data->filtered_acc_x + data->filtered_acc_y * data->filtered_acc_y);
+
+    // Update timestamp and validity
+    data->stamp     = sample_stamp_at(SAMPLE_SOURCE_ACC, capture_us);
+    data->timestamp = sample_stamp_ms(&data->stamp);
+    data->is_valid  = true;
+    data->sample_count++;
+
+    acc_history_push(data);
+}
+
+/**
+ * @brief Copy the processed sample into the shared data structure
+ */
+static void acc_data_publish(const acc_data_t *data) {
+    uint_fast32_t next = atomic_load_explicit(&snapshot_seq, memory_order_relaxed) + 1;
+    uint_fast32_t slot = next & 1;
+    uint_fast32_t seq  = atomic_load_explicit(&snapshot_slot_seq[slot], memory_order_relaxed);
+
+    // Fill the inactive slot with its sequence odd, so a reader still holding it from before the
+    // previous flip rejects the copy, then flip the publication sequence. Never blocks.
+    atomic_store_explicit(&snapshot_slot_seq[slot], seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&snapshot_buf[slot], data, sizeof(acc_data_t));
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&snapshot_slot_seq[slot], seq + 2, memory_order_relaxed);
+    atomic_store_explicit(&snapshot_seq, next, memory_order_release);
+
+    // Debug log (reduced frequency to avoid console flooding)
+    if(data->sample_count % 50 == 0) {
+        ESP_LOGE(TAG,
+                "ACC data: X=%.2f Y=%.2f Z=%.2f Mag=%.2f",
+                data->filtered_acc_x,
+                data->filtered_acc_y,
+                data->filtered_acc_z,
+                data->magnitude);
+    }
+}
+
+esp_err_t acc_data_provider_init(void) {
     // Initialize the accelerometer
     LIS2DH12TR_init_status status = LIS2DH12TR_init();
     if(status != LIS2DH12TR_OK) {
@@ -38,9 +334,43 @@ esp_err_t acc_data_provider_init(void) {
         return ESP_FAIL;
     }
 
+#if ACC_ACQUISITION_MODE == ACC_ACQUISITION_FIFO
+    if(LIS2DH12TR_fifo_enable(ACC_FIFO_WATERMARK) != LIS2DH12TR_OK) {
+        ESP_LOGE(TAG, "Failed to enable LIS2DH12TR FIFO");
+        return ESP_FAIL;
+    }
+#endif
+
+#if ACC_USE_INT1
+    if(acc_int1_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up INT1 wake-up");
+        return ESP_FAIL;
+    }
+#endif
+
+#if ACC_USE_ACTIVITY
+    if(acc_int2_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up INT2 activity detection");
+        return ESP_FAIL;
+    }
+#endif
+
+    if(activity_events == NULL) {
+        activity_events = xEventGroupCreate();
+        if(activity_events == NULL) {
+            ESP_LOGE(TAG, "Failed to create activity event group");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xEventGroupSetBits(activity_events, ACC_ACTIVE_BIT);
+
     // Initialize shared data
-    memset(&shared_acc_data, 0, sizeof(acc_data_t));
-    shared_acc_data.is_valid = false;
+    memset(snapshot_buf, 0, sizeof(snapshot_buf));
+    atomic_store(&snapshot_slot_seq[0], 0);
+    atomic_store(&snapshot_slot_seq[1], 0);
+    atomic_store(&snapshot_seq, 0);
+    atomic_store(&snapshot_read_retries, 0);
+    acc_history_reset();
 
     ESP_LOGI(TAG, "Accelerometer data provider initialized");
     return ESP_OK;
@@ -51,14 +381,69 @@ esp_err_t acc_data_get(acc_data_t *data) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    if(xSemaphoreTake(data_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-        memcpy(data, &shared_acc_data, sizeof(acc_data_t));
-        xSemaphoreGive(data_mutex);
-        return ESP_OK;
-    } else {
-        ESP_LOGW(TAG, "Timeout getting accelerometer data");
-        return ESP_ERR_TIMEOUT;
+    // The published slot is never the one being written, so a reader that preempted the provider
+    // mid-publish still finds a complete copy. A retry is only needed once the provider has
+    // published again during the copy, which moves the next attempt to the newer slot.
+    while(1) {
+        uint_fast32_t slot = atomic_load_explicit(&snapshot_seq, memory_order_acquire) & 1;
+        uint_fast32_t seq  = atomic_load_explicit(&snapshot_slot_seq[slot], memory_order_acquire);
+        if((seq & 1) == 0) {
+            memcpy(data, &snapshot_buf[slot], sizeof(acc_data_t));
+            atomic_thread_fence(memory_order_acquire);
+
+            // An unchanged even slot sequence means no write overlapped the copy
+            if(atomic_load_explicit(&snapshot_slot_seq[slot], memory_order_relaxed) == seq) {
+                return ESP_OK;
+            }
+        }
+
+        atomic_fetch_add_explicit(&snapshot_read_retries, 1, memory_order_relaxed);
+    }
+}
+
+uint32_t acc_data_get_contention_count(void) {
+    return (uint32_t) atomic_load_explicit(&snapshot_read_retries, memory_order_relaxed);
+}
+
+void acc_data_provider_benchmark(uint32_t iterations) {
+    if(iterations == 0) {
+        return;
+    }
+
+    SemaphoreHandle_t bench_mutex = xSemaphoreCreateMutex();
+    if(!bench_mutex) {
+        ESP_LOGE(TAG, "Failed to create benchmark mutex");
+        return;
+    }
+
+    acc_data_t copy;
+    uint32_t retries_before = acc_data_get_contention_count();
+
+    // Current path: sequence-locked snapshot copy
+    uint32_t start = esp_cpu_get_cycle_count();
+    for(uint32_t i = 0; i < iterations; i++) {
+        acc_data_get(&copy);
+    }
+    uint32_t seqlock_cycles = esp_cpu_get_cycle_count() - start;
+
+    // Previous path: mutex take, copy, give
+    start = esp_cpu_get_cycle_count();
+    for(uint32_t i = 0; i < iterations; i++) {
+        if(xSemaphoreTake(bench_mutex, pdMS_TO_TICKS(10)) == pdTRUE) {
+            memcpy(&copy, &snapshot_buf[0], sizeof(acc_data_t));
+            xSemaphoreGive(bench_mutex);
+        }
     }
+    uint32_t mutex_cycles = esp_cpu_get_cycle_count() - start;
+
+    vSemaphoreDelete(bench_mutex);
+
+    ESP_LOGI(TAG,
+            "Snapshot read benchmark (%lu iterations): seqlock %lu cycles/read, mutex %lu cycles/read, %lu retries",
+            (unsigned long) iterations,
+            (unsigned long) (seqlock_cycles / iterations),
+            (unsigned long) (mutex_cycles / iterations),
+            (unsigned long) (acc_data_get_contention_count() - retries_before));
 }
 
 void acc_data_provider_task(void *pvParameters) {
@@ -67,72 +452,192 @@ void acc_data_provider_task(void *pvParameters) {
 
     ESP_LOGI(TAG, "Accelerometer data provider task started");
 
+    acc_data_t local_data = { 0 };
+#if !ACC_USE_INT1
+    TickType_t last_wake_time = xTaskGetTickCount();
+#endif
+
+#if ACC_ACQUISITION_MODE == ACC_ACQUISITION_FIFO
+    static LIS2DH12TR_accelerations fifo_samples[ACC_FIFO_CHUNK_SAMPLES];
+    uint8_t fifo_count = 0;
+#else
     LIS2DH12TR_accelerations raw_acc = { 0 };
-    acc_data_t local_data            = { 0 };
-    TickType_t last_wake_time        = xTaskGetTickCount();
+#endif
 
     while(1) {
-        // Read accelerometer data
-        LIS2DH12TR_reading_status read_status = LIS2DH12TR_read_acc(&raw_acc);
+#if ACC_USE_INT1
+        bool impact = false;
+
+        acc_impact_apply_config();
+#endif
+
+#if ACC_USE_ACTIVITY
+        // Parked: leave the FIFO and the latched impact alone until the sensor reports activity,
+        // the FIFO keeps the samples leading up to the wake-up
+        if(!acc_activity_update()) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ACC_INACTIVE_POLL_MS));
+            continue;
+        }
+#endif
+
+#if ACC_USE_INT1
+        // Reading the source also releases the latched INT1 line
+        if(impact_callback) {
+            LIS2DH12TR_impact_source_get(&impact);
+        }
+#endif
+
+#if ACC_ACQUISITION_MODE == ACC_ACQUISITION_FIFO
+        // Drain everything the sensor queued since the last wake-up in DMA bursts,
+        // filtering each chunk while the next one is being transferred
+        uint8_t fifo_level                    = 0;
+        LIS2DH12TR_reading_status read_status = LIS2DH12TR_fifo_level(&fifo_level);
 
         if(read_status == LIS2DH12TR_READING_OK) {
-            // Copy raw values
-            memcpy(&local_data.raw_acc, &raw_acc, sizeof(LIS2DH12TR_accelerations));
-
-            // Apply low-pass filter to each axis
-            local_data.filtered_acc_x = FILTER_ALPHA * local_data.filtered_acc_x + (1 - FILTER_ALPHA) * raw_acc.x_acc;
-            local_data.filtered_acc_y = FILTER_ALPHA * local_data.filtered_acc_y + (1 - FILTER_ALPHA) * raw_acc.y_acc;
-            local_data.filtered_acc_z = FILTER_ALPHA * local_data.filtered_acc_z + (1 - FILTER_ALPHA) * raw_acc.z_acc;
-
-            // Calculate magnitudes
-            local_data.magnitude = sqrtf(
-                    local_data.filtered_acc_x * local_data.filtered_acc_x + local_data.filtered_acc_y * local_data.filtered_acc_y
-                    + local_data.filtered_acc_z * local_data.filtered_acc_z);
-
-            local_data.magnitude_horizontal = sqrtf(
-                    local_data.filtered_acc_x * local_data.filtered_acc_x
-                    + local_data.filtered_acc_y * local_data.filtered_acc_y);
-
-            // Update timestamp and validity
-            local_data.timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
-            local_data.is_valid  = true;
-            local_data.sample_count++;
-
-            // Copy to shared data structure with mutex protection
-            if(xSemaphoreTake(data_mutex, pdMS_TO_TICKS(5)) == pdTRUE) {
-                memcpy(&shared_acc_data, &local_data, sizeof(acc_data_t));
-                xSemaphoreGive(data_mutex);
-            } else {
-                ESP_LOGW(TAG, "Mutex timeout when updating shared data");
+            int64_t level_read_us = esp_timer_get_time();
+            uint8_t requested = MIN(fifo_level, ACC_FIFO_CHUNK_SAMPLES);
+            uint8_t index     = 0;
+
+            read_status = LIS2DH12TR_fifo_burst_start(requested);
+
+            while(read_status == LIS2DH12TR_READING_OK && index < fifo_level) {
+                read_status = LIS2DH12TR_fifo_burst_finish(fifo_samples, &fifo_count);
+                if(read_status != LIS2DH12TR_READING_OK) {
+                    break;
+                }
+
+                uint8_t remaining = fifo_level - requested;
+                if(remaining > 0) {
+                    uint8_t next = MIN(remaining, ACC_FIFO_CHUNK_SAMPLES);
+                    if(LIS2DH12TR_fifo_burst_start(next) == LIS2DH12TR_READING_OK) {
+                        requested += next;
+                    }
+                }
+
+                // The newest sample was captured when the level was read, older ones are counted back from it
+                for(uint8_t i = 0; i < fifo_count; i++, index++) {
+                    int64_t capture_us = acc_fifo_sample_time(level_read_us, fifo_level - 1 - index);
+                    acc_data_process_sample(&fifo_samples[i], capture_us, &local_data);
+                }
+
+                if(index >= requested) {
+                    break;
+                }
             }
 
-            // Debug log (reduced frequency to avoid console flooding)
-            if(local_data.sample_count % 50 == 0) {
-                ESP_LOGE(TAG,
-                        "ACC data: X=%.2f Y=%.2f Z=%.2f Mag=%.2f",
-                        local_data.filtered_acc_x,
-                        local_data.filtered_acc_y,
-                        local_data.filtered_acc_z,
-                        local_data.magnitude);
+            if(index > 0) {
+                acc_data_publish(&local_data);
             }
-        } else if(read_status == LIS2DH12TR_READING_ERROR) {
+        }
+#else
+        // Read accelerometer data
+        LIS2DH12TR_reading_status read_status = LIS2DH12TR_read_acc(&raw_acc);
+
+        if(read_status == LIS2DH12TR_READING_OK) {
+            acc_data_process_sample(&raw_acc, esp_timer_get_time(), &local_data);
+            acc_data_publish(&local_data);
+        }
+#endif
+
+        if(read_status == LIS2DH12TR_READING_ERROR) {
             ESP_LOGE(TAG, "Error reading accelerometer data");
         }
 
+#if ACC_USE_ACTIVITY
+        if(wake_pending) {
+            acc_activity_wake_complete();
+        }
+#endif
+
+#if ACC_USE_INT1
+        // Samples up to the event are in the history by now, consumers can confirm on them
+        if(impact) {
+            impact_callback((uint32_t) (esp_timer_get_time() / 1000));
+        }
+#endif
+
+#if ACC_USE_INT1
+        // Sleep until the sensor raises INT1, the timeout only covers a missed edge
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ACC_INT1_TIMEOUT_MS));
+#else
         // Run at a fixed frequency
         vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(ACC_UPDATE_RATE_MS));
+#endif
     }
 }
 
 esp_err_t acc_data_provider_start(void) {
     // Create the accelerometer task
-    BaseType_t result =
-            xTaskCreate(acc_data_provider_task, "acc_provider", ACC_TASK_STACK_SIZE, NULL, ACC_TASK_PRIORITY, NULL);
+    BaseType_t result = xTaskCreate(
+            acc_data_provider_task, "acc_provider", ACC_TASK_STACK_SIZE, NULL, ACC_TASK_PRIORITY, &provider_task_handle);
 
     if(result != pdPASS) {
         ESP_LOGE(TAG, "Failed to create accelerometer data provider task");
         return ESP_FAIL;
     }
 
+    // Debug hook, measures the read path while the provider publishes at full rate
+    if(ACC_BENCHMARK_READS > 0) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        acc_data_provider_benchmark(ACC_BENCHMARK_READS);
+    }
+
     return ESP_OK;
+}
+
+esp_err_t acc_data_provider_set_impact_trigger(float threshold_g, uint32_t duration_ms, acc_impact_callback_t callback) {
+#if ACC_USE_INT1
+    if(threshold_g <= 0.0f || callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t duration_samples = duration_ms * LIS2DH12TR_ODR_HZ / 1000;
+
+    portENTER_CRITICAL(&impact_lock);
+    impact_threshold_g      = threshold_g;
+    impact_duration_samples = duration_samples > 127 ? 127 : (uint8_t) duration_samples;
+    impact_callback         = callback;
+    impact_config_pending   = true;
+    portEXIT_CRITICAL(&impact_lock);
+
+    // Apply right away instead of at the next FIFO watermark
+    if(provider_task_handle) {
+        xTaskNotifyGive(provider_task_handle);
+    }
+
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+bool acc_data_provider_is_active(void) {
+    if(activity_events == NULL) {
+        return true;
+    }
+
+    return (xEventGroupGetBits(activity_events) & ACC_ACTIVE_BIT) != 0;
+}
+
+bool acc_data_provider_wait_active(TickType_t ticks_to_wait) {
+    if(activity_events == NULL) {
+        return true;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(activity_events, ACC_ACTIVE_BIT, pdFALSE, pdTRUE, ticks_to_wait);
+    return (bits & ACC_ACTIVE_BIT) != 0;
+}
+
+void acc_data_provider_get_power_stats(acc_power_stats_t *stats) {
+    if(stats == NULL) {
+        return;
+    }
+
+#if ACC_USE_ACTIVITY
+    portENTER_CRITICAL(&power_lock);
+    memcpy(stats, &power_stats, sizeof(acc_power_stats_t));
+    portEXIT_CRITICAL(&power_lock);
+#else
+    memset(stats, 0, sizeof(acc_power_stats_t));
+#endif
 }
\ No newline at end of file
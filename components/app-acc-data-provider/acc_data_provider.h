@@ -8,7 +8,9 @@
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "driver/gpio.h"
 #include "LIS2DH12TR.h"
+#include "sample_stamp.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,6 +19,50 @@ extern "C" {
 /** @brief Update rate for accelerometer reading in milliseconds */
 #define ACC_UPDATE_RATE_MS 200 // Higher frequency than any consumer needs
 
+/** @brief Accelerometer acquisition modes */
+#define ACC_ACQUISITION_POLLING 0 // One data-ready check and one sample per update period
+#define ACC_ACQUISITION_FIFO    1 // Every sample at full ODR, drained from the sensor FIFO in one SPI burst
+
+/** @brief Selected acquisition mode */
+#define ACC_ACQUISITION_MODE ACC_ACQUISITION_FIFO
+
+/** @brief FIFO watermark in samples, one update period worth of data at full ODR */
+#define ACC_FIFO_WATERMARK (ACC_UPDATE_RATE_MS * LIS2DH12TR_ODR_HZ / 1000)
+
+/** @brief Samples per FIFO burst, the next burst runs on DMA while the previous one is filtered */
+#define ACC_FIFO_CHUNK_SAMPLES 8
+
+/** @brief Wake the provider from the LIS2DH12 INT1 line instead of a fixed timer */
+#define ACC_USE_INT1 1
+
+/** @brief GPIO connected to the LIS2DH12 INT1 pin */
+#define ACC_INT1_GPIO GPIO_NUM_39 // Check schematic if different
+
+/** @brief Fallback wake-up period used when no INT1 edge arrives (e.g. a missed edge) */
+#define ACC_INT1_TIMEOUT_MS (2 * ACC_UPDATE_RATE_MS)
+
+/** @brief Let the sensor drop to its low-power ODR while the vehicle is parked, requires ACC_USE_INT1 */
+#define ACC_USE_ACTIVITY 1
+
+/** @brief GPIO connected to the LIS2DH12 INT2 pin */
+#define ACC_INT2_GPIO GPIO_NUM_5 // Check schematic if different
+
+/** @brief INT2 level while the sensor is asleep */
+#define ACC_INT2_INACTIVE_LEVEL 1
+
+/** @brief Sleep-to-wake configuration */
+#define ACC_ACTIVITY_THRESHOLD_G  0.12f // Acceleration on any axis that wakes the sensor
+#define ACC_INACTIVITY_TIMEOUT_MS 20000 // Quiet time before the sensor goes to sleep (20.4 s max)
+
+/** @brief Longest expected time from the wake-up edge until full-rate samples are published */
+#define ACC_WAKE_LATENCY_BUDGET_MS 20
+
+/** @brief Period the activity state is re-checked while asleep, only covers a missed INT2 edge */
+#define ACC_INACTIVE_POLL_MS 1000
+
+/** @brief Reads per path of acc_data_provider_benchmark() run by acc_data_provider_start(), 0 skips it */
+#define ACC_BENCHMARK_READS 0
+
 /**
  * @brief Shared accelerometer data structure
  */
@@ -27,11 +73,32 @@ typedef struct {
     float filtered_acc_z;             // Filtered Z acceleration
     float magnitude;                  // Total acceleration magnitude
     float magnitude_horizontal;       // Horizontal plane magnitude (X-Y)
-    uint32_t timestamp;               // Timestamp in milliseconds
+    uint32_t timestamp;               // Capture time in milliseconds, same clock as stamp
+    sample_stamp_t stamp;             // Capture time in microseconds and sequence number
     bool is_valid;                    // Whether the data is valid
     uint32_t sample_count;            // Running count of samples taken
 } acc_data_t;
 
+/**
+ * @brief Wake-up latency of the sleep-to-wake transitions
+ */
+typedef struct {
+    uint32_t wake_count;   // Transitions from inactive to active
+    uint32_t last_wake_us; // Latency of the most recent wake-up
+    uint32_t max_wake_us;  // Worst case latency
+    uint32_t over_budget;  // Wake-ups slower than ACC_WAKE_LATENCY_BUDGET_MS
+    uint32_t inactive_ms;  // Total time spent asleep
+} acc_power_stats_t;
+
+/**
+ * @brief Callback invoked from the provider task when the hardware impact trigger fires
+ *
+ * All samples up to the trigger are already in the history when it is called.
+ *
+ * @param timestamp Time of the trigger in milliseconds, same clock as acc_data_t.timestamp
+ */
+typedef void (*acc_impact_callback_t)(uint32_t timestamp);
+
 /**
  * @brief Initialize the accelerometer data provider
  * 
@@ -42,11 +109,28 @@ esp_err_t acc_data_provider_init(void);
 /**
  * @brief Get the latest accelerometer data
  * 
+ * Lock-free: the copy is retried if the provider publishes while it is in progress,
+ * so the caller always receives a consistent snapshot and the provider never waits.
+ * 
  * @param data Pointer to store the acceleration data
  * @return esp_err_t ESP_OK on success
  */
 esp_err_t acc_data_get(acc_data_t *data);
 
+/**
+ * @brief Get the number of snapshot reads that had to be retried due to a concurrent publish
+ * 
+ * @return uint32_t Retry count since initialization
+ */
+uint32_t acc_data_get_contention_count(void);
+
+/**
+ * @brief Measure acc_data_get() against a mutex-protected copy and log the cycles per read
+ * 
+ * @param iterations Number of reads per path
+ */
+void acc_data_provider_benchmark(uint32_t iterations);
+
 /**
  * @brief Start the accelerometer data provider task
  * 
@@ -54,6 +138,44 @@ esp_err_t acc_data_get(acc_data_t *data);
  */
 esp_err_t acc_data_provider_start(void);
 
+/**
+ * @brief Arm the LIS2DH12 INT1 inertial engine as an impact trigger
+ * 
+ * The configuration is applied by the provider task, which owns the sensor. Calling it
+ * again updates the threshold and the callback. Requires ACC_USE_INT1.
+ * 
+ * @param threshold_g High-pass filtered acceleration on any axis that triggers, in g
+ * @param duration_ms Minimum time the threshold has to be exceeded
+ * @param callback Function called when the trigger fires
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_SUPPORTED without INT1 wake-up
+ */
+esp_err_t acc_data_provider_set_impact_trigger(float threshold_g, uint32_t duration_ms, acc_impact_callback_t callback);
+
+/**
+ * @brief Check whether the sensor is sampling at full rate
+ * 
+ * @return bool false while the vehicle is parked and the sensor sleeps
+ */
+bool acc_data_provider_is_active(void);
+
+/**
+ * @brief Block until the sensor is sampling at full rate
+ * 
+ * Consumers call this once they processed the history and the provider reports inactivity,
+ * so they sleep instead of polling an idle history. Returns right away while active.
+ * 
+ * @param ticks_to_wait Maximum time to wait
+ * @return bool true if the sensor is active
+ */
+bool acc_data_provider_wait_active(TickType_t ticks_to_wait);
+
+/**
+ * @brief Get the sleep-to-wake statistics
+ * 
+ * @param stats Pointer to store the statistics
+ */
+void acc_data_provider_get_power_stats(acc_power_stats_t *stats);
+
 /**
  * @brief Accelerometer data provider task
  * 
@@ -0,0 +1,91 @@
+/**
+ * @file acc_history.c
+ * @brief Fixed-capacity history of processed accelerometer samples with per-consumer read cursors
+ *
+ * Single writer (the provider task), any number of readers. The writer never waits:
+ * it fills the next slot and then advances the published sample count. Every reader
+ * owns its cursor, so consumers running at different rates each see every sample once.
+ */
+#include "acc_history.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define ACC_HISTORY_MASK (ACC_HISTORY_CAPACITY - 1)
+
+_Static_assert((ACC_HISTORY_CAPACITY & ACC_HISTORY_MASK) == 0, "ACC_HISTORY_CAPACITY must be a power of two");
+
+static acc_data_t history_buf[ACC_HISTORY_CAPACITY];
+
+// Total number of samples pushed, the next sample goes to slot (history_head & ACC_HISTORY_MASK)
+static atomic_uint_fast32_t history_head = 0;
+
+void acc_history_reset(void) {
+    memset(history_buf, 0, sizeof(history_buf));
+    atomic_store(&history_head, 0);
+}
+
+void acc_history_push(const acc_data_t *data) {
+    uint32_t head = (uint32_t) atomic_load_explicit(&history_head, memory_order_relaxed);
+
+    memcpy(&history_buf[head & ACC_HISTORY_MASK], data, sizeof(acc_data_t));
+    atomic_store_explicit(&history_head, head + 1, memory_order_release);
+}
+
+void acc_history_reader_init(acc_history_reader_t *reader) {
+    reader->cursor   = (uint32_t) atomic_load_explicit(&history_head, memory_order_acquire);
+    reader->overruns = 0;
+}
+
+size_t acc_history_read(acc_history_reader_t *reader, acc_data_t *out, size_t max_samples, uint32_t *dropped) {
+    uint32_t head    = (uint32_t) atomic_load_explicit(&history_head, memory_order_acquire);
+    uint32_t pending = head - reader->cursor;
+    uint32_t lost    = 0;
+
+    // Reader fell behind, skip to the oldest sample still in the buffer
+    if(pending > ACC_HISTORY_CAPACITY) {
+        lost           = pending - ACC_HISTORY_CAPACITY;
+        reader->cursor = head - ACC_HISTORY_CAPACITY;
+        pending        = ACC_HISTORY_CAPACITY;
+    }
+
+    size_t count = pending < max_samples ? pending : max_samples;
+
+    // Copy in at most two chunks, split where the ring wraps
+    size_t start = reader->cursor & ACC_HISTORY_MASK;
+    size_t first = ACC_HISTORY_CAPACITY - start;
+    if(first > count) {
+        first = count;
+    }
+    memcpy(out, &history_buf[start], first * sizeof(acc_data_t));
+    memcpy(out + first, &history_buf[0], (count - first) * sizeof(acc_data_t));
+
+    // The writer may have lapped the oldest copied samples while we were reading them
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t head_after = (uint32_t) atomic_load_explicit(&history_head, memory_order_relaxed);
+    uint32_t torn       = 0;
+    if(count > 0 && head_after - reader->cursor >= ACC_HISTORY_CAPACITY) {
+        torn = head_after - reader->cursor - ACC_HISTORY_CAPACITY + 1;
+        if(torn > count) {
+            torn = count;
+        }
+        memmove(out, out + torn, (count - torn) * sizeof(acc_data_t));
+        count -= torn;
+        lost += torn;
+    }
+
+    reader->cursor += count + torn;
+    reader->overruns += lost;
+
+    if(dropped) {
+        *dropped = lost;
+    }
+
+    return count;
+}
+
+uint32_t acc_history_pending(const acc_history_reader_t *reader) {
+    uint32_t head    = (uint32_t) atomic_load_explicit(&history_head, memory_order_acquire);
+    uint32_t pending = head - reader->cursor;
+
+    return pending > ACC_HISTORY_CAPACITY ? ACC_HISTORY_CAPACITY : pending;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file acc_history.h
+ * @brief Fixed-capacity history of processed accelerometer samples with per-consumer read cursors
+ */
+#ifndef ACC_HISTORY_H
+#define ACC_HISTORY_H
+
+#include "acc_data_provider.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Number of samples kept in the history, must be a power of two */
+#define ACC_HISTORY_CAPACITY 128 // 1.28 s at 100 Hz ODR
+
+/**
+ * @brief Per-consumer read position in the history
+ */
+typedef struct {
+    uint32_t cursor;   // Sequence number of the next sample to read
+    uint32_t overruns; // Total number of samples lost because the reader fell behind
+} acc_history_reader_t;
+
+/**
+ * @brief Reset the history, called by the provider before it starts publishing
+ */
+void acc_history_reset(void);
+
+/**
+ * @brief Append a processed sample, only the provider task may call this
+ *
+ * @param data Sample to append
+ */
+void acc_history_push(const acc_data_t *data);
+
+/**
+ * @brief Attach a reader to the history, it will receive samples pushed from now on
+ *
+ * @param reader Reader state owned by the consumer
+ */
+void acc_history_reader_init(acc_history_reader_t *reader);
+
+/**
+ * @brief Read all samples the reader has not seen yet, oldest first
+ *
+ * If the reader fell more than ACC_HISTORY_CAPACITY samples behind, the oldest
+ * samples are skipped and reported through @p dropped.
+ *
+ * @param reader Reader state owned by the consumer
+ * @param out Buffer for the samples
+ * @param max_samples Capacity of @p out
+ * @param dropped Optional, number of samples lost since the previous call
+ * @return size_t Number of samples written to @p out
+ */
+size_t acc_history_read(acc_history_reader_t *reader, acc_data_t *out, size_t max_samples, uint32_t *dropped);
+
+/**
+ * @brief Number of samples waiting for the reader
+ *
+ * @param reader Reader state owned by the consumer
+ * @return uint32_t Pending sample count, capped at ACC_HISTORY_CAPACITY
+ */
+uint32_t acc_history_pending(const acc_history_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACC_HISTORY_H */
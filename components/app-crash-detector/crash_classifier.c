@@ -0,0 +1,198 @@
+/**
+ * @file crash_classifier.c
+ * @brief Streaming crash severity and impact direction classifier
+ *
+ * Every sample updates three windowed features per axis in O(1) amortized time:
+ * the peak dynamic acceleration and the peak jerk through monotonic max-queues,
+ * and the velocity change through a running sum. The dynamic acceleration is the
+ * raw sample minus the provider's low-pass filtered vector, which tracks gravity.
+ */
+#include "crash_classifier.h"
+#include "esp_cpu.h"
+#include <math.h>
+#include <string.h>
+
+#define WINDOW CRASH_CLASSIFIER_WINDOW_SAMPLES
+#define AXES   3
+
+// Time between samples at full ODR
+#define SAMPLE_DT_S (1.0f / LIS2DH12TR_ODR_HZ)
+
+// Standard gravity, converts g to m/s^2
+#define GRAVITY_MS2 9.81f
+
+// Below this velocity change the direction is not trusted
+#define DIRECTION_MIN_DELTA_V_KMH 0.1f
+
+_Static_assert(WINDOW > 0, "Crash classifier window shorter than one sample");
+
+/**
+ * @brief Sliding window maximum, values that can never become the maximum are dropped on push
+ */
+typedef struct {
+    float value[WINDOW];
+    uint32_t seq[WINDOW];
+    uint32_t front;
+    uint32_t count;
+} sliding_max_t;
+
+/**
+ * @brief Sliding window sum kept in integer milli-g so it never drifts
+ */
+typedef struct {
+    int32_t value[WINDOW];
+    uint32_t head;
+    int32_t sum;
+} sliding_sum_t;
+
+/**
+ * @brief Windowed features of one axis
+ */
+typedef struct {
+    sliding_max_t peak; // |dynamic acceleration| in g
+    sliding_max_t jerk; // |jerk| in g/s
+    sliding_sum_t area; // Dynamic acceleration in mg, summed
+    float last_dynamic; // Dynamic acceleration of the previous sample in g
+} axis_window_t;
+
+static axis_window_t axes[AXES];
+static uint32_t sample_seq = 0;
+static crash_classifier_stats_t stats;
+
+static inline uint32_t wrap(uint32_t index) {
+    return index >= WINDOW ? index - WINDOW : index;
+}
+
+static void sliding_max_push(sliding_max_t *window, float value, uint32_t seq) {
+    // Drop the oldest entry once it leaves the window
+    if(window->count && seq - window->seq[window->front] >= WINDOW) {
+        window->front = wrap(window->front + 1);
+        window->count--;
+    }
+
+    // Drop entries that are smaller and older than the new one
+    while(window->count && window->value[wrap(window->front + window->count - 1)] <= value) {
+        window->count--;
+    }
+
+    uint32_t back       = wrap(window->front + window->count);
+    window->value[back] = value;
+    window->seq[back]   = seq;
+    window->count++;
+}
+
+static inline float sliding_max_get(const sliding_max_t *window) {
+    return window->count ? window->value[window->front] : 0.0f;
+}
+
+static inline void sliding_sum_push(sliding_sum_t *window, int32_t value) {
+    window->sum += value - window->value[window->head];
+    window->value[window->head] = value;
+    window->head                = wrap(window->head + 1);
+}
+
+static void axis_update(axis_window_t *axis, float dynamic) {
+    // The first sample has no predecessor, its jerk would be the whole offset
+    float jerk = sample_seq ? (dynamic - axis->last_dynamic) / SAMPLE_DT_S : 0.0f;
+
+    sliding_max_push(&axis->peak, fabsf(dynamic), sample_seq);
+    sliding_max_push(&axis->jerk, fabsf(jerk), sample_seq);
+    sliding_sum_push(&axis->area, (int32_t) lroundf(dynamic * 1000.0f));
+    axis->last_dynamic = dynamic;
+}
+
+static float axis_delta_v_kmh(const axis_window_t *axis) {
+    return axis->area.sum * 0.001f * GRAVITY_MS2 * SAMPLE_DT_S * 3.6f;
+}
+
+void crash_classifier_reset(void) {
+    memset(axes, 0, sizeof(axes));
+    memset(&stats, 0, sizeof(stats));
+    sample_seq = 0;
+}
+
+void crash_classifier_update(const acc_data_t *acc_data) {
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    axis_update(&axes[0], acc_data->raw_acc.x_acc - acc_data->filtered_acc_x);
+    axis_update(&axes[1], acc_data->raw_acc.y_acc - acc_data->filtered_acc_y);
+    axis_update(&axes[2], acc_data->raw_acc.z_acc - acc_data->filtered_acc_z);
+    sample_seq++;
+
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    stats.samples++;
+    stats.last_cycles = cycles;
+    stats.total_cycles += cycles;
+    if(cycles > stats.max_cycles) {
+        stats.max_cycles = cycles;
+    }
+    if(cycles > CRASH_CLASSIFIER_CYCLE_BUDGET) {
+        stats.over_budget++;
+    }
+}
+
+void crash_classifier_classify(crash_classification_t *result) {
+    memset(result, 0, sizeof(crash_classification_t));
+
+    if(sample_seq == 0) {
+        return;
+    }
+
+    for(int axis = 0; axis < AXES; axis++) {
+        result->peak_g       = fmaxf(result->peak_g, sliding_max_get(&axes[axis].peak));
+        result->jerk_g_per_s = fmaxf(result->jerk_g_per_s, sliding_max_get(&axes[axis].jerk));
+    }
+
+    // Longitudinal (Y) and lateral (X) velocity change in the horizontal plane
+    float dv_x          = axis_delta_v_kmh(&axes[0]);
+    float dv_y          = axis_delta_v_kmh(&axes[1]);
+    result->delta_v_kmh = sqrtf(dv_x * dv_x + dv_y * dv_y);
+
+    if(result->delta_v_kmh < DIRECTION_MIN_DELTA_V_KMH) {
+        result->direction = CRASH_DIRECTION_UNKNOWN;
+    } else if(fabsf(dv_x) > fabsf(dv_y)) {
+        result->direction = CRASH_DIRECTION_SIDE;
+    } else {
+        result->direction = dv_y < 0 ? CRASH_DIRECTION_FRONT : CRASH_DIRECTION_REAR;
+    }
+
+    if(result->delta_v_kmh >= CRASH_SEVERITY_SEVERE_DELTA_V_KMH || result->peak_g >= CRASH_SEVERITY_SEVERE_PEAK_G) {
+        result->severity = CRASH_SEVERITY_SEVERE;
+    } else if(result->delta_v_kmh >= CRASH_SEVERITY_MODERATE_DELTA_V_KMH
+              || result->peak_g >= CRASH_SEVERITY_MODERATE_PEAK_G) {
+        result->severity = CRASH_SEVERITY_MODERATE;
+    } else {
+        result->severity = CRASH_SEVERITY_MINOR;
+    }
+}
+
+void crash_classifier_get_stats(crash_classifier_stats_t *result) {
+    memcpy(result, &stats, sizeof(crash_classifier_stats_t));
+}
+
+const char *crash_classifier_direction_str(crash_direction_t direction) {
+    switch(direction) {
+        case CRASH_DIRECTION_FRONT:
+            return "front";
+        case CRASH_DIRECTION_REAR:
+            return "rear";
+        case CRASH_DIRECTION_SIDE:
+            return "side";
+        default:
+            return "unknown";
+    }
+}
+
+const char *crash_classifier_severity_str(crash_severity_t severity) {
+    switch(severity) {
+        case CRASH_SEVERITY_MINOR:
+            return "minor";
+        case CRASH_SEVERITY_MODERATE:
+            return "moderate";
+        case CRASH_SEVERITY_SEVERE:
+            return "severe";
+        default:
+            return "none";
+    }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file crash_classifier.h
+ * @brief Streaming crash severity and impact direction classifier
+ */
+#ifndef CRASH_CLASSIFIER_H
+#define CRASH_CLASSIFIER_H
+
+#include "acc_data_provider.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Sliding window the features are computed over */
+#define CRASH_CLASSIFIER_WINDOW_MS      100
+#define CRASH_CLASSIFIER_WINDOW_SAMPLES (CRASH_CLASSIFIER_WINDOW_MS * LIS2DH12TR_ODR_HZ / 1000)
+
+/** @brief CPU cycles one sample update may take, 20 us at 240 MHz */
+#define CRASH_CLASSIFIER_CYCLE_BUDGET 4800
+
+/** @brief Severity thresholds, an impact takes the highest class any feature reaches */
+#define CRASH_SEVERITY_MODERATE_DELTA_V_KMH 8.0f  // Typical airbag deployment threshold
+#define CRASH_SEVERITY_SEVERE_DELTA_V_KMH   25.0f // High injury risk
+#define CRASH_SEVERITY_MODERATE_PEAK_G      4.0f  // Hard impact on any axis
+#define CRASH_SEVERITY_SEVERE_PEAK_G        7.5f  // Close to the 8 g sensor range
+
+/**
+ * @brief Direction the impact came from
+ */
+typedef enum {
+    CRASH_DIRECTION_UNKNOWN,
+    CRASH_DIRECTION_FRONT, // Vehicle decelerated along the forward (+Y) axis
+    CRASH_DIRECTION_REAR,  // Vehicle was pushed along the forward (+Y) axis
+    CRASH_DIRECTION_SIDE   // Velocity change dominated by the lateral (X) axis
+} crash_direction_t;
+
+/**
+ * @brief Crash severity class
+ */
+typedef enum {
+    CRASH_SEVERITY_NONE,
+    CRASH_SEVERITY_MINOR,
+    CRASH_SEVERITY_MODERATE,
+    CRASH_SEVERITY_SEVERE
+} crash_severity_t;
+
+/**
+ * @brief Features of the current window and the resulting classification
+ */
+typedef struct {
+    float peak_g;                // Largest dynamic acceleration on any axis
+    float delta_v_kmh;           // Velocity change in the horizontal plane
+    float jerk_g_per_s;          // Largest jerk on any axis
+    crash_direction_t direction; // Direction the impact came from
+    crash_severity_t severity;   // Severity class
+} crash_classification_t;
+
+/**
+ * @brief Per-sample processing cost
+ */
+typedef struct {
+    uint32_t samples;      // Samples processed
+    uint32_t last_cycles;  // Cycles spent on the most recent sample
+    uint32_t max_cycles;   // Worst case cycles per sample
+    uint64_t total_cycles; // Cycles spent on all samples
+    uint32_t over_budget;  // Samples that exceeded CRASH_CLASSIFIER_CYCLE_BUDGET
+} crash_classifier_stats_t;
+
+/**
+ * @brief Clear the windows and the statistics
+ */
+void crash_classifier_reset(void);
+
+/**
+ * @brief Add one sample to the windows, O(1) amortized
+ *
+ * Must be called for every sample at full ODR, from a single task.
+ *
+ * @param acc_data Sample from the accelerometer history
+ */
+void crash_classifier_update(const acc_data_t *acc_data);
+
+/**
+ * @brief Classify the current window
+ *
+ * @param result Pointer to store the features and classification
+ */
+void crash_classifier_classify(crash_classification_t *result);
+
+/**
+ * @brief Get the per-sample processing cost
+ *
+ * @param stats Pointer to store the statistics
+ */
+void crash_classifier_get_stats(crash_classifier_stats_t *stats);
+
+/**
+ * @brief Human readable name of a direction
+ */
+const char *crash_classifier_direction_str(crash_direction_t direction);
+
+/**
+ * @brief Human readable name of a severity class
+ */
+const char *crash_classifier_severity_str(crash_severity_t severity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRASH_CLASSIFIER_H */
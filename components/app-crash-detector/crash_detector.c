@@ -4,6 +4,9 @@
  */
 #include "crash_detector.h"
 #include "acc_data_provider.h" // Use the centralized provider
+#include "acc_history.h"
+#include "crash_recorder.h"
+#include "vehicle_state.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -11,17 +14,37 @@
 #include <string.h>
 #include <time.h>
 #include <math.h>
-#include "pcf8574.h"
+#include "expander_service.h"
+#include "buzzer.h"
 
 #define TAG "CRASH_DETECTOR"
 
 // Sampling interval (ms)
 #define SAMPLE_INTERVAL_MS 50
 
+// Samples pulled from the history per read
+#define HISTORY_BATCH_SIZE 32
+
+// Recent samples kept for confirming a hardware trigger
+#define CONFIRM_SAMPLES (CRASH_CONFIRM_WINDOW_MS * LIS2DH12TR_ODR_HZ / 1000)
+
+// Interval of the classifier cost report
+#define CLASSIFIER_REPORT_INTERVAL_MS 60000
+
+// Longest sleep while waiting for a hardware trigger, keeps the history reader from overrunning
+#define TRIGGER_IDLE_INTERVAL_MS ACC_UPDATE_RATE_MS
+
 // PCF8574 I/O expander pin used for crash detection signal
-extern i2c_dev_t expander;            // Declared in app_main
-static uint8_t expander_state = 0xFF; // Default all HIGH (idle)
-#define CRASH_DET_PIN 0               // P0 on PCF8574
+#define CRASH_DET_PIN 0 // P0 on PCF8574
+
+// Alarm until the crash state is reset, outranks the parking beeps
+static const buzzer_pattern_t crash_alarm = {
+    .on_ms    = 400,
+    .off_ms   = 200,
+    .repeat   = BUZZER_REPEAT_FOREVER,
+    .duty     = 4096, // Half of the 13-bit range, loudest tone
+    .priority = BUZZER_PRIORITY_ALARM,
+};
 
 // Config and state
 static float crash_threshold                        = CRASH_ACCEL_THRESHOLD;
@@ -30,6 +53,15 @@ static crash_event_t last_crash_event               = { 0 };
 static TimerHandle_t reset_timer                    = NULL;
 static void (*crash_callback)(crash_event_t *event) = NULL;
 
+// Hardware trigger state
+static bool hw_trigger_armed          = false;
+static TaskHandle_t crash_task_handle = NULL;
+static volatile bool trigger_pending  = false;
+static volatile uint32_t trigger_time = 0;
+static float confirm_magnitude[CONFIRM_SAMPLES];
+static uint32_t confirm_timestamp[CONFIRM_SAMPLES];
+static size_t confirm_head = 0;
+
 // Mock time for demo
 static time_t mock_timestamp = 1712342400;
 
@@ -52,20 +84,20 @@ static void format_timestamp(time_t ts, char *buf, size_t size) {
             timeinfo.tm_sec);
 }
 
-static void pcf8574_set_pin(uint8_t pin, bool high) {
-    if(high)
-        expander_state |= (1 << pin); // release line (idle)
-    else
-        expander_state &= ~(1 << pin); // pull low (signal)
-
-    pcf8574_port_write(&expander, expander_state);
+static void crash_signal_set(bool high) {
+    if(high) {
+        expander_service_set(EXPANDER_PIN(CRASH_DET_PIN)); // release line (idle)
+    } else {
+        expander_service_clear(EXPANDER_PIN(CRASH_DET_PIN)); // pull low (signal)
+        expander_service_flush();                            // the signal does not wait for the coalescing window
+    }
 }
 
 /**
  * @brief Send crash notification (via I/O expander pin)
  */
 static void send_crash_notification(crash_event_t *event) {
-    pcf8574_set_pin(CRASH_DET_PIN, false); // Pull LOW to signal
+    crash_signal_set(false); // Pull LOW to signal
     ESP_LOGW(TAG, "Crash signal sent via PCF8574 P%d (LOW)", CRASH_DET_PIN);
 }
 
@@ -74,14 +106,143 @@ static void send_crash_notification(crash_event_t *event) {
  */
 static void reset_timer_callback(TimerHandle_t xTimer) {
     crash_detected = false;
-    pcf8574_set_pin(CRASH_DET_PIN, true); // Release pin (HIGH)
+    vehicle_state_publish_crash(false);
+    buzzer_stop(BUZZER_PRIORITY_ALARM);
+    crash_signal_set(true); // Release pin (HIGH)
     ESP_LOGW(TAG, "Crash reset: pin released (HIGH)");
 }
 
+/**
+ * @brief Latch a crash event and notify everybody interested
+ */
+static void crash_detector_raise(uint32_t sample_timestamp, float impact_force) {
+    // Freeze the waveform first, everything below may take a while
+    crash_recorder_trigger(sample_timestamp, impact_force);
+
+    crash_classification_t classification;
+    crash_classifier_classify(&classification);
+
+    crash_detected                = true;
+    last_crash_event.impact_force = impact_force;
+    last_crash_event.timestamp    = get_mock_time();
+    last_crash_event.severity     = classification.severity;
+    last_crash_event.direction    = classification.direction;
+    last_crash_event.delta_v_kmh  = classification.delta_v_kmh;
+    format_timestamp(last_crash_event.timestamp, last_crash_event.timestamp_str, sizeof(last_crash_event.timestamp_str));
+
+    vehicle_state_publish_crash(true);
+    buzzer_play(&crash_alarm);
+    send_crash_notification(&last_crash_event);
+
+    if(crash_callback)
+        crash_callback(&last_crash_event);
+    xTimerStart(reset_timer, 0);
+
+    ESP_LOGE(TAG,
+            "Crash detected! Force: %.2fg, %s %s impact, delta-V %.1f km/h, peak %.2fg, jerk %.0fg/s",
+            impact_force,
+            crash_classifier_severity_str(classification.severity),
+            crash_classifier_direction_str(classification.direction),
+            classification.delta_v_kmh,
+            classification.peak_g,
+            classification.jerk_g_per_s);
+}
+
+/**
+ * @brief Check a single accelerometer sample against the crash threshold
+ */
+static void crash_detector_process_sample(const acc_data_t *acc_data) {
+    // Use total magnitude from the provider
+    float impact_magnitude = acc_data->magnitude;
+
+    // Adjust by removing 1g of gravity (if magnitude > 1g)
+    float adjusted_magnitude = impact_magnitude > 1.0f ? impact_magnitude - 1.0f : 0.0f;
+
+    if(adjusted_magnitude > crash_threshold && !crash_detected) {
+        crash_detector_raise(acc_data->timestamp, adjusted_magnitude);
+    }
+
+    if(adjusted_magnitude > crash_threshold / 2) {
+        ESP_LOGD(TAG, "High impact detected: %.2fg", adjusted_magnitude);
+    }
+}
+
+/**
+ * @brief Remember the dynamic acceleration of a sample for trigger confirmation
+ *
+ * The low-pass filtered vector tracks gravity, the difference to the raw sample
+ * is the same quantity the sensor's high-pass filtered trigger looks at.
+ */
+static void crash_detector_track_sample(const acc_data_t *acc_data) {
+    float dx = acc_data->raw_acc.x_acc - acc_data->filtered_acc_x;
+    float dy = acc_data->raw_acc.y_acc - acc_data->filtered_acc_y;
+    float dz = acc_data->raw_acc.z_acc - acc_data->filtered_acc_z;
+
+    confirm_magnitude[confirm_head] = sqrtf(dx * dx + dy * dy + dz * dz);
+    confirm_timestamp[confirm_head] = acc_data->timestamp;
+    confirm_head                    = (confirm_head + 1) % CONFIRM_SAMPLES;
+}
+
+/**
+ * @brief Confirm a hardware trigger against the samples leading up to it
+ */
+static void crash_detector_confirm_trigger(uint32_t timestamp) {
+    float peak = 0.0f;
+
+    for(size_t i = 0; i < CONFIRM_SAMPLES; i++) {
+        if(timestamp - confirm_timestamp[i] <= CRASH_CONFIRM_WINDOW_MS && confirm_magnitude[i] > peak) {
+            peak = confirm_magnitude[i];
+        }
+    }
+
+    if(peak > crash_threshold && !crash_detected) {
+        crash_detector_raise(timestamp, peak);
+    } else {
+        ESP_LOGD(TAG, "Impact trigger not confirmed, peak: %.2fg", peak);
+    }
+}
+
+/**
+ * @brief Log the per-sample cost of the classifier against its cycle budget
+ */
+static void crash_detector_report_classifier_cost(void) {
+    crash_classifier_stats_t stats;
+    crash_classifier_get_stats(&stats);
+
+    if(stats.samples == 0) {
+        return;
+    }
+
+    ESP_LOGI(TAG,
+            "Classifier: %lu samples, avg %lu cycles, max %lu cycles, %lu over the %d cycle budget",
+            (unsigned long) stats.samples,
+            (unsigned long) (stats.total_cycles / stats.samples),
+            (unsigned long) stats.max_cycles,
+            (unsigned long) stats.over_budget,
+            CRASH_CLASSIFIER_CYCLE_BUDGET);
+}
+
+/**
+ * @brief Impact trigger callback, runs in the accelerometer provider task
+ */
+static void crash_detector_on_impact(uint32_t timestamp) {
+    trigger_time    = timestamp;
+    trigger_pending = true;
+
+    if(crash_task_handle) {
+        xTaskNotifyGive(crash_task_handle);
+    }
+}
+
 esp_err_t crash_detector_init(void) {
     // Reset state
     crash_detected = false;
-    pcf8574_set_pin(CRASH_DET_PIN, true); // Idle state: HIGH
+    crash_signal_set(true); // Idle state: HIGH
+    crash_classifier_reset();
+
+    if(buzzer_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Buzzer unavailable, crash alarm will be silent");
+    }
 
     reset_timer = xTimerCreate("crash_reset_timer", pdMS_TO_TICKS(CRASH_RESET_TIMEOUT_MS), pdFALSE, 0, reset_timer_callback);
 
@@ -90,7 +251,15 @@ esp_err_t crash_detector_init(void) {
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Crash detector initialized with threshold: %.2fg", crash_threshold);
+    // Prefer the sensor's own threshold engine, fall back to checking every sample in software
+    hw_trigger_armed = acc_data_provider_set_impact_trigger(
+                               crash_threshold, CRASH_TRIGGER_DURATION_MS, crash_detector_on_impact)
+                       == ESP_OK;
+
+    ESP_LOGI(TAG,
+            "Crash detector initialized with threshold: %.2fg (%s trigger)",
+            crash_threshold,
+            hw_trigger_armed ? "hardware" : "software");
     return ESP_OK;
 }
 
@@ -101,42 +270,63 @@ void crash_detector_task(void *pvParameters) {
     ESP_LOGI(TAG, "Crash detector task started");
 
     TickType_t last_wake_time = xTaskGetTickCount();
-    acc_data_t acc_data       = { 0 };
+    TickType_t last_report    = last_wake_time;
+    acc_history_reader_t reader;
+    static acc_data_t batch[HISTORY_BATCH_SIZE];
+
+    crash_task_handle = xTaskGetCurrentTaskHandle();
+    acc_history_reader_init(&reader);
 
     while(1) {
-        // Get latest acceleration data from the centralized provider
-        if(acc_data_get(&acc_data) == ESP_OK && acc_data.is_valid) {
-            // Use total magnitude from the provider
-            float impact_magnitude = acc_data.magnitude;
+        size_t count;
+        uint32_t dropped;
 
-            // Adjust by removing 1g of gravity (if magnitude > 1g)
-            float adjusted_magnitude = impact_magnitude > 1.0f ? impact_magnitude - 1.0f : 0.0f;
+        // Process every sample queued since the last run, oldest first
+        do {
+            count = acc_history_read(&reader, batch, HISTORY_BATCH_SIZE, &dropped);
 
-            if(adjusted_magnitude > crash_threshold && !crash_detected) {
-                crash_detected                = true;
-                last_crash_event.impact_force = adjusted_magnitude;
-                last_crash_event.timestamp    = get_mock_time();
-                format_timestamp(last_crash_event.timestamp,
-                        last_crash_event.timestamp_str,
-                        sizeof(last_crash_event.timestamp_str));
+            if(dropped) {
+                ESP_LOGW(TAG, "Missed %lu accelerometer samples", (unsigned long) dropped);
+            }
 
-                send_crash_notification(&last_crash_event);
+            for(size_t i = 0; i < count; i++) {
+                if(!batch[i].is_valid) {
+                    continue;
+                }
 
-                if(crash_callback)
-                    crash_callback(&last_crash_event);
-                xTimerStart(reset_timer, 0);
+                // Keep the classifier windows current before any trigger looks at them
+                crash_classifier_update(&batch[i]);
 
-                ESP_LOGE(TAG, "Crash detected! Force: %.2fg", adjusted_magnitude);
+                if(hw_trigger_armed) {
+                    crash_detector_track_sample(&batch[i]);
+                } else {
+                    crash_detector_process_sample(&batch[i]);
+                }
             }
+        } while(count == HISTORY_BATCH_SIZE);
 
-            if(adjusted_magnitude > crash_threshold / 2) {
-                ESP_LOGD(TAG, "High impact detected: %.2fg", adjusted_magnitude);
-            }
-        } else {
-            ESP_LOGW(TAG, "Failed to get valid accelerometer data");
+        // The provider publishes all samples up to the trigger before calling back
+        if(trigger_pending) {
+            trigger_pending = false;
+            crash_detector_confirm_trigger(trigger_time);
+        }
+
+        if(xTaskGetTickCount() - last_report >= pdMS_TO_TICKS(CLASSIFIER_REPORT_INTERVAL_MS)) {
+            last_report = xTaskGetTickCount();
+            crash_detector_report_classifier_cost();
+        }
+
+        // Parked: nothing new reaches the history until the accelerometer reports activity
+        if(!acc_data_provider_is_active()) {
+            acc_data_provider_wait_active(portMAX_DELAY);
+            last_wake_time = xTaskGetTickCount();
         }
 
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(SAMPLE_INTERVAL_MS));
+        if(hw_trigger_armed) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TRIGGER_IDLE_INTERVAL_MS));
+        } else {
+            vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(SAMPLE_INTERVAL_MS));
+        }
     }
 }
 
@@ -153,13 +343,18 @@ bool crash_detector_get_last_event(crash_event_t *event) {
 
 void crash_detector_reset(void) {
     crash_detected = false;
-    pcf8574_set_pin(CRASH_DET_PIN, true); // release
+    vehicle_state_publish_crash(false);
+    buzzer_stop(BUZZER_PRIORITY_ALARM);
+    crash_signal_set(true); // release
     ESP_LOGI(TAG, "Crash state manually reset");
 }
 
 void crash_detector_set_threshold(float threshold) {
     if(threshold > 0) {
         crash_threshold = threshold;
+        if(hw_trigger_armed) {
+            acc_data_provider_set_impact_trigger(threshold, CRASH_TRIGGER_DURATION_MS, crash_detector_on_impact);
+        }
         ESP_LOGI(TAG, "Crash threshold updated to %.2fg", threshold);
     }
 }
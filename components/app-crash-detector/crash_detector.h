@@ -6,6 +6,7 @@
 #define CRASH_DETECTOR_H
 
 #include "esp_err.h"
+#include "crash_classifier.h"
 #include <stdbool.h>
 #include <time.h>
 
@@ -13,13 +14,20 @@
 #define CRASH_ACCEL_THRESHOLD  0.02f // Default: 4g force
 #define CRASH_RESET_TIMEOUT_MS 5000  // Auto reset crash state after 5 seconds
 
+/** @brief Hardware impact trigger (LIS2DH12 INT1 inertial engine) */
+#define CRASH_TRIGGER_DURATION_MS 10  // Threshold must be exceeded for at least this long
+#define CRASH_CONFIRM_WINDOW_MS   100 // Samples before the trigger used for software confirmation
+
 /**
  * @brief Crash event data structure
  */
 typedef struct {
-    float impact_force;     // Force of impact in g
-    time_t timestamp;       // Time of crash detection
-    char timestamp_str[32]; // Human-readable timestamp
+    float impact_force;          // Force of impact in g
+    time_t timestamp;            // Time of crash detection
+    char timestamp_str[32];      // Human-readable timestamp
+    crash_severity_t severity;   // Severity class of the impact
+    crash_direction_t direction; // Direction the impact came from
+    float delta_v_kmh;           // Velocity change over the classifier window
 } crash_event_t;
 
 /**
@@ -0,0 +1,251 @@
+/**
+ * @file crash_recorder.c
+ * @brief Black-box recorder of the accelerometer waveform around a crash
+ *
+ * The recorder follows the accelerometer history with its own reader and keeps the last
+ * CRASH_RECORDER_TOTAL_SAMPLES raw samples in a preallocated ring. A trigger only flips
+ * the state, the recorder task then keeps filling the ring until the post-trigger window
+ * is complete, which leaves exactly the pre-trigger window in front of it. The capture is
+ * serialized into a preallocated record and written to NVS from the recorder task.
+ */
+#include "crash_recorder.h"
+#include "acc_data_provider.h"
+#include "acc_history.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include <math.h>
+#include <string.h>
+
+#define TAG "CRASH_RECORDER"
+
+// Samples pulled from the history per read
+#define HISTORY_BATCH_SIZE 32
+
+// Longest sleep between history reads
+#define RECORDER_INTERVAL_MS ACC_UPDATE_RATE_MS
+
+// NVS location of the last record
+#define RECORDER_NVS_NAMESPACE "crash_rec"
+#define RECORDER_NVS_KEY       "last"
+
+typedef enum {
+    RECORDER_ARMED,     // Continuously filling the pre-trigger window
+    RECORDER_CAPTURING, // Trigger received, filling the post-trigger window
+    RECORDER_PERSISTING // Capture complete, being written to NVS
+} recorder_state_t;
+
+// Ring of the most recent samples, compact form plus full timestamps
+static crash_record_sample_t ring_samples[CRASH_RECORDER_TOTAL_SAMPLES];
+static uint32_t ring_timestamps[CRASH_RECORDER_TOTAL_SAMPLES];
+static size_t ring_head  = 0;
+static size_t ring_count = 0;
+
+// Serialized capture, preallocated so that nothing is allocated after a trigger
+static crash_record_t record_buf;
+
+// Trigger state shared with the detector
+static portMUX_TYPE recorder_lock        = portMUX_INITIALIZER_UNLOCKED;
+static volatile recorder_state_t state   = RECORDER_ARMED;
+static uint32_t trigger_timestamp        = 0;
+static float trigger_force               = 0.0f;
+static uint32_t post_samples             = 0;
+static TaskHandle_t recorder_task_handle = NULL;
+
+static int16_t to_mg(float g) {
+    return (int16_t) lroundf(g * 1000.0f);
+}
+
+/**
+ * @brief Append a sample to the ring, overwriting the oldest one when full
+ */
+static void recorder_push(const acc_data_t *acc_data) {
+    crash_record_sample_t *slot = &ring_samples[ring_head];
+
+    slot->x_mg                 = to_mg(acc_data->raw_acc.x_acc);
+    slot->y_mg                 = to_mg(acc_data->raw_acc.y_acc);
+    slot->z_mg                 = to_mg(acc_data->raw_acc.z_acc);
+    ring_timestamps[ring_head] = acc_data->timestamp;
+
+    ring_head = (ring_head + 1) % CRASH_RECORDER_TOTAL_SAMPLES;
+    if(ring_count < CRASH_RECORDER_TOTAL_SAMPLES) {
+        ring_count++;
+    }
+}
+
+/**
+ * @brief Copy the ring into the record buffer, oldest sample first
+ */
+static void recorder_freeze(void) {
+    size_t index = (ring_head + CRASH_RECORDER_TOTAL_SAMPLES - ring_count) % CRASH_RECORDER_TOTAL_SAMPLES;
+
+    memset(&record_buf, 0, sizeof(record_buf));
+    record_buf.trigger_timestamp = trigger_timestamp;
+    record_buf.impact_force      = trigger_force;
+
+    for(size_t i = 0; i < ring_count; i++) {
+        int32_t offset_ms = (int32_t) (ring_timestamps[index] - trigger_timestamp);
+
+        record_buf.samples[i]           = ring_samples[index];
+        record_buf.samples[i].offset_ms = (int16_t) offset_ms;
+
+        if(offset_ms <= 0) {
+            record_buf.pre_samples++;
+        } else {
+            record_buf.post_samples++;
+        }
+
+        index = (index + 1) % CRASH_RECORDER_TOTAL_SAMPLES;
+    }
+}
+
+/**
+ * @brief Write the record buffer to NVS
+ */
+static esp_err_t recorder_persist(void) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(RECORDER_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    err = nvs_set_blob(handle, RECORDER_NVS_KEY, &record_buf, sizeof(record_buf));
+    if(err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+    return err;
+}
+
+/**
+ * @brief Feed one sample, completes the capture once the post-trigger window is full
+ */
+static void recorder_process_sample(const acc_data_t *acc_data) {
+    recorder_push(acc_data);
+
+    if(state != RECORDER_CAPTURING || (int32_t) (acc_data->timestamp - trigger_timestamp) <= 0) {
+        return;
+    }
+
+    if(++post_samples >= CRASH_RECORDER_POST_SAMPLES) {
+        recorder_freeze();
+        state = RECORDER_PERSISTING;
+    }
+}
+
+esp_err_t crash_recorder_init(void) {
+    memset(ring_samples, 0, sizeof(ring_samples));
+    memset(ring_timestamps, 0, sizeof(ring_timestamps));
+    ring_head  = 0;
+    ring_count = 0;
+    state      = RECORDER_ARMED;
+
+    ESP_LOGI(TAG,
+            "Crash recorder initialized: %d ms before, %d ms after the trigger (%u bytes per record)",
+            CRASH_RECORDER_PRE_MS,
+            CRASH_RECORDER_POST_MS,
+            (unsigned) sizeof(crash_record_t));
+    return ESP_OK;
+}
+
+void crash_recorder_task(void *pvParameters) {
+    ESP_LOGI(TAG, "Crash recorder task started");
+
+    acc_history_reader_t reader;
+    static acc_data_t batch[HISTORY_BATCH_SIZE];
+
+    recorder_task_handle = xTaskGetCurrentTaskHandle();
+    acc_history_reader_init(&reader);
+
+    while(1) {
+        size_t count;
+        uint32_t dropped;
+
+        do {
+            count = acc_history_read(&reader, batch, HISTORY_BATCH_SIZE, &dropped);
+
+            if(dropped) {
+                ESP_LOGW(TAG, "Missed %lu accelerometer samples", (unsigned long) dropped);
+            }
+
+            for(size_t i = 0; i < count && state != RECORDER_PERSISTING; i++) {
+                if(batch[i].is_valid) {
+                    recorder_process_sample(&batch[i]);
+                }
+            }
+        } while(count == HISTORY_BATCH_SIZE && state != RECORDER_PERSISTING);
+
+        if(state == RECORDER_PERSISTING) {
+            esp_err_t err = recorder_persist();
+            if(err == ESP_OK) {
+                ESP_LOGI(TAG,
+                        "Crash record saved: %u samples before, %u after the trigger",
+                        record_buf.pre_samples,
+                        record_buf.post_samples);
+            } else {
+                ESP_LOGE(TAG, "Failed to save crash record: %s", esp_err_to_name(err));
+            }
+
+            // Samples that arrived while writing are not part of any capture, start over from now
+            acc_history_reader_init(&reader);
+            state = RECORDER_ARMED;
+        }
+
+        // Parked: the history only grows again once the accelerometer reports activity
+        if(!acc_data_provider_is_active() && state == RECORDER_ARMED) {
+            acc_data_provider_wait_active(portMAX_DELAY);
+        }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RECORDER_INTERVAL_MS));
+    }
+}
+
+bool crash_recorder_trigger(uint32_t timestamp, float impact_force) {
+    bool started = false;
+
+    portENTER_CRITICAL(&recorder_lock);
+    if(state == RECORDER_ARMED) {
+        trigger_timestamp = timestamp;
+        trigger_force     = impact_force;
+        post_samples      = 0;
+        state             = RECORDER_CAPTURING;
+        started           = true;
+    }
+    portEXIT_CRITICAL(&recorder_lock);
+
+    if(started && recorder_task_handle) {
+        xTaskNotifyGive(recorder_task_handle);
+    }
+
+    return started;
+}
+
+bool crash_recorder_is_busy(void) {
+    return state != RECORDER_ARMED;
+}
+
+esp_err_t crash_recorder_load(crash_record_t *record) {
+    if(record == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(RECORDER_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if(err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    } else if(err != ESP_OK) {
+        return err;
+    }
+
+    size_t size = sizeof(crash_record_t);
+    err         = nvs_get_blob(handle, RECORDER_NVS_KEY, record, &size);
+    nvs_close(handle);
+
+    if(err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    return (err == ESP_OK && size != sizeof(crash_record_t)) ? ESP_ERR_INVALID_SIZE : err;
+}
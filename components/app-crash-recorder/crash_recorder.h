@@ -0,0 +1,94 @@
+/**
+ * @file crash_recorder.h
+ * @brief Black-box recorder of the accelerometer waveform around a crash
+ */
+#ifndef CRASH_RECORDER_H
+#define CRASH_RECORDER_H
+
+#include "esp_err.h"
+#include "LIS2DH12TR.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Capture window around the trigger */
+#define CRASH_RECORDER_PRE_MS  2000 // Kept continuously, frozen when the trigger arrives
+#define CRASH_RECORDER_POST_MS 1000 // Captured after the trigger
+
+/** @brief Capture window in samples at the accelerometer ODR */
+#define CRASH_RECORDER_PRE_SAMPLES   (CRASH_RECORDER_PRE_MS * LIS2DH12TR_ODR_HZ / 1000)
+#define CRASH_RECORDER_POST_SAMPLES  (CRASH_RECORDER_POST_MS * LIS2DH12TR_ODR_HZ / 1000)
+#define CRASH_RECORDER_TOTAL_SAMPLES (CRASH_RECORDER_PRE_SAMPLES + CRASH_RECORDER_POST_SAMPLES)
+
+/**
+ * @brief One recorded sample, compact form of the raw acceleration
+ */
+typedef struct {
+    int16_t x_mg;      // Raw X acceleration in mg
+    int16_t y_mg;      // Raw Y acceleration in mg
+    int16_t z_mg;      // Raw Z acceleration in mg
+    int16_t offset_ms; // Sample time relative to the trigger
+} crash_record_sample_t;
+
+/**
+ * @brief Persisted crash record
+ */
+typedef struct {
+    uint32_t trigger_timestamp; // Trigger time in milliseconds since boot
+    float impact_force;         // Impact force reported by the detector in g
+    uint16_t pre_samples;       // Valid samples before the trigger
+    uint16_t post_samples;      // Valid samples after the trigger
+
+    // Captured window, oldest sample first
+    crash_record_sample_t samples[CRASH_RECORDER_TOTAL_SAMPLES];
+} crash_record_t;
+
+/**
+ * @brief Initialize the crash recorder
+ * 
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t crash_recorder_init(void);
+
+/**
+ * @brief Recorder task, keeps the pre-trigger window filled and persists captures
+ * 
+ * @param pvParameters FreeRTOS task parameters (not used)
+ */
+void crash_recorder_task(void *pvParameters);
+
+/**
+ * @brief Freeze the pre-trigger window and start the post-trigger capture
+ * 
+ * Does not block and does not allocate, safe to call from the detector hot path.
+ * Triggers are ignored while a previous capture is still in progress.
+ * 
+ * @param timestamp Time of the event in milliseconds, same clock as acc_data_t
+ * @param impact_force Impact force in g
+ * @return bool true if the trigger started a new capture
+ */
+bool crash_recorder_trigger(uint32_t timestamp, float impact_force);
+
+/**
+ * @brief Check whether a capture is being recorded or persisted
+ * 
+ * @return bool true while busy
+ */
+bool crash_recorder_is_busy(void);
+
+/**
+ * @brief Load the last persisted crash record
+ * 
+ * @param record Pointer to store the record
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND if nothing was recorded yet
+ */
+esp_err_t crash_recorder_load(crash_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRASH_RECORDER_H */
@@ -4,22 +4,48 @@
  */
 #include "day_night_detector.h"
 #include "../als-veml7700/veml7700.h"
+#include "vehicle_state.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "driver/i2c.h"
+#include "nvs.h"
+#include "esp_cpu.h"
+#include <math.h>
 
 #define TAG "DAY_NIGHT"
 
 // Hysteresis to prevent rapid switching
-#define HYSTERESIS_FACTOR 1.5
+#define HYSTERESIS_FACTOR 1.5f
+
+// Sampling, the sensor is only polled while the state may change
+#define POLL_PERIOD_MS         2000  // Full reads while the average settles, or without thresholds
+#define STATUS_CHECK_PERIOD_MS 5000  // Interrupt status reads while the thresholds are armed
+#define REFRESH_PERIOD_MS      60000 // Full read while armed, keeps the published lux fresh
+#define SETTLE_SAMPLES         5     // Polls without a state change before arming the thresholds
+#define THRESHOLD_PERSISTENCE  4     // Results outside the window before the sensor flags a crossing
+#define AVERAGE_SAMPLES        5
+
+// Run day_night_replay() on the built-in dusk and dawn counts when the task starts, needs no sensor
+#ifndef DAY_NIGHT_REPLAY_ON_START
+#define DAY_NIGHT_REPLAY_ON_START 0
+#endif
+
+// NVS location of the last good sensor range, gain in the upper and integration time in the lower half
+#define RANGE_NVS_NAMESPACE "day_night"
+#define RANGE_NVS_KEY       "als_range"
 
 static EventGroupHandle_t day_night_event_group     = NULL;
 static light_state_t current_state                  = LIGHT_STATE_TRANSITION;
 static veml7700_handle_t sensor_handle              = NULL;
 static void (*state_change_callback)(light_state_t) = NULL;
-static double current_lux                           = 0.0;
+static float current_lux                            = 0.0f;
+static sample_stamp_t current_stamp                 = { 0 };
+static volatile bool use_thresholds                 = true;
+static float samples[AVERAGE_SAMPLES]               = { 0 };
+static int sample_index                             = 0;
+static uint32_t persisted_range                     = UINT32_MAX;
 
 esp_err_t day_night_init(void) {
     // Create the event group
@@ -49,13 +75,21 @@ bool is_night_mode(void) {
     return (bits & NIGHT_MODE_BIT) != 0;
 }
 
-esp_err_t get_light_level(double *lux) {
+esp_err_t get_light_level(float *lux) {
     if(!lux)
         return ESP_ERR_INVALID_ARG;
     *lux = current_lux;
     return ESP_OK;
 }
 
+esp_err_t get_light_sample(float *lux, sample_stamp_t *stamp) {
+    if(!lux || !stamp)
+        return ESP_ERR_INVALID_ARG;
+    *lux   = current_lux;
+    *stamp = current_stamp;
+    return ESP_OK;
+}
+
 light_state_t get_light_state(void) {
     return current_state;
 }
@@ -64,6 +98,10 @@ void light_register_callback(void (*callback)(light_state_t state)) {
     state_change_callback = callback;
 }
 
+void day_night_use_thresholds(bool enable) {
+    use_thresholds = enable;
+}
+
 static void update_light_state(light_state_t new_state) {
     if(current_state == new_state)
         return;
@@ -90,7 +128,176 @@ static void update_light_state(light_state_t new_state) {
     }
 }
 
+static uint32_t range_pack(const struct veml7700_config *config) {
+    return ((uint32_t) config->gain << 16) | config->integration_time;
+}
+
+/**
+ * @brief Start from the range of the previous boot, the first read then needs no ranging
+ */
+static void range_restore(void) {
+    nvs_handle_t handle;
+    if(nvs_open(RANGE_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK)
+        return;
+
+    uint32_t range = 0;
+    esp_err_t err  = nvs_get_u32(handle, RANGE_NVS_KEY, &range);
+    nvs_close(handle);
+    if(err != ESP_OK)
+        return;
+
+    struct veml7700_config config;
+    veml7700_get_config(sensor_handle, &config);
+    config.gain             = range >> 16;
+    config.integration_time = range & 0xFFFF;
+    err                     = veml7700_set_config(sensor_handle, &config);
+    if(err != ESP_OK) {
+        ESP_LOGW(TAG, "Ignoring persisted sensor range 0x%08lx: %s", range, esp_err_to_name(err));
+        return;
+    }
+
+    persisted_range = range;
+    ESP_LOGI(TAG, "Restored sensor range, %lu ms integration", veml7700_get_integration_time_ms(sensor_handle));
+}
+
+/**
+ * @brief Remember the range after a good read, only written when auto-ranging changed it
+ */
+static void range_persist(void) {
+    struct veml7700_config config;
+    veml7700_get_config(sensor_handle, &config);
+
+    uint32_t range = range_pack(&config);
+    if(range == persisted_range)
+        return;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(RANGE_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if(err == ESP_OK) {
+        err = nvs_set_u32(handle, RANGE_NVS_KEY, range);
+        if(err == ESP_OK)
+            err = nvs_commit(handle);
+        nvs_close(handle);
+    }
+
+    if(err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to persist sensor range: %s", esp_err_to_name(err));
+        return;
+    }
+    persisted_range = range;
+}
+
+/**
+ * @brief Day/night hysteresis on the averaged light level
+ */
+static light_state_t light_next_state(light_state_t state, float avg) {
+    switch(state) {
+        case LIGHT_STATE_DAY:
+            return avg < NIGHT_THRESHOLD ? LIGHT_STATE_NIGHT : LIGHT_STATE_DAY;
+
+        case LIGHT_STATE_NIGHT:
+            return avg > DAY_THRESHOLD * HYSTERESIS_FACTOR ? LIGHT_STATE_DAY : LIGHT_STATE_NIGHT;
+
+        case LIGHT_STATE_TRANSITION:
+        case LIGHT_STATE_UNKNOWN:
+        default:
+            return avg < NIGHT_THRESHOLD ? LIGHT_STATE_NIGHT : LIGHT_STATE_DAY;
+    }
+}
+
+/**
+ * @brief Moving average over the last AVERAGE_SAMPLES readings
+ */
+static float light_average(float *window, int *index, float lux) {
+    window[*index] = lux;
+    *index         = (*index + 1) % AVERAGE_SAMPLES;
+
+    float avg = 0.0f;
+    for(int i = 0; i < AVERAGE_SAMPLES; ++i) {
+        avg += window[i];
+    }
+    return avg / AVERAGE_SAMPLES;
+}
+
+/**
+ * @brief Previous hysteresis in double precision, only kept as the replay baseline
+ */
+static light_state_t legacy_next_state(light_state_t state, double avg) {
+    switch(state) {
+        case LIGHT_STATE_DAY:
+            return avg < (double) NIGHT_THRESHOLD ? LIGHT_STATE_NIGHT : LIGHT_STATE_DAY;
+
+        case LIGHT_STATE_NIGHT:
+            return avg > (double) DAY_THRESHOLD * (double) HYSTERESIS_FACTOR ? LIGHT_STATE_DAY : LIGHT_STATE_NIGHT;
+
+        default:
+            return avg < (double) NIGHT_THRESHOLD ? LIGHT_STATE_NIGHT : LIGHT_STATE_DAY;
+    }
+}
+
+/**
+ * @brief Feed a new lux reading through the average and the day/night hysteresis
+ *
+ * @return bool true if the light state changed
+ */
+static bool process_lux(float lux) {
+    light_state_t previous = current_state;
+    float avg              = light_average(samples, &sample_index, lux);
+
+    ESP_LOGI(TAG, "Lux: %.2f (avg: %.2f)", lux, avg);
+
+    update_light_state(light_next_state(current_state, avg));
+
+    vehicle_state_publish_light(lux, current_state);
+    return current_state != previous;
+}
+
+/**
+ * @brief Arm the ALS thresholds on the edge of the hysteresis band the current state can leave through
+ *
+ * The window is in counts of the current range, the caller must not auto-range until it disarms.
+ */
+static esp_err_t thresholds_arm(void) {
+    float low  = 0.0f;
+    float high = HUGE_VALF;
+
+    if(current_state == LIGHT_STATE_DAY) {
+        low = NIGHT_THRESHOLD;
+    } else if(current_state == LIGHT_STATE_NIGHT) {
+        high = DAY_THRESHOLD * HYSTERESIS_FACTOR;
+    } else {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = veml7700_set_als_thresholds(sensor_handle, low, high);
+    if(ret == ESP_OK)
+        ret = veml7700_set_interrupt(sensor_handle, true, THRESHOLD_PERSISTENCE);
+
+    // Drop a crossing latched by the previous window
+    bool flag_high, flag_low;
+    if(ret == ESP_OK)
+        ret = veml7700_read_interrupt_status(sensor_handle, &flag_high, &flag_low);
+
+    return ret;
+}
+
+// Built-in ALS counts: dusk down to 1 lux and dawn back up, lingering around both thresholds
+static const uint16_t replay_counts[] = {
+    6944, 5208, 3472, 2083, 1389, 868, 521, 347,
+    243, 191, 165, 182, 170, 156, 122, 87,
+    52, 35, 17, 17, 35, 87, 260, 694,
+    1042, 1285, 1319, 1389, 1562, 2604, 4340, 6944,
+};
+
+#define REPLAY_COUNTS_LEN (sizeof(replay_counts) / sizeof(replay_counts[0]))
+#define REPLAY_RESOLUTION 0.0576f // Lux per count of replay_counts
+
 void day_night_task(void *pvParameters) {
+    if(DAY_NIGHT_REPLAY_ON_START) {
+        light_replay_result_t result;
+        day_night_replay(replay_counts, REPLAY_COUNTS_LEN, REPLAY_RESOLUTION, &result);
+    }
+
     esp_err_t ret = veml7700_initialize(&sensor_handle, 0);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize VEML7700 sensor: %s", esp_err_to_name(ret));
@@ -102,56 +309,135 @@ void day_night_task(void *pvParameters) {
         vTaskDelete(NULL);
     }
 
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Sensor stabilization delay
+    // With the range of the previous boot the first result is good after one integration
+    range_restore();
+    vTaskDelay(pdMS_TO_TICKS(veml7700_get_integration_time_ms(sensor_handle) * 11 / 10) + 1);
 
-    double samples[5] = { 0 };
-    int sample_index  = 0;
+    bool armed           = false;
+    int stable_samples   = 0;
+    TickType_t last_read = xTaskGetTickCount();
 
     while(1) {
-        ret = veml7700_read_als_lux_auto(sensor_handle, &current_lux);
+        if(armed) {
+            // The sensor has no interrupt pin, one status read replaces the read and ranging of a result
+            vTaskDelay(pdMS_TO_TICKS(STATUS_CHECK_PERIOD_MS));
+
+            bool high = false;
+            bool low  = false;
+            ret       = veml7700_read_interrupt_status(sensor_handle, &high, &low);
+            bool due  = xTaskGetTickCount() - last_read >= pdMS_TO_TICKS(REFRESH_PERIOD_MS);
+            if(ret == ESP_OK && !high && !low && !due && use_thresholds)
+                continue;
+
+            if(high || low) {
+                ESP_LOGI(TAG, "Light crossed the %s threshold, polling", high ? "high" : "low");
+                stable_samples = 0;
+            } else if(ret != ESP_OK) {
+                ESP_LOGW(TAG, "Interrupt status read failed (%s), polling", esp_err_to_name(ret));
+                stable_samples = 0;
+            }
+
+            // Auto-ranging invalidates the window, it is armed again once the state settles
+            veml7700_set_interrupt(sensor_handle, false, THRESHOLD_PERSISTENCE);
+            armed = false;
+        }
+
+        ret = veml7700_read_als_lux_auto_f(sensor_handle, &current_lux);
         if(ret != ESP_OK) {
             ESP_LOGE(TAG, "Sensor read failed: %s", esp_err_to_name(ret));
-            vTaskDelay(pdMS_TO_TICKS(2000));
+            vTaskDelay(pdMS_TO_TICKS(POLL_PERIOD_MS));
             continue;
         }
+        last_read = xTaskGetTickCount();
+        range_persist();
 
-        samples[sample_index] = current_lux;
-        sample_index          = (sample_index + 1) % 5;
+        // The integration ends right before the read, auto-ranging may have taken several of them
+        current_stamp = sample_stamp_take(SAMPLE_SOURCE_LIGHT);
 
-        double avg = 0;
-        for(int i = 0; i < 5; ++i) {
-            avg += samples[i];
+        if(process_lux(current_lux)) {
+            stable_samples = 0;
+        } else if(stable_samples < SETTLE_SAMPLES) {
+            stable_samples++;
         }
-        avg /= 5;
-
-        ESP_LOGI(TAG, "Lux: %.2f (avg: %.2f)", current_lux, avg);
-
-        switch(current_state) {
-            case LIGHT_STATE_DAY:
-                if(avg < NIGHT_THRESHOLD) {
-                    ESP_LOGI(TAG, "Transition to NIGHT");
-                    update_light_state(LIGHT_STATE_NIGHT);
-                }
-                break;
-
-            case LIGHT_STATE_NIGHT:
-                if(avg > DAY_THRESHOLD * HYSTERESIS_FACTOR) {
-                    ESP_LOGI(TAG, "Transition to DAY");
-                    update_light_state(LIGHT_STATE_DAY);
-                }
-                break;
-
-            case LIGHT_STATE_TRANSITION:
-            case LIGHT_STATE_UNKNOWN:
-            default:
-                if(avg < NIGHT_THRESHOLD) {
-                    update_light_state(LIGHT_STATE_NIGHT);
-                } else {
-                    update_light_state(LIGHT_STATE_DAY);
-                }
-                break;
+
+        // A settled state only needs to hear about the light leaving its hysteresis band
+        if(use_thresholds && stable_samples >= SETTLE_SAMPLES) {
+            ret = thresholds_arm();
+            if(ret == ESP_OK) {
+                armed = true;
+                continue;
+            }
+            ESP_LOGW(TAG, "Arming the thresholds failed (%s), polling", esp_err_to_name(ret));
+            veml7700_set_interrupt(sensor_handle, false, THRESHOLD_PERSISTENCE);
+            stable_samples = 0;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(POLL_PERIOD_MS));
+    }
+}
+
+esp_err_t day_night_replay(const uint16_t *counts, size_t count, float resolution, light_replay_result_t *result) {
+    if(counts == NULL || result == NULL || count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    float float_window[AVERAGE_SAMPLES]   = { 0 };
+    double double_window[AVERAGE_SAMPLES] = { 0 };
+    int float_index                       = 0;
+    int double_index                      = 0;
+    light_state_t float_state             = LIGHT_STATE_TRANSITION;
+    light_state_t double_state            = LIGHT_STATE_TRANSITION;
+
+    uint64_t float_cycles     = 0;
+    uint64_t double_cycles    = 0;
+    uint32_t state_mismatches = 0;
+    float max_avg_error       = 0.0f;
+
+    for(size_t i = 0; i < count; i++) {
+        // Single precision: one FPU multiply, average and compare
+        uint32_t start = esp_cpu_get_cycle_count();
+        float lux      = counts[i] * resolution;
+        float avg      = light_average(float_window, &float_index, lux);
+        float_state    = light_next_state(float_state, avg);
+        uint32_t end   = esp_cpu_get_cycle_count();
+        float_cycles += end - start;
+
+        // Previous pipeline: the same steps as libcalls on doubles
+        start                       = esp_cpu_get_cycle_count();
+        double double_lux           = counts[i] * resolution;
+        double_window[double_index] = double_lux;
+        double_index                = (double_index + 1) % AVERAGE_SAMPLES;
+        double double_avg           = 0;
+        for(int j = 0; j < AVERAGE_SAMPLES; ++j) {
+            double_avg += double_window[j];
         }
+        double_avg /= AVERAGE_SAMPLES;
+        double_state = legacy_next_state(double_state, double_avg);
+        end          = esp_cpu_get_cycle_count();
+        double_cycles += end - start;
 
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        if(float_state != double_state) {
+            state_mismatches++;
+        }
+        float error = fabsf(avg - (float) double_avg);
+        if(error > max_avg_error) {
+            max_avg_error = error;
+        }
     }
+
+    result->samples          = count;
+    result->float_cycles     = (uint32_t) (float_cycles / count);
+    result->double_cycles    = (uint32_t) (double_cycles / count);
+    result->state_mismatches = state_mismatches;
+    result->max_avg_error    = max_avg_error;
+
+    ESP_LOGI(TAG,
+            "Replay of %u readings: %lu cycles/reading in float vs %lu in double, %lu state mismatches, "
+            "max average error %.4f lux",
+            (unsigned) count,
+            (unsigned long) result->float_cycles,
+            (unsigned long) result->double_cycles,
+            (unsigned long) state_mismatches,
+            result->max_avg_error);
+    return ESP_OK;
 }
@@ -6,11 +6,14 @@
 #define DAY_NIGHT_DETECTOR_H
 
 #include "esp_err.h"
+#include "sample_stamp.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /** @brief Light thresholds in lux */
-#define NIGHT_THRESHOLD 10.0
-#define DAY_THRESHOLD   50.0
+#define NIGHT_THRESHOLD 10.0f
+#define DAY_THRESHOLD   50.0f
 
 /** @brief Event group bits */
 #define DAY_MODE_BIT   BIT0
@@ -26,6 +29,17 @@ typedef enum {
     LIGHT_STATE_TRANSITION
 } light_state_t;
 
+/**
+ * @brief Result of replaying raw sensor counts through the single and double precision pipelines
+ */
+typedef struct {
+    size_t samples;            // Readings replayed
+    uint32_t float_cycles;     // Average cycles per reading of the single precision pipeline
+    uint32_t double_cycles;    // Average cycles per reading of the previous double pipeline
+    uint32_t state_mismatches; // Readings after which the two pipelines disagree on the light state
+    float max_avg_error;       // Largest difference between the two averaged light levels in lux
+} light_replay_result_t;
+
 /**
  * @brief Initialize the day/night detector
  * 
@@ -60,7 +74,16 @@ bool is_night_mode(void);
  * @param lux Pointer to store lux value
  * @return esp_err_t ESP_OK on success
  */
-esp_err_t get_light_level(double *lux);
+esp_err_t get_light_level(float *lux);
+
+/**
+ * @brief Get current light level with the time it was read
+ * 
+ * @param lux Pointer to store lux value
+ * @param stamp Pointer to store the capture stamp, time_us is 0 before the first read
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t get_light_sample(float *lux, sample_stamp_t *stamp);
 
 /**
  * @brief Get current light state
@@ -76,4 +99,30 @@ light_state_t get_light_state(void);
  */
 void light_register_callback(void (*callback)(light_state_t state));
 
+/**
+ * @brief Choose between threshold and polling mode
+ * 
+ * In threshold mode the sensor is only read when the light leaves the hysteresis
+ * band of the current state, polling takes over while the state settles and
+ * whenever the thresholds can't be used. Enabled by default.
+ * 
+ * @param enable true to arm the ALS thresholds once the state is settled
+ */
+void day_night_use_thresholds(bool enable);
+
+/**
+ * @brief Replay raw ALS counts through the lux conversion, average and hysteresis
+ *
+ * Runs on private state, the live light level is not touched. Reports the per-reading
+ * cost of the single precision pipeline next to the previous one in double precision,
+ * which the ESP32 FPU can only emulate in software.
+ *
+ * @param counts Raw ALS counts, oldest first
+ * @param count Number of readings
+ * @param resolution Lux per count of the range the counts were taken with
+ * @param result Pointer to store the comparison
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t day_night_replay(const uint16_t *counts, size_t count, float resolution, light_replay_result_t *result);
+
 #endif /* DAY_NIGHT_DETECTOR_H */
\ No newline at end of file
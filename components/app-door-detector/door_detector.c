@@ -1,52 +1,84 @@
 /**
  * @file door_detector.c
- * @brief Door open/closed detection using TCRT5000 IR sensor
+ * @brief Door open/closed detection using TCRT5000 IR sensors, one per door
+ *
+ * All door sensors sit on the PCF8574, so one port read samples every door. The
+ * samples are debounced bit-parallel with a 2-bit vertical counter: bit n of cnt0
+ * and cnt1 is the counter of door n, and a door only flips after 4 equal samples.
  */
 #include "door_detector.h"
 #include "../infrared-tcrt5000/tcrt5000.h"
+#include "vehicle_state.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
 #include "driver/gpio.h"
-#include "pcf8574.h"
+#include "esp_timer.h"
+#include "expander_service.h"
 
 
 #define TAG "DOOR_DETECTOR"
 
+// One bit per door, used by the debouncer and the event group
+#define DOOR_MASK_ALL ((uint8_t) ((1u << DOOR_COUNT) - 1))
+
 // Event group bits
-#define DOOR_OPEN_BIT   BIT0
-#define DOOR_CLOSED_BIT BIT1
+#define DOOR_OPEN_BIT(door)   (1u << (door))
+#define DOOR_CLOSED_BIT(door) (1u << (DOOR_COUNT + (door)))
 
-#define TCRT5000_DIGITAL_PIN 1 // LPCF8574 P1 for emitter power
+// Queue size for events, room for every door changing at once
+#define DOOR_EVENT_QUEUE_SIZE (2 * DOOR_COUNT)
 
-// Queue size for events
-#define DOOR_EVENT_QUEUE_SIZE 10
+_Static_assert(DOOR_COUNT == VEHICLE_DOORS, "vehicle state doors out of sync");
+_Static_assert(DOOR_COUNT <= 8, "door masks are 8 bits wide");
 
-// Sensor configuration
-static tcrt5000_handle_t sensor;
-static const tcrt5000_config_t config = {
-    .use_digital   = true,
-    .digital_pin   = 1,    // P1 on PCF8574 (bit index)
-    .use_expander  = true, // tell driver to read from expander
-    .invert_output = false // true = LOW means detected
+// Sensor configuration, P0 is the crash signal
+static tcrt5000_handle_t sensors[DOOR_COUNT];
+static const uint8_t door_pins[DOOR_COUNT] = {
+    [DOOR_FRONT_RIGHT] = 2, // Check schematic if different
+    [DOOR_FRONT_LEFT]  = 1, // Original driver door sensor
+    [DOOR_BACK_RIGHT]  = 3, // Check schematic if different
+    [DOOR_BACK_LEFT]   = 4, // Check schematic if different
+    [DOOR_TRUNK]       = 5, // Check schematic if different
 };
 
-extern i2c_dev_t expander;
-extern uint8_t expander_state;
+/**
+ * @brief Vertical counter debouncer, one bit per door
+ */
+typedef struct {
+    uint8_t cnt0;   // Low bit of the per-door sample counters
+    uint8_t cnt1;   // High bit of the per-door sample counters
+    uint8_t stable; // Debounced levels, bit set = sensor detects the door closed
+} door_debounce_t;
 
 // Internal state
-static EventGroupHandle_t door_event_group       = NULL;
-static QueueHandle_t door_event_queue            = NULL;
-static door_state_t current_door_state           = DOOR_STATE_UNKNOWN;
-static void (*door_state_callback)(door_state_t) = NULL;
+static EventGroupHandle_t door_event_group                  = NULL;
+static QueueHandle_t door_event_queue                       = NULL;
+static door_state_t current_door_state[DOOR_COUNT]          = { 0 };
+static void (*door_state_callback)(door_id_t, door_state_t) = NULL;
+
+// Input-change mode, the edge time is 64-bit and only read together with its count under the lock
+static TaskHandle_t door_task_handle = NULL;
+static portMUX_TYPE int_edge_lock    = portMUX_INITIALIZER_UNLOCKED;
+static int64_t int_edge_us           = 0; // Time of the latest INT falling edge
+static uint32_t int_edge_count       = 0; // Edges seen by the ISR, read by the task to tell a wake-up from a timeout
 
 esp_err_t door_detector_init(void) {
-    esp_err_t ret = tcrt5000_init(&config, &sensor);
-    if(ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize TCRT5000 sensor: %s", esp_err_to_name(ret));
-        return ret;
+    for(int door = 0; door < DOOR_COUNT; door++) {
+        const tcrt5000_config_t config = {
+            .use_digital   = true,
+            .digital_pin   = door_pins[door], // Bit index on the PCF8574
+            .use_expander  = true,            // tell driver to read from expander
+            .invert_output = false            // true = LOW means detected
+        };
+
+        esp_err_t ret = tcrt5000_init(&config, &sensors[door]);
+        if(ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to initialize TCRT5000 sensor of door %d: %s", door, esp_err_to_name(ret));
+            return ret;
+        }
     }
 
     if(!door_event_group) {
@@ -65,24 +97,32 @@ esp_err_t door_detector_init(void) {
         }
     }
 
-    ESP_LOGI(TAG, "Door detector initialized");
+    ESP_LOGI(TAG, "Door detector initialized, %d doors", DOOR_COUNT);
     return ESP_OK;
 }
 
-bool is_door_open(void) {
-    if(!door_event_group)
+bool is_door_open(door_id_t door) {
+    if(!door_event_group || door >= DOOR_COUNT)
+        return false;
+    return (xEventGroupGetBits(door_event_group) & DOOR_OPEN_BIT(door));
+}
+
+bool is_door_closed(door_id_t door) {
+    if(!door_event_group || door >= DOOR_COUNT)
         return false;
-    return (xEventGroupGetBits(door_event_group) & DOOR_OPEN_BIT);
+    return (xEventGroupGetBits(door_event_group) & DOOR_CLOSED_BIT(door));
 }
 
-bool is_door_closed(void) {
+bool is_any_door_open(void) {
     if(!door_event_group)
         return false;
-    return (xEventGroupGetBits(door_event_group) & DOOR_CLOSED_BIT);
+    return (xEventGroupGetBits(door_event_group) & DOOR_MASK_ALL); // The open bits come first
 }
 
-door_state_t get_door_state(void) {
-    return current_door_state;
+door_state_t get_door_state(door_id_t door) {
+    if(door >= DOOR_COUNT)
+        return DOOR_STATE_UNKNOWN;
+    return current_door_state[door];
 }
 
 bool get_door_event(door_event_t *event, TickType_t wait_ticks) {
@@ -91,71 +131,205 @@ bool get_door_event(door_event_t *event, TickType_t wait_ticks) {
     return xQueueReceive(door_event_queue, event, wait_ticks) == pdTRUE;
 }
 
-void door_register_callback(void (*callback)(door_state_t state)) {
+void door_register_callback(void (*callback)(door_id_t door, door_state_t state)) {
     door_state_callback = callback;
 }
 
-static void update_door_state(door_state_t new_state) {
-    if(new_state == current_door_state)
+static void update_door_state(door_id_t door, door_state_t new_state, const sample_stamp_t *stamp) {
+    if(new_state == current_door_state[door])
         return;
 
-    current_door_state = new_state;
+    current_door_state[door] = new_state;
 
     // Event group
     if(new_state == DOOR_STATE_CLOSED) {
-        xEventGroupSetBits(door_event_group, DOOR_CLOSED_BIT);
-        xEventGroupClearBits(door_event_group, DOOR_OPEN_BIT);
-        ESP_LOGI(TAG, "Door CLOSED");
+        xEventGroupSetBits(door_event_group, DOOR_CLOSED_BIT(door));
+        xEventGroupClearBits(door_event_group, DOOR_OPEN_BIT(door));
+        ESP_LOGI(TAG, "Door %d CLOSED", door);
     } else {
-        xEventGroupSetBits(door_event_group, DOOR_OPEN_BIT);
-        xEventGroupClearBits(door_event_group, DOOR_CLOSED_BIT);
-        ESP_LOGI(TAG, "Door OPEN");
+        xEventGroupSetBits(door_event_group, DOOR_OPEN_BIT(door));
+        xEventGroupClearBits(door_event_group, DOOR_CLOSED_BIT(door));
+        ESP_LOGI(TAG, "Door %d OPEN", door);
     }
 
     // Queue event
-    door_event_t event = { .state = new_state, .timestamp = (uint32_t) (xTaskGetTickCount() * portTICK_PERIOD_MS) };
+    door_event_t event = { .door = door, .state = new_state, .timestamp = sample_stamp_ms(stamp), .stamp = *stamp };
     if(xQueueSend(door_event_queue, &event, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGW(TAG, "Door event queue full");
     }
 
+    vehicle_state_publish_door(door, new_state);
+
     // Optional user callback
     if(door_state_callback) {
-        door_state_callback(new_state);
+        door_state_callback(door, new_state);
+    }
+}
+
+/**
+ * @brief Map a port value to one bit per door, bit set = closed
+ */
+static uint8_t doors_from_port(uint8_t port) {
+    uint8_t closed = 0;
+
+    for(int door = 0; door < DOOR_COUNT; door++) {
+        bool detected = false;
+        if(tcrt5000_decode_port(&sensors[door], port, &detected) == ESP_OK && detected) {
+            closed |= 1u << door;
+        }
     }
+    return closed;
 }
 
+/**
+ * @brief Feed one sample of all doors into the vertical counters
+ *
+ * A door whose sample differs from its stable level counts up, any equal sample resets
+ * its counter. When the 2-bit counter wraps after 4 differing samples the door flips.
+ *
+ * @return uint8_t Doors whose stable level flipped with this sample
+ */
+static uint8_t door_debounce_step(door_debounce_t *db, uint8_t sample) {
+    uint8_t delta = sample ^ db->stable;
+    db->cnt1      = (db->cnt1 ^ db->cnt0) & delta;
+    db->cnt0      = ~db->cnt0 & delta;
+
+    // Counters that wrapped back to 0 on a differing sample flip their door
+    uint8_t toggle = delta & ~(db->cnt0 | db->cnt1);
+    db->stable ^= toggle;
+    return toggle;
+}
+
+#if DOOR_USE_EXPANDER_INT
+/**
+ * @brief PCF8574 INT handler, timestamps the input change and wakes the door task
+ */
+static void IRAM_ATTR door_int_isr_handler(void *arg) {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+
+    portENTER_CRITICAL_ISR(&int_edge_lock);
+    int_edge_us = esp_timer_get_time();
+    int_edge_count++;
+    portEXIT_CRITICAL_ISR(&int_edge_lock);
+
+    if(door_task_handle) {
+        vTaskNotifyGiveFromISR(door_task_handle, &higher_priority_task_woken);
+    }
+
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+/**
+ * @brief Hook the PCF8574 INT line, it is pulled low on any input change until the port is read
+ */
+static esp_err_t door_int_init(void) {
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << DOOR_EXPANDER_INT_GPIO),
+        .mode         = GPIO_MODE_INPUT,
+        .pull_up_en   = GPIO_PULLUP_ENABLE, // INT is open drain
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type    = GPIO_INTR_NEGEDGE,
+    };
+
+    esp_err_t err = gpio_config(&io_conf);
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    // The ISR service may already be installed by another driver
+    err = gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
+    if(err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+
+    return gpio_isr_handler_add(DOOR_EXPANDER_INT_GPIO, door_int_isr_handler, NULL);
+}
+#endif
+
 void door_detector_task(void *pvParameters) {
     if(door_detector_init() != ESP_OK) {
         vTaskDelete(NULL);
         return;
     }
 
-    bool detected = false, prev_detected = false;
-    int stable_count         = 0;
-    const int DEBOUNCE_COUNT = 3;
+    door_task_handle = xTaskGetCurrentTaskHandle();
+
+    TickType_t idle_wait = pdMS_TO_TICKS(DOOR_POLL_MS);
+#if DOOR_USE_EXPANDER_INT
+    esp_err_t int_ret = door_int_init();
+    if(int_ret == ESP_OK) {
+        idle_wait = pdMS_TO_TICKS(DOOR_SAFETY_POLL_MS);
+        ESP_LOGI(TAG, "Expander INT on GPIO %d, input-change mode", DOOR_EXPANDER_INT_GPIO);
+    } else {
+        ESP_LOGW(TAG, "Expander INT unavailable (%s), polling every %d ms", esp_err_to_name(int_ret), DOOR_POLL_MS);
+    }
+#endif
+
+    door_debounce_t debounce                = { 0 };
+    uint8_t last_sample                     = 0;
+    bool first_sample                       = true;
+    bool pending                            = false;
+    uint32_t edges_seen                     = int_edge_count;
+    sample_stamp_t change_stamp[DOOR_COUNT] = { 0 };
 
     while(1) {
-        esp_err_t ret = tcrt5000_read_digital(&sensor, &detected);
+        // While a door is bouncing it is sampled at a fixed short period until its counter settles,
+        // one extra tick because the first one ends at the next tick boundary, possibly right away
+        TickType_t wait = pending ? pdMS_TO_TICKS(DOOR_SAMPLE_MS) + 1 : idle_wait;
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        // One forced port read serves every door and also releases the INT line
+        uint8_t port  = 0;
+        esp_err_t ret = expander_service_read(&port, 0);
         if(ret != ESP_OK) {
-            ESP_LOGE(TAG, "TCRT5000 read failed: %s", esp_err_to_name(ret));
-            vTaskDelay(pdMS_TO_TICKS(100));
+            ESP_LOGE(TAG, "Expander read failed: %s", esp_err_to_name(ret));
+            vTaskDelay(pdMS_TO_TICKS(DOOR_POLL_MS));
             continue;
         }
 
-        if(detected == prev_detected) {
-            stable_count++;
+        // Date the read to the INT edge when one arrived, otherwise to the read itself
+        portENTER_CRITICAL(&int_edge_lock);
+        uint32_t edges  = int_edge_count;
+        int64_t edge_us = int_edge_us;
+        portEXIT_CRITICAL(&int_edge_lock);
+
+        bool woken           = edges != edges_seen;
+        edges_seen           = edges;
+        sample_stamp_t stamp = woken ? sample_stamp_at(SAMPLE_SOURCE_DOOR, edge_us)
+                                     : sample_stamp_take(SAMPLE_SOURCE_DOOR);
+
+        uint8_t sample = doors_from_port(port);
+        uint8_t flipped;
+
+        if(first_sample) {
+            // The first read is taken as is, every door leaves the unknown state at once
+            debounce.stable = sample;
+            last_sample     = sample;
+            flipped         = DOOR_MASK_ALL;
+            first_sample    = false;
+            for(int door = 0; door < DOOR_COUNT; door++) {
+                change_stamp[door] = stamp;
+            }
         } else {
-            stable_count = 0;
+            // A door's event is dated to the edge of its last raw transition
+            uint8_t moved = sample ^ last_sample;
+            last_sample   = sample;
+            for(int door = 0; door < DOOR_COUNT; door++) {
+                if(moved & (1u << door)) {
+                    change_stamp[door] = stamp;
+                }
+            }
+
+            flipped = door_debounce_step(&debounce, sample);
         }
 
-        prev_detected = detected;
+        pending = sample != debounce.stable;
 
-        if(stable_count >= DEBOUNCE_COUNT) {
-            door_state_t new_state = detected ? DOOR_STATE_CLOSED : DOOR_STATE_OPEN;
-            update_door_state(new_state);
-            stable_count = 0;
+        for(int door = 0; door < DOOR_COUNT; door++) {
+            if(flipped & (1u << door)) {
+                door_state_t state = (debounce.stable & (1u << door)) ? DOOR_STATE_CLOSED : DOOR_STATE_OPEN;
+                update_door_state((door_id_t) door, state, &change_stamp[door]);
+            }
         }
-
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
 }
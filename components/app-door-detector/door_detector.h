@@ -1,6 +1,6 @@
 /**
  * @file door_detector.h
- * @brief Door open/closed detection using TCRT5000 IR reflective sensor
+ * @brief Door open/closed detection using TCRT5000 IR reflective sensors, one per door
  */
 #ifndef DOOR_DETECTOR_H
 #define DOOR_DETECTOR_H
@@ -8,6 +8,35 @@
 #include "esp_err.h"
 #include <stdbool.h>
 #include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "sample_stamp.h"
+
+/** @brief Wake the door task from the PCF8574 INT line instead of polling the expander */
+#define DOOR_USE_EXPANDER_INT 1
+
+/** @brief GPIO connected to the PCF8574 INT pin (open drain, active low) */
+#define DOOR_EXPANDER_INT_GPIO GPIO_NUM_33 // Check schematic if different
+
+/** @brief Minimum sample period while an input is bouncing, 4 equal samples (40-80 ms at 100 Hz) accept a level */
+#define DOOR_SAMPLE_MS 10
+
+/** @brief Expander poll period when the INT line is not used or could not be hooked */
+#define DOOR_POLL_MS 100
+
+/** @brief Period the port is re-read in input-change mode, only covers a missed INT edge */
+#define DOOR_SAFETY_POLL_MS 5000
+
+/**
+ * @brief Monitored doors, same order as gui_doors_t
+ */
+typedef enum {
+    DOOR_FRONT_RIGHT,
+    DOOR_FRONT_LEFT,
+    DOOR_BACK_RIGHT,
+    DOOR_BACK_LEFT,
+    DOOR_TRUNK,
+    DOOR_COUNT
+} door_id_t;
 
 /**
  * @brief Door state enumeration
@@ -22,8 +51,10 @@ typedef enum {
  * @brief Door event structure
  */
 typedef struct {
+    door_id_t door;
     door_state_t state;
-    uint32_t timestamp;
+    uint32_t timestamp;   // Capture time in milliseconds, same clock as stamp
+    sample_stamp_t stamp; // Capture of the first read that saw the new state
 } door_event_t;
 
 /**
@@ -41,25 +72,35 @@ esp_err_t door_detector_init(void);
 void door_detector_task(void *pvParameters);
 
 /**
- * @brief Check if the door is currently open
+ * @brief Check if a door is currently open
  * 
+ * @param door Door to check
  * @return bool true if door is open
  */
-bool is_door_open(void);
+bool is_door_open(door_id_t door);
 
 /**
- * @brief Check if the door is currently closed
+ * @brief Check if a door is currently closed
  * 
+ * @param door Door to check
  * @return bool true if door is closed
  */
-bool is_door_closed(void);
+bool is_door_closed(door_id_t door);
+
+/**
+ * @brief Check if any door is currently open
+ * 
+ * @return bool true if at least one door is open
+ */
+bool is_any_door_open(void);
 
 /**
- * @brief Get the current door state
+ * @brief Get the current state of a door
  * 
- * @return door_state_t Current door state
+ * @param door Door to query
+ * @return door_state_t Current door state, DOOR_STATE_UNKNOWN for an invalid door
  */
-door_state_t get_door_state(void);
+door_state_t get_door_state(door_id_t door);
 
 /**
  * @brief Get door state change event from queue
@@ -73,8 +114,8 @@ bool get_door_event(door_event_t *event, TickType_t wait_ticks);
 /**
  * @brief Register callback for door state changes
  * 
- * @param callback Function to call when door state changes
+ * @param callback Function to call when a door changes state
  */
-void door_register_callback(void (*callback)(door_state_t state));
+void door_register_callback(void (*callback)(door_id_t door, door_state_t state));
 
 #endif /* DOOR_DETECTOR_H */
\ No newline at end of file
@@ -0,0 +1,112 @@
+/**
+ * @file distance_filter.c
+ * @brief Streaming median filter with jump rejection for ultrasonic distances
+ *
+ * A sample is first checked against the current output: an object can only move
+ * DISTANCE_FILTER_MAX_RATE_CM_S since the last accepted sample, anything further is
+ * a multipath echo or crosstalk and is rejected. When the rejects keep agreeing with
+ * each other a new object has entered the beam and the window is re-seeded with it.
+ * Accepted samples go through a running median, which removes the remaining spikes
+ * without the lag of an average.
+ */
+#include "distance_filter.h"
+#include "ultrasonic.h"
+#include <string.h>
+
+static void window_seed(distance_filter_t *filter, uint16_t distance_cm) {
+    filter->window[0] = distance_cm;
+    filter->head      = 1 % DISTANCE_FILTER_WINDOW;
+    filter->count     = 1;
+    filter->output_cm = distance_cm;
+}
+
+static uint16_t window_median(const distance_filter_t *filter) {
+    uint16_t sorted[DISTANCE_FILTER_WINDOW];
+
+    // Insertion sort, at most five elements
+    for(uint8_t i = 0; i < filter->count; i++) {
+        uint16_t value = filter->window[i];
+        int j          = i - 1;
+        while(j >= 0 && sorted[j] > value) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = value;
+    }
+
+    return sorted[filter->count / 2];
+}
+
+static uint32_t distance_diff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+static uint8_t confidence_add(uint8_t confidence, int delta) {
+    int value = confidence + delta;
+    return value < 0 ? 0 : value > 100 ? 100 : value;
+}
+
+void distance_filter_init(distance_filter_t *filter, uint32_t max_cm) {
+    memset(filter, 0, sizeof(*filter));
+    filter->max_cm    = max_cm;
+    filter->output_cm = max_cm;
+}
+
+bool distance_filter_update(distance_filter_t *filter, esp_err_t err, uint32_t distance_cm, int64_t capture_us) {
+    if(err == ESP_ERR_ULTRASONIC_ECHO_TIMEOUT) {
+        distance_cm = filter->max_cm;
+    } else if(err != ESP_OK) {
+        filter->confidence = confidence_add(filter->confidence, -DISTANCE_FILTER_CONF_MISS);
+        if(filter->confidence == 0) {
+            distance_filter_init(filter, filter->max_cm);
+        }
+        return false;
+    }
+
+    if(distance_cm > filter->max_cm) {
+        distance_cm = filter->max_cm;
+    }
+
+    if(filter->count == 0) {
+        window_seed(filter, distance_cm);
+        filter->last_us    = capture_us;
+        filter->confidence = DISTANCE_FILTER_CONF_ACCEPT;
+        return true;
+    }
+
+    // Furthest the tracked object could have moved since the last accepted sample
+    int64_t elapsed_us = capture_us - filter->last_us;
+    uint32_t allowed   = DISTANCE_FILTER_JUMP_SLACK_CM + elapsed_us * DISTANCE_FILTER_MAX_RATE_CM_S / 1000000;
+
+    if(distance_diff(distance_cm, filter->output_cm) > allowed) {
+        // Rejects that agree with each other are a new object rather than noise
+        bool consistent = filter->rejects > 0
+                          && distance_diff(distance_cm, filter->reject_cm) <= DISTANCE_FILTER_JUMP_SLACK_CM;
+
+        filter->rejects   = consistent ? filter->rejects + 1 : 1;
+        filter->reject_cm = distance_cm;
+
+        if(filter->rejects < DISTANCE_FILTER_MAX_REJECTS) {
+            filter->confidence = confidence_add(filter->confidence, -DISTANCE_FILTER_CONF_REJECT);
+            return false;
+        }
+
+        window_seed(filter, distance_cm);
+        filter->rejects    = 0;
+        filter->last_us    = capture_us;
+        filter->confidence = DISTANCE_FILTER_CONF_ACCEPT;
+        return true;
+    }
+
+    filter->window[filter->head] = distance_cm;
+    filter->head                 = (filter->head + 1) % DISTANCE_FILTER_WINDOW;
+    if(filter->count < DISTANCE_FILTER_WINDOW) {
+        filter->count++;
+    }
+
+    filter->output_cm  = window_median(filter);
+    filter->rejects    = 0;
+    filter->last_us    = capture_us;
+    filter->confidence = confidence_add(filter->confidence, DISTANCE_FILTER_CONF_ACCEPT);
+    return true;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file distance_filter.h
+ * @brief Streaming median filter with jump rejection for ultrasonic distances
+ */
+#ifndef DISTANCE_FILTER_H
+#define DISTANCE_FILTER_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Running median window, odd so that the median is a real sample */
+#define DISTANCE_FILTER_WINDOW 5
+
+/** @brief Jump rejection, the object can not approach or recede faster than this */
+#define DISTANCE_FILTER_MAX_RATE_CM_S 300 // ~11 km/h, well above parking speed
+#define DISTANCE_FILTER_JUMP_SLACK_CM 15  // Allowed on top of the rate, covers echo jitter
+#define DISTANCE_FILTER_MAX_REJECTS   3   // Consistent rejects in a row mean a new object, re-acquire
+
+/** @brief Confidence in percent */
+#define DISTANCE_FILTER_CONF_ACCEPT 20 // Gained per accepted sample
+#define DISTANCE_FILTER_CONF_REJECT 25 // Lost per rejected jump
+#define DISTANCE_FILTER_CONF_MISS   34 // Lost per failed measurement, three misses drop the target
+
+/**
+ * @brief Filter state, fixed size
+ */
+typedef struct {
+    uint16_t window[DISTANCE_FILTER_WINDOW]; // Accepted samples in cm, ring
+    uint8_t head;                            // Next slot of the ring
+    uint8_t count;                           // Valid samples in the ring
+    uint8_t rejects;                         // Consecutive rejected jumps
+    uint8_t confidence;                      // 0..100
+    uint16_t reject_cm;                      // Last rejected sample, a candidate new target
+    uint32_t output_cm;                      // Filtered distance
+    uint32_t max_cm;                         // Reported while nothing is tracked
+    int64_t last_us;                         // Capture time of the last accepted sample
+} distance_filter_t;
+
+/**
+ * @brief Reset the filter, nothing tracked
+ *
+ * @param filter Filter state
+ * @param max_cm Distance reported while nothing is tracked
+ */
+void distance_filter_init(distance_filter_t *filter, uint32_t max_cm);
+
+/**
+ * @brief Feed one measurement
+ *
+ * An echo timeout is a valid reading of nothing in range, any other error counts as a miss.
+ *
+ * @param filter Filter state
+ * @param err Result of the measurement
+ * @param distance_cm Measured distance, ignored on error
+ * @param capture_us Capture time of the measurement in us
+ * @return bool true if the sample was accepted into the window
+ */
+bool distance_filter_update(distance_filter_t *filter, esp_err_t err, uint32_t distance_cm, int64_t capture_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISTANCE_FILTER_H */
@@ -1,48 +1,491 @@
 /**
  * @file parking_sensor.c
- * @brief Parking sensor logic using HC-SR04 ultrasonic sensor
+ * @brief Parking sensor logic using an array of HC-SR04 ultrasonic sensors
+ *
+ * The transducers of one sector face the same way and hear each other's bursts,
+ * so they take turns. Sectors face away from each other and ping concurrently.
+ * Within a sector the most overdue transducer goes next, each one at the interval
+ * its own time to collision asks for.
  */
 #include "../ultrasonic-hc-sr04/ultrasonic.h"
 #include "parking_sensor.h"
+#include "distance_filter.h"
+#include "ttc_estimator.h"
 #include "../buzzer/buzzer.h"
+#include "vehicle_state.h"
+#include "speed_estimator.h"
 #include "esp_log.h"
+#include "esp_attr.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
 #include <inttypes.h>
+#include <math.h>
 
 static const char *TAG = "PARKING_SENSOR";
 
-#define ULTRASONIC_TRIGGER_PIN GPIO_NUM_27 // LED_G 12
-#define ULTRASONIC_ECHO_PIN    GPIO_NUM_34 // JOY_X 6
+// Ping scheduling, the interval of every transducer follows its time to collision
+#define PING_MIN_INTERVAL_MS    60   // HC-SR04 needs the previous echo to die out
+#define PING_NEAR_INTERVAL_MS   200  // Obstacle in range, not approaching
+#define PING_IDLE_INTERVAL_MS   500  // Nothing in range
+#define PING_PARKED_INTERVAL_MS 1000 // Nothing has moved for PING_PARKED_AFTER_MS
+#define PING_PARKED_AFTER_MS    5000
+#define PINGS_PER_TTC           10   // Measurements before the obstacle is reached
+#define PING_CROSSTALK_GUARD_MS 15   // Quiet time of a sector between two pings, lets stray echoes fade
+#define PING_STUCK_MS           100  // A ping without result after this is given up
 
-static ultrasonic_sensor_t sensor = { .trigger_pin = ULTRASONIC_TRIGGER_PIN, .echo_pin = ULTRASONIC_ECHO_PIN };
+// Beeps are played by the buzzer pattern engine, posting one never delays a ping
+#define BEEP_ON_MS             50
+#define BEEP_DUTY              500 // Moderate intensity (depends on LEDC resolution)
+#define BEEP_PERIOD_ALERT_MS   100
+#define BEEP_PERIOD_DANGER_MS  150
+#define BEEP_PERIOD_WARNING_MS 350
+#define BEEP_PERIOD_SAFE_MS    750
 
-static uint32_t current_distance = MAX_DISTANCE;
+// Run parking_sensor_replay() on the built-in trace when the task starts, needs no sensor
+#ifndef PARKING_REPLAY_ON_START
+#define PARKING_REPLAY_ON_START 0
+#endif
+
+_Static_assert(PARKING_SECTOR_NUM == VEHICLE_PARKING_SECTORS, "vehicle state sectors out of sync");
+
+typedef struct {
+    ultrasonic_sensor_t sensor;
+    parking_sector_t sector;
+} transducer_config_t;
+
+// Mounted transducers, add one line per sensor. Up to six are hardware timed,
+// further ones fall back to busy-waiting on the echo pin.
+static const transducer_config_t transducer_config[] = {
+    // LED_G 12, JOY_X 6
+    { .sensor = { .trigger_pin = GPIO_NUM_27, .echo_pin = GPIO_NUM_34 }, .sector = PARKING_SECTOR_REAR },
+};
+
+#define TRANSDUCER_COUNT ((int) (sizeof(transducer_config) / sizeof(transducer_config[0])))
+
+// A lone transducer is reported in the sector the vehicle drives towards instead of its configured one
+#define SINGLE_TRANSDUCER_FOLLOWS_DRIVE 1
+
+typedef struct {
+    bool enabled;                        // Initialized, false when the sensor failed
+    ultrasonic_capture_handle_t capture; // Hardware timed measurements, NULL when busy-waiting
+    distance_filter_t filter;
+    ttc_estimator_t ttc;
+    uint32_t ttc_ms;
+    float closing_cm_s;
+    sample_stamp_t stamp;
+    int64_t ping_us;        // Start of the last ping
+    int64_t due_us;         // Start of the next ping
+    int64_t still_since_us; // Last time anything moved in front of the sensor
+} transducer_t;
+
+// One ping in flight per sector
+typedef struct {
+    int active;      // Transducer with a ping in flight, -1 when idle
+    int64_t free_us; // Earliest start of the next ping
+} ping_lane_t;
+
+// Completion of an asynchronous ping
+typedef struct {
+    int index;
+    ultrasonic_capture_result_t result;
+} echo_event_t;
+
+static transducer_t transducers[TRANSDUCER_COUNT];
+static ping_lane_t lanes[PARKING_SECTOR_NUM];
+static QueueHandle_t echo_queue = NULL;
+
+// Outputs, written by the task and copied out under the lock
+static portMUX_TYPE output_lock        = portMUX_INITIALIZER_UNLOCKED;
+static parking_sector_map_t sector_map = { 0 };
+static uint32_t current_distance       = MAX_DISTANCE;
+static uint8_t current_confidence      = 0;
+static uint32_t current_ttc_ms         = PARKING_TTC_NONE;
+static float current_closing_cm_s      = 0.0f;
+static sample_stamp_t current_stamp    = { 0 };
+
+static uint32_t beep_period_ms = 0;
+
+// Sector of a lone transducer, held while the vehicle stands still or turns
+static parking_sector_t drive_sector = PARKING_SECTOR_REAR;
+
+static parking_zone_t distance_zone(uint32_t distance) {
+    if(distance < DISTANCE_DANGER) {
+        return PARKING_ZONE_DANGER;
+    } else if(distance < DISTANCE_WARNING) {
+        return PARKING_ZONE_WARNING;
+    } else if(distance < DISTANCE_SAFE) {
+        return PARKING_ZONE_SAFE;
+    }
+    return PARKING_ZONE_CLEAR;
+}
+
+/**
+ * @brief Change the beep rhythm, 0 silences the buzzer
+ */
+static void beep_set_period(uint32_t period_ms) {
+    if(period_ms == beep_period_ms)
+        return;
+
+    beep_period_ms = period_ms;
+    if(period_ms == 0) {
+        buzzer_stop(BUZZER_PRIORITY_PARKING);
+        return;
+    }
+
+    buzzer_pattern_t pattern = {
+        .on_ms    = BEEP_ON_MS,
+        .off_ms   = period_ms - BEEP_ON_MS,
+        .repeat   = BUZZER_REPEAT_FOREVER,
+        .duty     = BEEP_DUTY,
+        .priority = BUZZER_PRIORITY_PARKING,
+    };
+    buzzer_play(&pattern);
+}
+
+/**
+ * @brief Beep faster the closer the obstacle, a fast approach overrides the zones
+ */
+static uint32_t beep_period_for(uint32_t distance, uint32_t ttc_ms) {
+    if(ttc_ms < PARKING_TTC_ALERT_MS)
+        return BEEP_PERIOD_ALERT_MS;
+
+    switch(distance_zone(distance)) {
+        case PARKING_ZONE_DANGER:
+            return BEEP_PERIOD_DANGER_MS;
+        case PARKING_ZONE_WARNING:
+            return BEEP_PERIOD_WARNING_MS;
+        case PARKING_ZONE_SAFE:
+            return BEEP_PERIOD_SAFE_MS;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Time until the next ping, faster as the obstacle closes in
+ */
+static uint32_t ping_interval_for(uint32_t distance, uint32_t ttc_ms, uint32_t still_ms) {
+    if(ttc_ms != PARKING_TTC_NONE) {
+        uint32_t interval = ttc_ms / PINGS_PER_TTC;
+        if(interval < PING_MIN_INTERVAL_MS)
+            return PING_MIN_INTERVAL_MS;
+        return interval > PING_NEAR_INTERVAL_MS ? PING_NEAR_INTERVAL_MS : interval;
+    }
+
+    if(still_ms >= PING_PARKED_AFTER_MS)
+        return PING_PARKED_INTERVAL_MS;
+
+    return distance < DISTANCE_SAFE ? PING_NEAR_INTERVAL_MS : PING_IDLE_INTERVAL_MS;
+}
+
+/**
+ * @brief Completion of an asynchronous ping, hands the result to the task
+ */
+static bool IRAM_ATTR echo_done_cb(const ultrasonic_capture_result_t *result, void *arg) {
+    echo_event_t event = { .index = (int) (intptr_t) arg, .result = *result };
+    BaseType_t woken   = pdFALSE;
+
+    if(xPortInIsrContext()) {
+        xQueueSendFromISR(echo_queue, &event, &woken);
+    } else {
+        xQueueSend(echo_queue, &event, 0);
+    }
+    return woken == pdTRUE;
+}
+
+/**
+ * @brief Feed one measurement of a transducer through its filter and TTC estimator
+ */
+static void transducer_update(int index, esp_err_t ret, uint32_t measured, int64_t capture_us) {
+    transducer_t *t = &transducers[index];
+
+    if(ret != ESP_OK) {
+        capture_us = esp_timer_get_time();
+        if(ret != ESP_ERR_ULTRASONIC_ECHO_TIMEOUT) {
+            ESP_LOGE(TAG, "Transducer %d: distance read failed: %s", index, esp_err_to_name(ret));
+        }
+    }
+
+    // A single spike or missed echo only lowers the confidence, the distance holds
+    if(distance_filter_update(&t->filter, ret, measured, capture_us)) {
+        t->stamp = sample_stamp_at(SAMPLE_SOURCE_ULTRASONIC, capture_us);
+
+        // A re-seeded window is a different obstacle, its approach starts from scratch
+        if(t->filter.count == 1 || t->filter.output_cm >= MAX_DISTANCE) {
+            ttc_estimator_reset(&t->ttc);
+        }
+        if(t->filter.output_cm < MAX_DISTANCE) {
+            ttc_estimator_update(&t->ttc, t->filter.output_cm, capture_us);
+        }
+    } else if(ret == ESP_OK) {
+        ESP_LOGD(TAG, "Transducer %d: rejected jump to %" PRIu32 " cm", index, measured);
+    }
+    if(t->filter.confidence == 0) {
+        ttc_estimator_reset(&t->ttc);
+    }
+
+    t->ttc_ms       = ttc_estimator_ttc_ms(&t->ttc);
+    t->closing_cm_s = ttc_estimator_closing_cm_s(&t->ttc);
+
+    // Anything moving in front of the sensor keeps the fast cadence
+    if(t->ttc_ms != PARKING_TTC_NONE || fabsf(t->closing_cm_s) >= TTC_MIN_CLOSING_CM_S) {
+        t->still_since_us = capture_us;
+    }
+    uint32_t still_ms = (uint32_t) ((esp_timer_get_time() - t->still_since_us) / 1000);
+
+    t->due_us = t->ping_us + 1000LL * ping_interval_for(t->filter.output_cm, t->ttc_ms, still_ms);
+}
+
+/**
+ * @brief Sector a transducer is reported in, pings are still scheduled by its configured sector
+ */
+static parking_sector_t transducer_sector(int index) {
+#if SINGLE_TRANSDUCER_FOLLOWS_DRIVE
+    if(TRANSDUCER_COUNT == 1) {
+        movement_direction_t direction = speed_estimator_get_direction();
+        if(direction == DIRECTION_FORWARD) {
+            drive_sector = PARKING_SECTOR_FRONT;
+        } else if(direction == DIRECTION_BACKWARD) {
+            drive_sector = PARKING_SECTOR_REAR;
+        }
+        return drive_sector;
+    }
+#endif
+    return transducer_config[index].sector;
+}
+
+/**
+ * @brief Merge the transducers into the sector map, publish it and set the beeps
+ */
+static void outputs_update(void) {
+    parking_sector_map_t map;
+    const transducer_t *nearest = NULL;
+    const transducer_t *fastest = NULL;
+
+    for(int s = 0; s < PARKING_SECTOR_NUM; s++) {
+        map.distance_cm[s] = MAX_DISTANCE;
+        map.confidence[s]  = 0;
+        map.ttc_ms[s]      = PARKING_TTC_NONE;
+    }
+
+    for(int i = 0; i < TRANSDUCER_COUNT; i++) {
+        const transducer_t *t = &transducers[i];
+        parking_sector_t s    = transducer_sector(i);
+        if(!t->enabled)
+            continue;
+
+        if(t->filter.output_cm < map.distance_cm[s]) {
+            map.distance_cm[s] = t->filter.output_cm;
+            map.confidence[s]  = t->filter.confidence;
+        }
+        if(t->ttc_ms < map.ttc_ms[s]) {
+            map.ttc_ms[s] = t->ttc_ms;
+        }
+        if(nearest == NULL || t->filter.output_cm < nearest->filter.output_cm) {
+            nearest = t;
+        }
+        if(fastest == NULL || t->ttc_ms < fastest->ttc_ms) {
+            fastest = t;
+        }
+    }
+
+    int zones[PARKING_SECTOR_NUM];
+    for(int s = 0; s < PARKING_SECTOR_NUM; s++) {
+        map.zone[s] = map.ttc_ms[s] < PARKING_TTC_ALERT_MS ? PARKING_ZONE_DANGER : distance_zone(map.distance_cm[s]);
+        zones[s]    = map.zone[s];
+    }
+
+    portENTER_CRITICAL(&output_lock);
+    sector_map = map;
+    if(nearest) {
+        current_distance   = nearest->filter.output_cm;
+        current_confidence = nearest->filter.confidence;
+        current_stamp      = nearest->stamp;
+    }
+    if(fastest) {
+        current_ttc_ms       = fastest->ttc_ms;
+        current_closing_cm_s = fastest->closing_cm_s;
+    }
+    portEXIT_CRITICAL(&output_lock);
+
+    vehicle_state_publish_distance(current_distance);
+    vehicle_state_publish_ttc(current_ttc_ms, current_closing_cm_s);
+    vehicle_state_publish_sectors(map.distance_cm, zones);
+
+    beep_set_period(beep_period_for(current_distance, current_ttc_ms));
+}
+
+/**
+ * @brief Start the next ping of a sector if its lane is free
+ *
+ * @return int64_t Time at which the sector wants to be looked at again
+ */
+static int64_t lane_service(parking_sector_t sector, int64_t now) {
+    ping_lane_t *lane = &lanes[sector];
+
+    if(lane->active >= 0) {
+        if(now - transducers[lane->active].ping_us < PING_STUCK_MS * 1000LL)
+            return transducers[lane->active].ping_us + PING_STUCK_MS * 1000LL;
+
+        // The result got lost, count it as a miss and move on
+        int index    = lane->active;
+        lane->active = -1;
+        transducer_update(index, ESP_ERR_TIMEOUT, 0, 0);
+        outputs_update();
+    }
+    if(now < lane->free_us)
+        return lane->free_us;
+
+    // Most overdue transducer of the sector goes next
+    int next = -1;
+    for(int i = 0; i < TRANSDUCER_COUNT; i++) {
+        if(!transducers[i].enabled || transducer_config[i].sector != sector)
+            continue;
+        if(next < 0 || transducers[i].due_us < transducers[next].due_us) {
+            next = i;
+        }
+    }
+    if(next < 0)
+        return INT64_MAX;
+    if(transducers[next].due_us > now)
+        return transducers[next].due_us;
+
+    transducer_t *t = &transducers[next];
+    t->ping_us      = now;
+
+    if(t->capture) {
+        esp_err_t ret = ultrasonic_capture_start(t->capture,
+                MAX_DISTANCE * ULTRASONIC_ROUNDTRIP_CM,
+                echo_done_cb,
+                (void *) (intptr_t) next);
+        if(ret == ESP_OK) {
+            lane->active = next;
+            return now + PING_STUCK_MS * 1000LL;
+        }
+        transducer_update(next, ret, 0, 0);
+    } else {
+        uint32_t measured  = 0;
+        int64_t capture_us = 0;
+        esp_err_t ret      = ultrasonic_measure_cm_at(&transducer_config[next].sensor,
+                MAX_DISTANCE,
+                &measured,
+                &capture_us);
+        transducer_update(next, ret, measured, capture_us);
+    }
+
+    lane->free_us = esp_timer_get_time() + PING_CROSSTALK_GUARD_MS * 1000LL;
+    outputs_update();
+    return lane->free_us;
+}
 
 esp_err_t parking_sensor_init(void) {
     esp_err_t ret;
+    int enabled = 0;
 
-    ret = ultrasonic_init(&sensor);
-    if(ret != ESP_OK) {
-        ESP_LOGE(TAG, "Ultrasonic sensor init failed: %s", esp_err_to_name(ret));
-        return ret;
+    if(echo_queue == NULL) {
+        echo_queue = xQueueCreate(2 * TRANSDUCER_COUNT, sizeof(echo_event_t));
+        if(echo_queue == NULL)
+            return ESP_ERR_NO_MEM;
     }
 
+    int64_t now = esp_timer_get_time();
+    for(int i = 0; i < TRANSDUCER_COUNT; i++) {
+        transducer_t *t = &transducers[i];
+
+        // Prefer the MCPWM capture unit, busy-waiting disables interrupts for the whole echo
+        ret = ultrasonic_capture_init(&transducer_config[i].sensor, &t->capture);
+        if(ret != ESP_OK) {
+            ESP_LOGW(TAG,
+                    "Transducer %d: echo capture unavailable (%s), measuring in software",
+                    i,
+                    esp_err_to_name(ret));
+            t->capture = NULL;
+
+            ret = ultrasonic_init(&transducer_config[i].sensor);
+            if(ret != ESP_OK) {
+                ESP_LOGE(TAG, "Transducer %d: ultrasonic sensor init failed: %s", i, esp_err_to_name(ret));
+                continue;
+            }
+        }
+
+        distance_filter_init(&t->filter, MAX_DISTANCE);
+        ttc_estimator_reset(&t->ttc);
+        t->ttc_ms         = PARKING_TTC_NONE;
+        t->due_us         = now;
+        t->still_since_us = now;
+        t->enabled        = true;
+        enabled++;
+    }
+    if(enabled == 0) {
+        ESP_LOGE(TAG, "No ultrasonic sensor available");
+        return ESP_FAIL;
+    }
+
+    for(int s = 0; s < PARKING_SECTOR_NUM; s++) {
+        lanes[s].active  = -1;
+        lanes[s].free_us = now;
+    }
+    drive_sector = transducer_config[0].sector;
+
     ret = buzzer_init();
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "Buzzer init failed: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    ESP_LOGI(TAG, "Parking sensor initialized");
+    ESP_LOGI(TAG, "Parking sensor initialized, %d of %d transducers", enabled, TRANSDUCER_COUNT);
     return ESP_OK;
 }
 
-esp_err_t parking_sensor_get_distance(uint32_t *distance) {
+esp_err_t parking_sensor_get_distance(uint32_t *distance, uint8_t *confidence) {
     if(!distance)
         return ESP_ERR_INVALID_ARG;
 
+    portENTER_CRITICAL(&output_lock);
+    *distance = current_distance;
+    if(confidence)
+        *confidence = current_confidence;
+    portEXIT_CRITICAL(&output_lock);
+    return ESP_OK;
+}
+
+esp_err_t parking_sensor_get_ttc_ms(uint32_t *ttc_ms, float *closing_cm_s) {
+    if(!ttc_ms)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&output_lock);
+    *ttc_ms = current_ttc_ms;
+    if(closing_cm_s)
+        *closing_cm_s = current_closing_cm_s;
+    portEXIT_CRITICAL(&output_lock);
+    return ESP_OK;
+}
+
+bool parking_sensor_is_collision_imminent(void) {
+    return current_ttc_ms < PARKING_TTC_ALERT_MS;
+}
+
+esp_err_t parking_sensor_get_sample(uint32_t *distance, sample_stamp_t *stamp) {
+    if(!distance || !stamp)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&output_lock);
     *distance = current_distance;
+    *stamp    = current_stamp;
+    portEXIT_CRITICAL(&output_lock);
+    return ESP_OK;
+}
+
+esp_err_t parking_sensor_get_sector_map(parking_sector_map_t *map) {
+    if(!map)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&output_lock);
+    *map = sector_map;
+    portEXIT_CRITICAL(&output_lock);
     return ESP_OK;
 }
 
@@ -58,51 +501,184 @@ bool parking_sensor_is_safe(void) {
     return current_distance >= DISTANCE_WARNING;
 }
 
+// Built-in echo trace: a 50 cm/s approach from 160 cm pinged every 100 ms, with a ghost
+// echo, missed echoes and a crosstalk reading the filter is meant to ride out
+static const distance_trace_sample_t replay_trace[] = {
+    { 0, 160, ESP_OK },
+    { 100000, 156, ESP_OK },
+    { 200000, 148, ESP_OK },
+    { 300000, 145, ESP_OK },
+    { 400000, 142, ESP_OK },
+    { 500000, 134, ESP_OK },
+    { 600000, 400, ESP_OK },
+    { 700000, 126, ESP_OK },
+    { 800000, 120, ESP_OK },
+    { 900000, 113, ESP_OK },
+    { 1000000, 111, ESP_OK },
+    { 1100000, 0, ESP_ERR_ULTRASONIC_ECHO_TIMEOUT },
+    { 1200000, 102, ESP_OK },
+    { 1300000, 94, ESP_OK },
+    { 1400000, 90, ESP_OK },
+    { 1500000, 12, ESP_OK },
+    { 1600000, 0, ESP_ERR_ULTRASONIC_ECHO_TIMEOUT },
+    { 1700000, 74, ESP_OK },
+    { 1800000, 70, ESP_OK },
+    { 1900000, 67, ESP_OK },
+    { 2000000, 210, ESP_OK },
+    { 2100000, 54, ESP_OK },
+    { 2200000, 51, ESP_OK },
+    { 2300000, 45, ESP_OK },
+    { 2400000, 38, ESP_OK },
+    { 2500000, 35, ESP_OK },
+    { 2600000, 31, ESP_OK },
+    { 2700000, 25, ESP_OK },
+};
+
+// True distance at every sample of replay_trace
+static const uint32_t replay_reference_cm[] = {
+    160, 155, 150, 145, 140, 135, 130, 125, 120, 115, 110, 105, 100, 95,
+    90, 85, 80, 75, 70, 65, 60, 55, 50, 45, 40, 35, 30, 25,
+};
+
+#define REPLAY_TRACE_LEN (sizeof(replay_trace) / sizeof(replay_trace[0]))
+
+_Static_assert(REPLAY_TRACE_LEN == sizeof(replay_reference_cm) / sizeof(replay_reference_cm[0]), "replay out of sync");
+
 void parking_sensor_task(void *pvParameters) {
+    if(PARKING_REPLAY_ON_START) {
+        distance_replay_result_t result;
+        parking_sensor_replay(replay_trace, replay_reference_cm, REPLAY_TRACE_LEN, &result);
+    }
+
     if(parking_sensor_init() != ESP_OK) {
         vTaskDelete(NULL);
         return;
     }
 
-    TickType_t delay_ms = 500;
-
     while(1) {
-        esp_err_t ret = ultrasonic_measure_cm(&sensor, MAX_DISTANCE, &current_distance);
+        int64_t now     = esp_timer_get_time();
+        int64_t wake_us = now + PING_PARKED_INTERVAL_MS * 1000LL;
 
-        if(ret == ESP_OK) {
-            // ESP_LOGI(TAG, "Distance: %u cm", current_distance);
-            ESP_LOGI(TAG, "Distance: %" PRIu32 " cm", current_distance);
-
-            if(current_distance < DISTANCE_DANGER) {
-                delay_ms = 100;
-                ESP_LOGW(TAG, "DANGER ZONE!");
-            } else if(current_distance < DISTANCE_WARNING) {
-                delay_ms = 300;
-                ESP_LOGI(TAG, "Warning zone");
-            } else if(current_distance < DISTANCE_SAFE) {
-                delay_ms = 700;
-                ESP_LOGI(TAG, "Safe zone");
-            } else {
-                delay_ms = 0;
-                ESP_LOGI(TAG, "Out of range");
+        for(int s = 0; s < PARKING_SECTOR_NUM; s++) {
+            int64_t next_us = lane_service(s, now);
+            if(next_us < wake_us) {
+                wake_us = next_us;
             }
+        }
 
-            // Beep if within range
-            if(delay_ms > 0) {
-                buzzer_set_duty(500); // Set moderate intensity (depends on LEDC resolution)
-                vTaskDelay(pdMS_TO_TICKS(50));
-                buzzer_set_duty(0);
-                vTaskDelay(pdMS_TO_TICKS(delay_ms));
-            } else {
-                buzzer_set_duty(0);
-                vTaskDelay(pdMS_TO_TICKS(500));
-            }
+        // Sleep until a ping completes or the next one is due
+        int64_t wait_us = wake_us - esp_timer_get_time();
+        TickType_t wait = wait_us > 0 ? pdMS_TO_TICKS((wait_us + 999) / 1000) : 0;
+        if(wait == 0) {
+            wait = 1;
+        }
+
+        echo_event_t event;
+        if(xQueueReceive(echo_queue, &event, wait) != pdTRUE)
+            continue;
+
+        // A late result of a ping that was already given up is dropped
+        ping_lane_t *lane = &lanes[transducer_config[event.index].sector];
+        if(lane->active != event.index)
+            continue;
+
+        lane->active  = -1;
+        lane->free_us = esp_timer_get_time() + PING_CROSSTALK_GUARD_MS * 1000LL;
 
+        uint32_t measured = event.result.time_us / ULTRASONIC_ROUNDTRIP_CM;
+        transducer_update(event.index, event.result.err, measured, event.result.capture_us);
+        outputs_update();
+
+        const transducer_t *t = &transducers[event.index];
+        if(t->ttc_ms < PARKING_TTC_ALERT_MS) {
+            ESP_LOGW(TAG,
+                    "COLLISION WARNING: transducer %d at %" PRIu32 " cm, closing at %.0f cm/s, %" PRIu32
+                    " ms to impact",
+                    event.index,
+                    t->filter.output_cm,
+                    t->closing_cm_s,
+                    t->ttc_ms);
         } else {
-            ESP_LOGE(TAG, "Distance read failed: %s", esp_err_to_name(ret));
-            current_distance = MAX_DISTANCE;
-            buzzer_set_duty(0);
-            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+            ESP_LOGI(TAG,
+                    "Transducer %d: %" PRIu32 " cm (confidence %u%%)",
+                    event.index,
+                    t->filter.output_cm,
+                    t->filter.confidence);
         }
     }
 }
+
+esp_err_t parking_sensor_replay(const distance_trace_sample_t *trace,
+        const uint32_t *reference_cm,
+        size_t count,
+        distance_replay_result_t *result) {
+    if(trace == NULL || result == NULL || count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    distance_filter_t replay_filter;
+    distance_filter_init(&replay_filter, MAX_DISTANCE);
+
+    uint64_t cycles              = 0;
+    size_t rejected              = 0;
+    uint32_t filtered_changes    = 0;
+    uint32_t raw_changes         = 0;
+    float filtered_sq_error      = 0.0f;
+    float raw_sq_error           = 0.0f;
+    parking_zone_t filtered_zone = PARKING_ZONE_CLEAR;
+    parking_zone_t raw_zone      = PARKING_ZONE_CLEAR;
+
+    for(size_t i = 0; i < count; i++) {
+        const distance_trace_sample_t *sample = &trace[i];
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        bool accepted  = distance_filter_update(&replay_filter, sample->err, sample->distance_cm, sample->capture_us);
+        uint32_t end   = esp_cpu_get_cycle_count();
+
+        cycles += end - start;
+
+        if(!accepted) {
+            rejected++;
+        }
+
+        // Previous behaviour: every reading at face value, any error reads as out of range
+        uint32_t raw      = sample->err == ESP_OK ? sample->distance_cm : MAX_DISTANCE;
+        uint32_t filtered = replay_filter.output_cm;
+
+        if(distance_zone(filtered) != filtered_zone) {
+            filtered_zone = distance_zone(filtered);
+            filtered_changes++;
+        }
+        if(distance_zone(raw) != raw_zone) {
+            raw_zone = distance_zone(raw);
+            raw_changes++;
+        }
+
+        if(reference_cm) {
+            float filtered_error = (float) filtered - (float) reference_cm[i];
+            float raw_error      = (float) raw - (float) reference_cm[i];
+            filtered_sq_error += filtered_error * filtered_error;
+            raw_sq_error += raw_error * raw_error;
+        }
+    }
+
+    result->samples               = count;
+    result->rejected              = rejected;
+    result->filter_cycles         = (uint32_t) (cycles / count);
+    result->filtered_zone_changes = filtered_changes;
+    result->raw_zone_changes      = raw_changes;
+    result->filtered_rms_cm       = reference_cm ? sqrtf(filtered_sq_error / count) : NAN;
+    result->raw_rms_cm            = reference_cm ? sqrtf(raw_sq_error / count) : NAN;
+
+    ESP_LOGI(TAG,
+            "Replay of %u samples: %lu cycles/sample, %u rejected, zone changes %lu filtered vs %lu raw, "
+            "RMS %.1f cm filtered vs %.1f cm raw",
+            (unsigned) count,
+            (unsigned long) result->filter_cycles,
+            (unsigned) rejected,
+            (unsigned long) filtered_changes,
+            (unsigned long) raw_changes,
+            result->filtered_rms_cm,
+            result->raw_rms_cm);
+    return ESP_OK;
+}
\ No newline at end of file
@@ -1,12 +1,14 @@
 /**
  * @file parking_sensor.h
- * @brief Parking sensor logic using HC-SR04 ultrasonic sensor
+ * @brief Parking sensor logic using an array of HC-SR04 ultrasonic sensors
  */
 #ifndef PARKING_SENSOR_H
 #define PARKING_SENSOR_H
 
 #include "esp_err.h"
+#include "sample_stamp.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 /** @brief Distance thresholds in cm */
 #define DISTANCE_DANGER  30
@@ -14,6 +16,61 @@
 #define DISTANCE_SAFE    150
 #define MAX_DISTANCE     400
 
+/** @brief Time to collision */
+#define PARKING_TTC_NONE     UINT32_MAX // Obstacle not approaching
+#define PARKING_TTC_ALERT_MS 1500       // Below this the collision warning overrides the distance zones
+
+/**
+ * @brief Sectors covered by the transducer array
+ */
+typedef enum {
+    PARKING_SECTOR_FRONT,
+    PARKING_SECTOR_REAR,
+    PARKING_SECTOR_NUM
+} parking_sector_t;
+
+/**
+ * @brief Distance zones, ordered by urgency
+ */
+typedef enum {
+    PARKING_ZONE_CLEAR,   // Nothing closer than DISTANCE_SAFE
+    PARKING_ZONE_SAFE,    // DISTANCE_WARNING..DISTANCE_SAFE
+    PARKING_ZONE_WARNING, // DISTANCE_DANGER..DISTANCE_WARNING
+    PARKING_ZONE_DANGER   // Closer than DISTANCE_DANGER, or a collision is imminent
+} parking_zone_t;
+
+/**
+ * @brief Nearest obstacle of every sector
+ */
+typedef struct {
+    uint32_t distance_cm[PARKING_SECTOR_NUM]; // Nearest filtered distance, MAX_DISTANCE when clear
+    uint8_t confidence[PARKING_SECTOR_NUM];   // Confidence of that distance in percent
+    uint32_t ttc_ms[PARKING_SECTOR_NUM];      // Shortest time to collision, PARKING_TTC_NONE when not approaching
+    parking_zone_t zone[PARKING_SECTOR_NUM];  // Zone of the sector, the time to collision included
+} parking_sector_map_t;
+
+/**
+ * @brief One recorded measurement of an echo trace
+ */
+typedef struct {
+    int64_t capture_us;   // Capture time of the measurement
+    uint32_t distance_cm; // Measured distance, ignored on error
+    esp_err_t err;        // Result of the measurement
+} distance_trace_sample_t;
+
+/**
+ * @brief Result of replaying a recorded echo trace through the distance filter
+ */
+typedef struct {
+    size_t samples;                 // Samples replayed
+    size_t rejected;                // Samples rejected as impossible jumps or misses
+    uint32_t filter_cycles;         // Average cycles per sample of the filter
+    uint32_t filtered_zone_changes; // Danger/warning/safe transitions of the filtered distance
+    uint32_t raw_zone_changes;      // Transitions when every measurement is taken at face value
+    float filtered_rms_cm;          // RMS error of the filtered distance, NAN without reference
+    float raw_rms_cm;               // RMS error of the raw measurements, NAN without reference
+} distance_replay_result_t;
+
 /**
  * @brief Initialize the parking sensor hardware
  * 
@@ -29,12 +86,46 @@ esp_err_t parking_sensor_init(void);
 void parking_sensor_task(void *pvParameters);
 
 /**
- * @brief Get the current distance reading in cm
+ * @brief Get the current filtered distance reading in cm, the nearest obstacle of all sectors
  * 
  * @param distance Pointer to store distance value
+ * @param confidence Optional, pointer to store the confidence in percent, 0 when nothing is tracked
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t parking_sensor_get_distance(uint32_t *distance, uint8_t *confidence);
+
+/**
+ * @brief Get the shortest time to collision of all sectors
+ * 
+ * @param ttc_ms Pointer to store the time to collision in ms, PARKING_TTC_NONE when not approaching
+ * @param closing_cm_s Optional, pointer to store the closing speed in cm/s, positive while approaching
  * @return esp_err_t ESP_OK on success
  */
-esp_err_t parking_sensor_get_distance(uint32_t *distance);
+esp_err_t parking_sensor_get_ttc_ms(uint32_t *ttc_ms, float *closing_cm_s);
+
+/**
+ * @brief Check if a collision is imminent at the current closing speed
+ * 
+ * @return bool true if the time to collision is below PARKING_TTC_ALERT_MS
+ */
+bool parking_sensor_is_collision_imminent(void);
+
+/**
+ * @brief Get the current distance reading with the time it was measured
+ * 
+ * @param distance Pointer to store distance value in cm
+ * @param stamp Pointer to store the capture stamp, time_us is 0 before the first echo
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t parking_sensor_get_sample(uint32_t *distance, sample_stamp_t *stamp);
+
+/**
+ * @brief Get the nearest obstacle of every sector
+ *
+ * @param map Pointer to store the distance map
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t parking_sensor_get_sector_map(parking_sector_map_t *map);
 
 /**
  * @brief Check if object is in danger zone
@@ -57,4 +148,21 @@ bool parking_sensor_is_warning(void);
  */
 bool parking_sensor_is_safe(void);
 
+/**
+ * @brief Replay a recorded echo trace through the distance filter
+ *
+ * Runs on a private filter, the live distance is not touched. Reports the per-sample
+ * cost and how often the zone flips compared to taking every measurement at face value.
+ *
+ * @param trace Recorded measurements, oldest first
+ * @param reference_cm Optional ground truth distance per sample, may be NULL
+ * @param count Number of samples
+ * @param result Pointer to store the comparison
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t parking_sensor_replay(const distance_trace_sample_t *trace,
+        const uint32_t *reference_cm,
+        size_t count,
+        distance_replay_result_t *result);
+
 #endif /* PARKING_SENSOR_H */
\ No newline at end of file
@@ -0,0 +1,52 @@
+/**
+ * @file ttc_estimator.c
+ * @brief Closing speed and time-to-collision from the filtered distance stream
+ *
+ * An alpha-beta tracker on the median-filtered distance. The ping interval changes
+ * with the approach, so the update uses the real time between samples rather than
+ * a fixed period.
+ */
+#include "ttc_estimator.h"
+
+void ttc_estimator_reset(ttc_estimator_t *est) {
+    est->distance_cm = 0.0f;
+    est->rate_cm_s   = 0.0f;
+    est->last_us     = 0;
+    est->samples     = 0;
+}
+
+void ttc_estimator_update(ttc_estimator_t *est, uint32_t distance_cm, int64_t capture_us) {
+    float dt = (capture_us - est->last_us) / 1000000.0f;
+
+    if(est->samples == 0 || dt <= 0.0f) {
+        est->distance_cm = distance_cm;
+        est->rate_cm_s   = 0.0f;
+        est->last_us     = capture_us;
+        est->samples     = 1;
+        return;
+    }
+
+    float predicted = est->distance_cm + est->rate_cm_s * dt;
+    float residual  = distance_cm - predicted;
+
+    est->distance_cm = predicted + TTC_ALPHA * residual;
+    est->rate_cm_s += TTC_BETA * residual / dt;
+    est->last_us = capture_us;
+    if(est->samples < UINT8_MAX) {
+        est->samples++;
+    }
+}
+
+float ttc_estimator_closing_cm_s(const ttc_estimator_t *est) {
+    return est->samples < 2 ? 0.0f : -est->rate_cm_s;
+}
+
+uint32_t ttc_estimator_ttc_ms(const ttc_estimator_t *est) {
+    float closing = ttc_estimator_closing_cm_s(est);
+    if(closing < TTC_MIN_CLOSING_CM_S) {
+        return TTC_NONE;
+    }
+
+    float distance = est->distance_cm > 0.0f ? est->distance_cm : 0.0f;
+    return (uint32_t) (distance / closing * 1000.0f);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file ttc_estimator.h
+ * @brief Closing speed and time-to-collision from the filtered distance stream
+ */
+#ifndef TTC_ESTIMATOR_H
+#define TTC_ESTIMATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Reported while the obstacle is not approaching */
+#define TTC_NONE UINT32_MAX
+
+/** @brief Alpha-beta tracker gains */
+#define TTC_ALPHA 0.5f // Distance correction per sample
+#define TTC_BETA  0.2f // Rate correction per sample
+
+/** @brief Slower approaches are treated as standing still, covers echo jitter */
+#define TTC_MIN_CLOSING_CM_S 5.0f
+
+/**
+ * @brief Tracker state
+ */
+typedef struct {
+    float distance_cm; // Smoothed distance
+    float rate_cm_s;   // Distance rate, negative while approaching
+    int64_t last_us;   // Capture time of the last sample
+    uint8_t samples;   // Samples since the last reset, saturates
+} ttc_estimator_t;
+
+/**
+ * @brief Forget the tracked obstacle
+ *
+ * @param est Tracker state
+ */
+void ttc_estimator_reset(ttc_estimator_t *est);
+
+/**
+ * @brief Feed one accepted distance sample
+ *
+ * @param est Tracker state
+ * @param distance_cm Filtered distance
+ * @param capture_us Capture time of the sample in us
+ */
+void ttc_estimator_update(ttc_estimator_t *est, uint32_t distance_cm, int64_t capture_us);
+
+/**
+ * @brief Closing speed, positive while approaching
+ *
+ * @param est Tracker state
+ * @return float Closing speed in cm/s, 0 until two samples were seen
+ */
+float ttc_estimator_closing_cm_s(const ttc_estimator_t *est);
+
+/**
+ * @brief Time until the obstacle is reached at the current closing speed
+ *
+ * @param est Tracker state
+ * @return uint32_t Time to collision in ms, TTC_NONE when not approaching
+ */
+uint32_t ttc_estimator_ttc_ms(const ttc_estimator_t *est);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TTC_ESTIMATOR_H */
@@ -1,39 +1,92 @@
 #include "speed_estimator.h"
+#include "speed_kalman.h"
 #include "acc_data_provider.h" // New accelerometer data provider
+#include "acc_history.h"
+#include "vehicle_state.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_cpu.h"
 #include <math.h>
+#include <string.h>
 
 #define TAG "SPEED_ESTIMATOR"
 
-// Sampling interval (seconds)
-#define SAMPLE_INTERVAL_MS  100
-#define SAMPLE_INTERVAL_SEC (SAMPLE_INTERVAL_MS / 1000.0f)
+// Processing interval (ms)
+#define SAMPLE_INTERVAL_MS 100
+
+// Samples pulled from the history per read
+#define HISTORY_BATCH_SIZE 32
+
+// Largest gap between samples that is still integrated, longer gaps restart integration
+#define MAX_SAMPLE_DT_SEC 0.5f
+
+// Speed damping per second of the legacy estimator, equivalent to its 0.98 per 100 ms step
+#define SPEED_DAMPING_PER_SEC 0.817f
+
+// Standard gravity, converts g to m/s^2
+#define GRAVITY_MS2 9.81f
+
+// Below this speed the direction is not updated from the sign of the velocity
+#define MOVING_SPEED_MPS 0.1f
+
+// Live samples recorded and replayed once through both estimators, 0 disables the replay
+#ifndef SPEED_REPLAY_SAMPLES
+#define SPEED_REPLAY_SAMPLES 0
+#endif
+
+/**
+ * @brief Kalman estimator state, integrates signed longitudinal (Y) acceleration
+ */
+typedef struct {
+    speed_kalman_t kalman;       // Velocity and bias estimate
+    bool initialized;            // Bias seeded from the first sample
+    bool have_last_sample;       // last_sample_us is valid
+    int64_t last_sample_us;      // Capture time of the previous sample
+    uint32_t stationary_time_us; // Time the dynamic acceleration stayed below STATIONARY_THRESHOLD
+} kalman_estimator_t;
+
+/**
+ * @brief Previous estimator, integrates the horizontal magnitude with damping, kept for comparison
+ */
+typedef struct {
+    float speed;                 // Speed magnitude in m/s
+    bool have_last_sample;       // last_sample_us is valid
+    int64_t last_sample_us;      // Capture time of the previous sample
+    uint32_t stationary_time_us; // Time the horizontal magnitude stayed below STATIONARY_THRESHOLD
+} legacy_estimator_t;
 
 // State variables
+static kalman_estimator_t estimator           = { 0 };
 static float current_speed                    = 0.0f;
 static movement_direction_t current_direction = DIRECTION_UNKNOWN;
 
 // For stationary detection
-static const float STATIONARY_THRESHOLD     = 0.05f;
-static int stationary_count                 = 0;
-static const int STATIONARY_COUNT_THRESHOLD = 10;
+static const float STATIONARY_THRESHOLD  = 0.05f;
+static const uint32_t STATIONARY_TIME_MS = 1000;
 
 // For direction detection
 static const float DOMINANT_AXIS_THRESHOLD = 0.1f;
 
 esp_err_t speed_estimator_init(void) {
+    memset(&estimator, 0, sizeof(estimator));
+    current_speed     = 0.0f;
+    current_direction = DIRECTION_UNKNOWN;
+
     ESP_LOGI(TAG, "Speed estimator initialized");
     return ESP_OK;
 }
 
 float speed_estimator_get_speed_mps(void) {
-    return current_speed;
+    return fabsf(current_speed);
 }
 
 float speed_estimator_get_speed_kmh(void) {
-    return current_speed * 3.6f;
+    return fabsf(current_speed) * 3.6f;
+}
+
+float speed_estimator_get_velocity_mps(void) {
+    return current_speed;
 }
 
 movement_direction_t speed_estimator_get_direction(void) {
@@ -63,6 +116,185 @@ const char *speed_estimator_get_direction_string(void) {
     }
 }
 
+/**
+ * @brief Time since the previous sample from the microsecond capture stamps
+ *
+ * @return bool false if the sample cannot be integrated (first sample or a gap)
+ */
+static bool sample_dt(bool *have_last_sample, int64_t *last_sample_us, const sample_stamp_t *stamp, uint32_t *dt_us) {
+    bool had_last     = *have_last_sample;
+    int64_t elapsed   = stamp->time_us - *last_sample_us;
+    *last_sample_us   = stamp->time_us;
+    *have_last_sample = true;
+
+    if(!had_last || elapsed <= 0 || elapsed > (int64_t) (MAX_SAMPLE_DT_SEC * 1000000)) {
+        return false;
+    }
+
+    *dt_us = (uint32_t) elapsed;
+    return true;
+}
+
+/**
+ * @brief Gravity-free acceleration magnitude, used for stationary detection
+ */
+static float dynamic_magnitude(const acc_data_t *acc_data) {
+    float dx = acc_data->raw_acc.x_acc - acc_data->filtered_acc_x;
+    float dy = acc_data->raw_acc.y_acc - acc_data->filtered_acc_y;
+    float dz = acc_data->raw_acc.z_acc - acc_data->filtered_acc_z;
+
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+/**
+ * @brief Run one sample through the Kalman estimator
+ */
+static void kalman_estimator_step(kalman_estimator_t *est, const acc_data_t *acc_data) {
+    float acc = acc_data->raw_acc.y_acc * GRAVITY_MS2;
+    uint32_t dt_us;
+
+    // Assume the unit starts at standstill, the first sample is the initial bias
+    if(!est->initialized) {
+        speed_kalman_init(&est->kalman, acc);
+        est->initialized = true;
+    }
+
+    if(!sample_dt(&est->have_last_sample, &est->last_sample_us, &acc_data->stamp, &dt_us)) {
+        return;
+    }
+
+    speed_kalman_predict(&est->kalman, acc, dt_us / 1000000.0f);
+
+    // Zero velocity update - applied as a measurement while the device is stationary
+    if(dynamic_magnitude(acc_data) < STATIONARY_THRESHOLD) {
+        est->stationary_time_us += dt_us;
+        if(est->stationary_time_us >= STATIONARY_TIME_MS * 1000) {
+            speed_kalman_zero_velocity(&est->kalman);
+        }
+    } else {
+        est->stationary_time_us = 0;
+    }
+}
+
+/**
+ * @brief Run one sample through the legacy estimator
+ */
+static void legacy_estimator_step(legacy_estimator_t *est, const acc_data_t *acc_data) {
+    uint32_t dt_us;
+
+    if(!sample_dt(&est->have_last_sample, &est->last_sample_us, &acc_data->stamp, &dt_us)) {
+        return;
+    }
+
+    float dt            = dt_us / 1000000.0f;
+    float acc_magnitude = acc_data->magnitude_horizontal;
+
+    if(acc_magnitude < STATIONARY_THRESHOLD) {
+        est->stationary_time_us += dt_us;
+        if(est->stationary_time_us >= STATIONARY_TIME_MS * 1000) {
+            est->speed = 0;
+        }
+    } else {
+        est->stationary_time_us = 0;
+        est->speed += acc_magnitude * dt;
+        est->speed *= powf(SPEED_DAMPING_PER_SEC, dt);
+    }
+}
+
+/**
+ * @brief Update the published speed and direction with a single accelerometer sample
+ */
+static void speed_estimator_process_sample(const acc_data_t *acc_data) {
+    kalman_estimator_step(&estimator, acc_data);
+    current_speed = estimator.kalman.speed;
+
+    if(estimator.stationary_time_us >= STATIONARY_TIME_MS * 1000) {
+        current_direction = DIRECTION_UNKNOWN;
+        return;
+    }
+
+    // Turning shows up as lateral acceleration, otherwise follow the sign of the velocity
+    float abs_x = fabsf(acc_data->filtered_acc_x);
+    float abs_y = fabsf(acc_data->filtered_acc_y);
+
+    if(abs_x > DOMINANT_AXIS_THRESHOLD && abs_x > abs_y) {
+        current_direction = (acc_data->filtered_acc_x > 0) ? DIRECTION_LEFT : DIRECTION_RIGHT;
+    } else if(fabsf(current_speed) > MOVING_SPEED_MPS) {
+        current_direction = (current_speed > 0) ? DIRECTION_FORWARD : DIRECTION_BACKWARD;
+    }
+}
+
+esp_err_t speed_estimator_replay(const acc_data_t *trace,
+        const float *reference_mps,
+        size_t count,
+        speed_replay_result_t *result) {
+    if(trace == NULL || result == NULL || count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    kalman_estimator_t kalman_est = { 0 };
+    legacy_estimator_t legacy_est = { 0 };
+    uint64_t kalman_cycles        = 0;
+    uint64_t legacy_cycles        = 0;
+    float kalman_sq_error         = 0.0f;
+    float legacy_sq_error         = 0.0f;
+
+    for(size_t i = 0; i < count; i++) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        kalman_estimator_step(&kalman_est, &trace[i]);
+        uint32_t middle = esp_cpu_get_cycle_count();
+        legacy_estimator_step(&legacy_est, &trace[i]);
+        uint32_t end = esp_cpu_get_cycle_count();
+
+        kalman_cycles += middle - start;
+        legacy_cycles += end - middle;
+
+        // The legacy estimator only knows the magnitude, compare speeds
+        if(reference_mps) {
+            float kalman_error = fabsf(kalman_est.kalman.speed) - fabsf(reference_mps[i]);
+            float legacy_error = legacy_est.speed - fabsf(reference_mps[i]);
+            kalman_sq_error += kalman_error * kalman_error;
+            legacy_sq_error += legacy_error * legacy_error;
+        }
+    }
+
+    result->samples        = count;
+    result->kalman_cycles  = (uint32_t) (kalman_cycles / count);
+    result->legacy_cycles  = (uint32_t) (legacy_cycles / count);
+    result->kalman_rms_mps = reference_mps ? sqrtf(kalman_sq_error / count) : NAN;
+    result->legacy_rms_mps = reference_mps ? sqrtf(legacy_sq_error / count) : NAN;
+
+    ESP_LOGI(TAG,
+            "Replay of %u samples: kalman %lu cycles/sample, RMS %.3f m/s; legacy %lu cycles/sample, RMS %.3f m/s",
+            (unsigned) count,
+            (unsigned long) result->kalman_cycles,
+            result->kalman_rms_mps,
+            (unsigned long) result->legacy_cycles,
+            result->legacy_rms_mps);
+    return ESP_OK;
+}
+
+#if SPEED_REPLAY_SAMPLES > 0
+/**
+ * @brief Record live samples and replay them through both estimators once the trace is full
+ */
+static void speed_estimator_record_replay(const acc_data_t *acc_data) {
+    static acc_data_t trace[SPEED_REPLAY_SAMPLES];
+    static size_t recorded = 0;
+
+    if(recorded >= SPEED_REPLAY_SAMPLES) {
+        return;
+    }
+
+    trace[recorded++] = *acc_data;
+
+    if(recorded == SPEED_REPLAY_SAMPLES) {
+        speed_replay_result_t result;
+        speed_estimator_replay(trace, NULL, recorded, &result);
+    }
+}
+#endif
+
 void speed_estimator_task(void *args) {
     // Wait for a bit to ensure the acc data provider is running
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -70,52 +302,51 @@ void speed_estimator_task(void *args) {
     ESP_LOGI(TAG, "Speed estimator task started");
 
     TickType_t last_wake_time = xTaskGetTickCount();
-    acc_data_t acc_data       = { 0 };
+    acc_history_reader_t reader;
+    static acc_data_t batch[HISTORY_BATCH_SIZE];
 
-    while(1) {
-        // Get latest accelerometer data from the provider
-        if(acc_data_get(&acc_data) == ESP_OK && acc_data.is_valid) {
-            // Use the horizontal plane magnitude for speed estimation
-            float acc_magnitude = acc_data.magnitude_horizontal;
-
-            // Zero velocity update - detect when device is stationary
-            if(acc_magnitude < STATIONARY_THRESHOLD) {
-                stationary_count++;
-                if(stationary_count >= STATIONARY_COUNT_THRESHOLD) {
-                    // Device is likely stationary, reset speed to avoid drift
-                    current_speed     = 0;
-                    current_direction = DIRECTION_UNKNOWN;
-                    ESP_LOGD(TAG, "Zero velocity update applied");
-                }
-            } else {
-                stationary_count = 0;
+    acc_history_reader_init(&reader);
 
-                // Integrate acceleration to get speed: v = v0 + a * t
-                current_speed += acc_magnitude * SAMPLE_INTERVAL_SEC;
+    while(1) {
+        size_t count;
+        uint32_t dropped;
 
-                // Apply damping to prevent drift
-                current_speed *= 0.98f;
+        // Integrate every sample queued since the last run, oldest first
+        do {
+            count = acc_history_read(&reader, batch, HISTORY_BATCH_SIZE, &dropped);
 
-                // Determine direction of movement
-                float abs_x = fabsf(acc_data.filtered_acc_x);
-                float abs_y = fabsf(acc_data.filtered_acc_y);
+            if(dropped) {
+                ESP_LOGW(TAG, "Missed %lu accelerometer samples", (unsigned long) dropped);
+            }
 
-                if(abs_x > DOMINANT_AXIS_THRESHOLD || abs_y > DOMINANT_AXIS_THRESHOLD) {
-                    if(abs_x > abs_y) {
-                        current_direction = (acc_data.filtered_acc_x > 0) ? DIRECTION_LEFT : DIRECTION_RIGHT;
-                    } else {
-                        current_direction = (acc_data.filtered_acc_y > 0) ? DIRECTION_FORWARD : DIRECTION_BACKWARD;
-                    }
+            for(size_t i = 0; i < count; i++) {
+                if(batch[i].is_valid) {
+                    speed_estimator_process_sample(&batch[i]);
+#if SPEED_REPLAY_SAMPLES > 0
+                    speed_estimator_record_replay(&batch[i]);
+#endif
                 }
             }
+        } while(count == HISTORY_BATCH_SIZE);
+
+        vehicle_state_publish_motion(fabsf(current_speed) * 3.6f, current_direction);
+
+        ESP_LOGD(TAG,
+                "Speed: %.2f m/s (%.2f km/h), Direction: %s",
+                current_speed,
+                current_speed * 3.6f,
+                speed_estimator_get_direction_string());
+
+        // Parked: the vehicle is not moving, sleep until the accelerometer reports activity
+        if(!acc_data_provider_is_active()) {
+            speed_kalman_init(&estimator.kalman, estimator.kalman.bias);
+            estimator.have_last_sample = false;
+            current_speed              = 0;
+            current_direction          = DIRECTION_UNKNOWN;
+            vehicle_state_publish_motion(0.0f, DIRECTION_UNKNOWN);
 
-            ESP_LOGD(TAG,
-                    "Speed: %.2f m/s (%.2f km/h), Direction: %s",
-                    current_speed,
-                    current_speed * 3.6f,
-                    speed_estimator_get_direction_string());
-        } else {
-            ESP_LOGW(TAG, "Failed to get valid accelerometer data");
+            acc_data_provider_wait_active(portMAX_DELAY);
+            last_wake_time = xTaskGetTickCount();
         }
 
         // Run at a fixed interval
@@ -2,7 +2,9 @@
 #define SPEED_ESTIMATOR_H
 
 #include "esp_err.h"
+#include "acc_data_provider.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,6 +21,17 @@ typedef enum {
     DIRECTION_RIGHT
 } movement_direction_t;
 
+/**
+ * @brief Result of replaying a recorded trace through both estimators
+ */
+typedef struct {
+    size_t samples;         // Samples replayed
+    uint32_t kalman_cycles; // Average cycles per sample of the Kalman estimator
+    uint32_t legacy_cycles; // Average cycles per sample of the previous estimator
+    float kalman_rms_mps;   // RMS speed error of the Kalman estimator, NAN without reference
+    float legacy_rms_mps;   // RMS speed error of the previous estimator, NAN without reference
+} speed_replay_result_t;
+
 /**
  * @brief Initialize the speed estimator.
  *
@@ -38,6 +51,13 @@ void speed_estimator_task(void *args);
  */
 float speed_estimator_get_speed_mps(void);
 
+/**
+ * @brief Get the latest signed longitudinal velocity in m/s
+ *
+ * @return float velocity estimate, positive forward
+ */
+float speed_estimator_get_velocity_mps(void);
+
 /**
  * @brief Get the latest speed estimate in km/h
  *
@@ -73,6 +93,23 @@ bool speed_estimator_is_moving_backward(void);
  */
 const char *speed_estimator_get_direction_string(void);
 
+/**
+ * @brief Replay a recorded trace through the Kalman and the previous estimator
+ *
+ * Runs on private estimator state, the live estimate is not touched. Reports the
+ * per-sample cost of both and, with a reference, their RMS speed error.
+ *
+ * @param trace Recorded samples, oldest first, e.g. a drained accelerometer history
+ * @param reference_mps Optional ground truth speed per sample (e.g. from GPS), may be NULL
+ * @param count Number of samples
+ * @param result Pointer to store the comparison
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t speed_estimator_replay(const acc_data_t *trace,
+        const float *reference_mps,
+        size_t count,
+        speed_replay_result_t *result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,46 @@
+/**
+ * @file speed_kalman.c
+ * @brief Two-state Kalman filter for longitudinal speed with zero-velocity updates
+ *
+ * State x = [speed, bias], input u = measured acceleration:
+ *   speed' = speed + (u - bias) * dt
+ *   bias'  = bias
+ * The covariance is symmetric, only three of its entries are stored. Everything is
+ * scalar arithmetic on a fixed-size struct, nothing is allocated.
+ */
+#include "speed_kalman.h"
+
+void speed_kalman_init(speed_kalman_t *kf, float bias) {
+    kf->speed = 0.0f;
+    kf->bias  = bias;
+    kf->p00   = SPEED_KALMAN_INITIAL_SPEED_STD * SPEED_KALMAN_INITIAL_SPEED_STD;
+    kf->p01   = 0.0f;
+    kf->p11   = SPEED_KALMAN_INITIAL_BIAS_STD * SPEED_KALMAN_INITIAL_BIAS_STD;
+}
+
+void speed_kalman_predict(speed_kalman_t *kf, float acc, float dt) {
+    kf->speed += (acc - kf->bias) * dt;
+
+    // P = F P F^T + Q with F = [1 -dt; 0 1]
+    float q_speed = SPEED_KALMAN_ACC_NOISE * SPEED_KALMAN_ACC_NOISE * dt * dt;
+    float q_bias  = SPEED_KALMAN_BIAS_DRIFT * SPEED_KALMAN_BIAS_DRIFT * dt;
+
+    kf->p00 += dt * (dt * kf->p11 - 2.0f * kf->p01) + q_speed;
+    kf->p01 -= dt * kf->p11;
+    kf->p11 += q_bias;
+}
+
+void speed_kalman_zero_velocity(speed_kalman_t *kf) {
+    // H = [1 0], z = 0
+    float s          = kf->p00 + SPEED_KALMAN_ZUPT_NOISE * SPEED_KALMAN_ZUPT_NOISE;
+    float gain_speed = kf->p00 / s;
+    float gain_bias  = kf->p01 / s;
+    float innovation = -kf->speed;
+
+    kf->speed += gain_speed * innovation;
+    kf->bias += gain_bias * innovation;
+
+    kf->p11 -= gain_bias * kf->p01;
+    kf->p01 *= 1.0f - gain_speed;
+    kf->p00 *= 1.0f - gain_speed;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file speed_kalman.h
+ * @brief Two-state Kalman filter for longitudinal speed with zero-velocity updates
+ */
+#ifndef SPEED_KALMAN_H
+#define SPEED_KALMAN_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Process noise */
+#define SPEED_KALMAN_ACC_NOISE  0.5f   // Accelerometer noise density in m/s^2
+#define SPEED_KALMAN_BIAS_DRIFT 0.002f // Bias random walk in m/s^2 per sqrt(s)
+
+/** @brief Measurement noise of a zero-velocity update in m/s */
+#define SPEED_KALMAN_ZUPT_NOISE 0.05f
+
+/** @brief Initial uncertainty */
+#define SPEED_KALMAN_INITIAL_SPEED_STD 0.1f // Started at standstill
+#define SPEED_KALMAN_INITIAL_BIAS_STD  1.0f // Unknown mounting tilt, up to ~6 degrees
+
+/**
+ * @brief Filter state, velocity and accelerometer bias with their covariance
+ *
+ * The bias absorbs both the sensor offset and the gravity component of a tilted mounting,
+ * it is only observable during zero-velocity updates.
+ */
+typedef struct {
+    float speed; // Longitudinal velocity in m/s, positive forward
+    float bias;  // Longitudinal acceleration offset in m/s^2
+    float p00;   // Speed variance
+    float p01;   // Speed/bias covariance
+    float p11;   // Bias variance
+} speed_kalman_t;
+
+/**
+ * @brief Reset the filter to standstill
+ *
+ * @param kf Filter state
+ * @param bias Initial bias estimate in m/s^2, e.g. the first longitudinal sample
+ */
+void speed_kalman_init(speed_kalman_t *kf, float bias);
+
+/**
+ * @brief Propagate the state with one acceleration sample
+ *
+ * @param kf Filter state
+ * @param acc Measured longitudinal acceleration in m/s^2
+ * @param dt Time since the previous sample in seconds
+ */
+void speed_kalman_predict(speed_kalman_t *kf, float acc, float dt);
+
+/**
+ * @brief Apply a zero-velocity measurement, corrects the speed and learns the bias
+ *
+ * @param kf Filter state
+ */
+void speed_kalman_zero_velocity(speed_kalman_t *kf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPEED_KALMAN_H */
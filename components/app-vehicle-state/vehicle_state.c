@@ -0,0 +1,140 @@
+/**
+ * @file vehicle_state.c
+ * @brief Versioned blackboard of the vehicle state published by the detectors
+ *
+ * Publishers and readers only hold the lock while copying a few words, so the
+ * blackboard can be shared by tasks on both cores without blocking any of them.
+ * Next to the global version every field remembers the version in which it last
+ * changed, that is all it takes to compute the changed mask for any reader.
+ */
+#include "vehicle_state.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Version 1 is the initial state, a reader starting from 0 sees every field as changed
+static vehicle_state_t state                       = { .version = 1, .ttc_ms = UINT32_MAX };
+static uint32_t field_version[VEHICLE_FIELD_COUNT] = { [0 ... VEHICLE_FIELD_COUNT - 1] = 1 };
+
+/**
+ * @brief Bump the version for the changed fields, call with the lock held
+ */
+static void mark_changed(uint32_t fields) {
+    if(!fields)
+        return;
+
+    state.version++;
+    for(int i = 0; i < VEHICLE_FIELD_COUNT; i++) {
+        if(fields & (1u << i)) {
+            field_version[i] = state.version;
+        }
+    }
+}
+
+void vehicle_state_publish_motion(float speed_kmh, int direction) {
+    portENTER_CRITICAL(&state_lock);
+    uint32_t changed = 0;
+    if(state.speed_kmh != speed_kmh) {
+        state.speed_kmh = speed_kmh;
+        changed |= VEHICLE_FIELD_SPEED;
+    }
+    if(state.direction != direction) {
+        state.direction = direction;
+        changed |= VEHICLE_FIELD_DIRECTION;
+    }
+    mark_changed(changed);
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void vehicle_state_publish_distance(uint32_t distance_cm) {
+    portENTER_CRITICAL(&state_lock);
+    if(state.distance_cm != distance_cm) {
+        state.distance_cm = distance_cm;
+        mark_changed(VEHICLE_FIELD_DISTANCE);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void vehicle_state_publish_ttc(uint32_t ttc_ms, float closing_cm_s) {
+    portENTER_CRITICAL(&state_lock);
+    if(state.ttc_ms != ttc_ms || state.closing_cm_s != closing_cm_s) {
+        state.ttc_ms       = ttc_ms;
+        state.closing_cm_s = closing_cm_s;
+        mark_changed(VEHICLE_FIELD_TTC);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void vehicle_state_publish_sectors(const uint32_t *distance_cm, const int *zone) {
+    portENTER_CRITICAL(&state_lock);
+    if(memcmp(state.sector_distance_cm, distance_cm, sizeof(state.sector_distance_cm)) != 0
+            || memcmp(state.sector_zone, zone, sizeof(state.sector_zone)) != 0) {
+        memcpy(state.sector_distance_cm, distance_cm, sizeof(state.sector_distance_cm));
+        memcpy(state.sector_zone, zone, sizeof(state.sector_zone));
+        mark_changed(VEHICLE_FIELD_SECTORS);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void vehicle_state_publish_light(float lux, int light_state) {
+    portENTER_CRITICAL(&state_lock);
+    uint32_t changed = 0;
+    if(state.lux != lux) {
+        state.lux = lux;
+        changed |= VEHICLE_FIELD_LUX;
+    }
+    if(state.light_state != light_state) {
+        state.light_state = light_state;
+        changed |= VEHICLE_FIELD_LIGHT_STATE;
+    }
+    mark_changed(changed);
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void vehicle_state_publish_door(int door, int door_state) {
+    if(door < 0 || door >= VEHICLE_DOORS)
+        return;
+
+    portENTER_CRITICAL(&state_lock);
+    if(state.door_state[door] != door_state) {
+        state.door_state[door] = door_state;
+        mark_changed(VEHICLE_FIELD_DOOR);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void vehicle_state_publish_crash(bool active) {
+    portENTER_CRITICAL(&state_lock);
+    if(state.crash_active != active) {
+        state.crash_active = active;
+        mark_changed(VEHICLE_FIELD_CRASH);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+void vehicle_state_publish_climate(float temperature, float humidity) {
+    portENTER_CRITICAL(&state_lock);
+    if(state.temperature != temperature || state.humidity != humidity) {
+        state.temperature = temperature;
+        state.humidity    = humidity;
+        mark_changed(VEHICLE_FIELD_CLIMATE);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+uint32_t vehicle_state_read(vehicle_state_t *snapshot, uint32_t since_version) {
+    uint32_t changed = 0;
+
+    portENTER_CRITICAL(&state_lock);
+    memcpy(snapshot, &state, sizeof(state));
+    for(int i = 0; i < VEHICLE_FIELD_COUNT; i++) {
+        // Signed difference keeps the comparison valid across a version wrap
+        if((int32_t) (field_version[i] - since_version) > 0) {
+            changed |= 1u << i;
+        }
+    }
+    portEXIT_CRITICAL(&state_lock);
+
+    return changed;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file vehicle_state.h
+ * @brief Versioned blackboard of the vehicle state published by the detectors
+ *
+ * Every detector publishes its latest result here, consumers read all of it as one
+ * coherent snapshot. Each publish that changes a value bumps the global version,
+ * a consumer passes the version of its previous snapshot to learn which fields changed.
+ */
+#ifndef VEHICLE_STATE_H
+#define VEHICLE_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Field masks reported by vehicle_state_read() */
+#define VEHICLE_FIELD_SPEED       (1u << 0)
+#define VEHICLE_FIELD_DIRECTION   (1u << 1)
+#define VEHICLE_FIELD_DISTANCE    (1u << 2)
+#define VEHICLE_FIELD_LUX         (1u << 3)
+#define VEHICLE_FIELD_LIGHT_STATE (1u << 4)
+#define VEHICLE_FIELD_DOOR        (1u << 5)
+#define VEHICLE_FIELD_CRASH       (1u << 6)
+#define VEHICLE_FIELD_CLIMATE     (1u << 7)
+#define VEHICLE_FIELD_TTC         (1u << 8)
+#define VEHICLE_FIELD_SECTORS     (1u << 9)
+#define VEHICLE_FIELD_COUNT       10
+#define VEHICLE_FIELD_ALL         ((1u << VEHICLE_FIELD_COUNT) - 1)
+
+/** @brief Parking sectors, indexed by parking_sector_t */
+#define VEHICLE_PARKING_SECTORS 2
+
+/** @brief Monitored doors, indexed by door_id_t */
+#define VEHICLE_DOORS 5
+
+/**
+ * @brief Snapshot of the vehicle state
+ *
+ * The enumerations are stored as plain integers so that the detectors do not
+ * depend on each other's headers.
+ */
+typedef struct {
+    uint32_t version; // Version of this snapshot, pass it to the next vehicle_state_read()
+
+    float speed_kmh;      // Estimated speed
+    int direction;        // movement_direction_t from the speed estimator
+    uint32_t distance_cm; // Parking sensor distance, nearest obstacle of all sectors
+    uint32_t ttc_ms;      // Time to collision with the parking obstacle, UINT32_MAX when not approaching
+    float closing_cm_s;   // Closing speed of the parking obstacle, positive while approaching
+    float lux;            // Ambient light level
+    int light_state;      // light_state_t from the day/night detector
+    bool crash_active;    // A crash is latched and not yet reset
+    float temperature;    // Cabin temperature in degrees C
+    float humidity;       // Cabin relative humidity in %
+
+    // Parking distance map, indexed by parking_sector_t
+    uint32_t sector_distance_cm[VEHICLE_PARKING_SECTORS]; // Nearest obstacle per parking sector
+    int sector_zone[VEHICLE_PARKING_SECTORS];             // parking_zone_t per parking sector
+
+    // Doors, indexed by door_id_t
+    int door_state[VEHICLE_DOORS]; // door_state_t from the door detector
+} vehicle_state_t;
+
+/**
+ * @brief Publish the speed estimate, speed and direction always change together
+ *
+ * @param speed_kmh Speed in km/h
+ * @param direction movement_direction_t
+ */
+void vehicle_state_publish_motion(float speed_kmh, int direction);
+
+/**
+ * @brief Publish the parking sensor distance
+ *
+ * @param distance_cm Distance in cm
+ */
+void vehicle_state_publish_distance(uint32_t distance_cm);
+
+/**
+ * @brief Publish the time to collision with the parking obstacle
+ *
+ * @param ttc_ms Time to collision in ms, UINT32_MAX when not approaching
+ * @param closing_cm_s Closing speed in cm/s
+ */
+void vehicle_state_publish_ttc(uint32_t ttc_ms, float closing_cm_s);
+
+/**
+ * @brief Publish the per-sector distance map of the parking sensor
+ *
+ * @param distance_cm Nearest obstacle per sector, VEHICLE_PARKING_SECTORS entries
+ * @param zone parking_zone_t per sector, VEHICLE_PARKING_SECTORS entries
+ */
+void vehicle_state_publish_sectors(const uint32_t *distance_cm, const int *zone);
+
+/**
+ * @brief Publish the ambient light level and the derived day/night state
+ *
+ * @param lux Light level in lux
+ * @param light_state light_state_t
+ */
+void vehicle_state_publish_light(float lux, int light_state);
+
+/**
+ * @brief Publish the state of one door
+ *
+ * @param door door_id_t
+ * @param door_state door_state_t
+ */
+void vehicle_state_publish_door(int door, int door_state);
+
+/**
+ * @brief Publish whether a crash is latched
+ *
+ * @param active true while the crash is latched
+ */
+void vehicle_state_publish_crash(bool active);
+
+/**
+ * @brief Publish the cabin climate
+ *
+ * @param temperature Temperature in degrees C
+ * @param humidity Relative humidity in %
+ */
+void vehicle_state_publish_climate(float temperature, float humidity);
+
+/**
+ * @brief Read a coherent snapshot of the whole vehicle state
+ *
+ * @param snapshot Pointer to store the snapshot
+ * @param since_version Version of the caller's previous snapshot, 0 on the first call
+ * @return uint32_t Mask of VEHICLE_FIELD_* changed after since_version, every field on the first call
+ */
+uint32_t vehicle_state_read(vehicle_state_t *snapshot, uint32_t since_version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VEHICLE_STATE_H */
@@ -7,8 +7,12 @@
 
 //--------------------------------- INCLUDES ----------------------------------
 #include <stdio.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "driver/ledc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "buzzer.h"
 
 //---------------------------------- MACROS -----------------------------------
@@ -19,18 +23,39 @@
 #define PWM_FREQ_HZ    1000
 #define PWM_RESOLUTION LEDC_TIMER_13_BIT
 #define PWM_TIMER      LEDC_TIMER_0
+#define NO_PATTERN     (-1)
 
 //-------------------------------- DATA TYPES ---------------------------------
+typedef struct {
+    buzzer_pattern_t pattern;
+    uint16_t remaining; // Beeps left, unused for BUZZER_REPEAT_FOREVER
+    bool active;
+} pattern_slot_t;
 
 //---------------------- PRIVATE FUNCTION PROTOTYPES --------------------------
+static void pattern_timer_cb(void *arg);
+static void pattern_start(int priority);
+static void pattern_resume_highest(void);
+static void pattern_arm(uint16_t ms);
+static bool pattern_equal(const buzzer_pattern_t *a, const buzzer_pattern_t *b);
 
 //------------------------- STATIC DATA & CONSTANTS ---------------------------
+static pattern_slot_t slots[BUZZER_PRIORITY_NUM];
+static int playing                     = NO_PATTERN;
+static bool tone_on                    = false;
+static int64_t phase_end_us            = 0;
+static esp_timer_handle_t phase_timer  = NULL;
+static SemaphoreHandle_t pattern_mutex = NULL;
 
 //------------------------------- GLOBAL DATA ---------------------------------
 
 //------------------------------ PUBLIC FUNCTIONS -----------------------------
 
 esp_err_t buzzer_init(void) {
+    // Shared by the parking sensor and the crash detector, the first caller sets it up
+    if(pattern_mutex)
+        return ESP_OK;
+
     ledc_timer_config_t timer_cfg = { .speed_mode = PWM_MODE,
         .timer_num                                = PWM_TIMER,
         .duty_resolution                          = PWM_RESOLUTION,
@@ -47,7 +72,17 @@ esp_err_t buzzer_init(void) {
         .hpoint                                    = 0,
         .timer_sel                                 = PWM_TIMER };
 
-    return ledc_channel_config(&channel_cfg);
+    esp_err_t err = ledc_channel_config(&channel_cfg);
+    if(err != ESP_OK)
+        return err;
+
+    const esp_timer_create_args_t timer_args = { .callback = pattern_timer_cb, .name = "buzzer" };
+    err = esp_timer_create(&timer_args, &phase_timer);
+    if(err != ESP_OK)
+        return err;
+
+    pattern_mutex = xSemaphoreCreateMutex();
+    return pattern_mutex ? ESP_OK : ESP_ERR_NO_MEM;
 }
 
 esp_err_t buzzer_set_duty(uint32_t duty) {
@@ -57,6 +92,122 @@ esp_err_t buzzer_set_duty(uint32_t duty) {
     return ledc_update_duty(PWM_MODE, PWM_CHANNEL);
 }
 
+esp_err_t buzzer_play(const buzzer_pattern_t *pattern) {
+    if(!pattern || pattern->priority >= BUZZER_PRIORITY_NUM || pattern->on_ms == 0)
+        return ESP_ERR_INVALID_ARG;
+    if(!pattern_mutex)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(pattern_mutex, portMAX_DELAY);
+
+    pattern_slot_t *slot = &slots[pattern->priority];
+    if(!(slot->active && pattern_equal(&slot->pattern, pattern))) {
+        slot->pattern   = *pattern;
+        slot->remaining = pattern->repeat;
+        slot->active    = true;
+
+        // A lower priority pattern waits in its slot until this one ends
+        if(playing == NO_PATTERN || (int) pattern->priority >= playing)
+            pattern_start(pattern->priority);
+    }
+
+    xSemaphoreGive(pattern_mutex);
+    return ESP_OK;
+}
+
+esp_err_t buzzer_stop(buzzer_priority_t priority) {
+    if(priority >= BUZZER_PRIORITY_NUM)
+        return ESP_ERR_INVALID_ARG;
+    if(!pattern_mutex)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(pattern_mutex, portMAX_DELAY);
+
+    slots[priority].active = false;
+    if(playing == (int) priority)
+        pattern_resume_highest();
+
+    xSemaphoreGive(pattern_mutex);
+    return ESP_OK;
+}
+
 //---------------------------- PRIVATE FUNCTIONS ------------------------------
 
+static bool pattern_equal(const buzzer_pattern_t *a, const buzzer_pattern_t *b) {
+    return a->on_ms == b->on_ms && a->off_ms == b->off_ms && a->repeat == b->repeat && a->duty == b->duty;
+}
+
+/**
+ * @brief Schedule the end of the current tone or silence, call with the mutex held
+ */
+static void pattern_arm(uint16_t ms) {
+    esp_timer_stop(phase_timer);
+    phase_end_us = esp_timer_get_time() + ms * 1000;
+    esp_timer_start_once(phase_timer, ms * 1000);
+}
+
+/**
+ * @brief Play a slot from its first beep, call with the mutex held
+ */
+static void pattern_start(int priority) {
+    const buzzer_pattern_t *pattern = &slots[priority].pattern;
+
+    playing = priority;
+    tone_on = true;
+    buzzer_set_duty(pattern->duty);
+    pattern_arm(pattern->on_ms);
+}
+
+/**
+ * @brief Hand the buzzer to the highest remaining pattern or silence it, call with the mutex held
+ */
+static void pattern_resume_highest(void) {
+    for(int priority = BUZZER_PRIORITY_NUM - 1; priority >= 0; priority--) {
+        if(slots[priority].active) {
+            pattern_start(priority);
+            return;
+        }
+    }
+
+    esp_timer_stop(phase_timer);
+    playing = NO_PATTERN;
+    tone_on = false;
+    buzzer_set_duty(0);
+}
+
+/**
+ * @brief End of a tone or silence, runs in the esp_timer task
+ */
+static void pattern_timer_cb(void *arg) {
+    xSemaphoreTake(pattern_mutex, portMAX_DELAY);
+
+    // A play or stop restarted the timer while this expiry was waiting for the mutex
+    if(playing == NO_PATTERN || esp_timer_get_time() < phase_end_us) {
+        xSemaphoreGive(pattern_mutex);
+        return;
+    }
+
+    pattern_slot_t *slot = &slots[playing];
+
+    if(tone_on) {
+        if(slot->pattern.repeat != BUZZER_REPEAT_FOREVER && --slot->remaining == 0) {
+            slot->active = false;
+            pattern_resume_highest();
+        } else if(slot->pattern.off_ms == 0) {
+            // Continuous tone, keep the output running
+            pattern_arm(slot->pattern.on_ms);
+        } else {
+            tone_on = false;
+            buzzer_set_duty(0);
+            pattern_arm(slot->pattern.off_ms);
+        }
+    } else {
+        tone_on = true;
+        buzzer_set_duty(slot->pattern.duty);
+        pattern_arm(slot->pattern.on_ms);
+    }
+
+    xSemaphoreGive(pattern_mutex);
+}
+
 //---------------------------- INTERRUPT HANDLERS -----------------------------
\ No newline at end of file
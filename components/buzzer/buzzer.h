@@ -14,11 +14,34 @@ extern "C" {
 
 //--------------------------------- INCLUDES ----------------------------------
 #include "esp_err.h"
+#include <stdint.h>
 
 //---------------------------------- MACROS -----------------------------------
+#define BUZZER_REPEAT_FOREVER 0
 
 //-------------------------------- DATA TYPES ---------------------------------
 
+/**
+ * @brief Pattern priority, the highest active pattern plays and lower ones resume after it
+ */
+typedef enum {
+    BUZZER_PRIORITY_INFO,    // Short user interface feedback
+    BUZZER_PRIORITY_PARKING, // Parking sensor proximity beeps
+    BUZZER_PRIORITY_ALARM,   // Crash alarm
+    BUZZER_PRIORITY_NUM
+} buzzer_priority_t;
+
+/**
+ * @brief Declarative beep pattern
+ */
+typedef struct {
+    uint16_t on_ms;             // Tone length of one beep
+    uint16_t off_ms;            // Silence after each beep, 0 for a continuous tone
+    uint16_t repeat;            // Number of beeps, BUZZER_REPEAT_FOREVER until stopped
+    uint32_t duty;              // Duty cycle (0 to 2^PWM_RESOLUTION)
+    buzzer_priority_t priority; // Slot of the pattern
+} buzzer_pattern_t;
+
 //---------------------- PUBLIC FUNCTION PROTOTYPES --------------------------
 
 /**
@@ -33,11 +56,32 @@ esp_err_t buzzer_init(void);
 /**
  * @brief Set buzzer duty cycle (volume/tone intensity).
  *
+ * Bypasses the pattern engine, a playing pattern overwrites it on its next edge.
+ *
  * @param duty Duty cycle (0 to 2^PWM_RESOLUTION).
  * @return ESP_OK on success, or appropriate error code.
  */
 esp_err_t buzzer_set_duty(uint32_t duty);
 
+/**
+ * @brief Play a pattern, returns immediately.
+ *
+ * Replaces the pattern of the same priority. Posting the pattern that is already
+ * playing keeps its rhythm, so callers can post on every update.
+ *
+ * @param pattern Pattern to play, copied.
+ * @return ESP_OK on success, or appropriate error code.
+ */
+esp_err_t buzzer_play(const buzzer_pattern_t *pattern);
+
+/**
+ * @brief Stop the pattern of a priority, a lower priority pattern resumes.
+ *
+ * @param priority Slot to stop.
+ * @return ESP_OK on success, or appropriate error code.
+ */
+esp_err_t buzzer_stop(buzzer_priority_t priority);
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,6 +2,7 @@
 
 //Hardware Specific Components
 #include "driver/i2c.h"
+#include "i2c_scheduler.h"
 
 //I2C User Defines
 #define I2C_MASTER_SCL_IO GPIO_NUM_21 /*!< GPIO number used for I2C master clock */
@@ -50,7 +51,12 @@ at24cx_err_t at24cx_i2c_hal_read(uint8_t address, uint8_t *reg, uint16_t reg_cou
     i2c_master_read(cmd, data, 1, I2C_MASTER_LAST_NACK);
     i2c_master_stop(cmd);
 
-    ESP_ERROR_CHECK(i2c_master_cmd_begin(I2C_NUM_0, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS));
+    if(i2c_scheduler_acquire(address) != ESP_OK) {
+        err = AT24CX_ERR;
+    } else {
+        ESP_ERROR_CHECK(i2c_master_cmd_begin(I2C_NUM_0, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS));
+        i2c_scheduler_release(address);
+    }
 
     i2c_cmd_link_delete(cmd);
 
@@ -68,8 +74,13 @@ at24cx_err_t at24cx_i2c_hal_write(uint8_t address, uint8_t *data, uint16_t count
     i2c_master_write(cmd, data + 1, 1, 1);
     i2c_master_write(cmd, data + 2, 1, 1);
     i2c_master_stop(cmd);
-    if(i2c_master_cmd_begin(I2C_NUM_0, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS) == ESP_FAIL) {
+    if(i2c_scheduler_acquire(address) != ESP_OK) {
         err = AT24CX_ERR;
+    } else {
+        if(i2c_master_cmd_begin(I2C_NUM_0, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS) == ESP_FAIL) {
+            err = AT24CX_ERR;
+        }
+        i2c_scheduler_release(address);
     }
     i2c_cmd_link_delete(cmd);
 
@@ -87,7 +98,12 @@ at24cx_err_t at24cx_i2c_hal_test(uint8_t address) {
     i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, 1);
     i2c_master_write_byte(cmd, test_data, 1);
     i2c_master_stop(cmd);
-    err = i2c_master_cmd_begin(I2C_NUM_0, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+    if(i2c_scheduler_acquire(address) != ESP_OK) {
+        err = AT24CX_ERR;
+    } else {
+        err = i2c_master_cmd_begin(I2C_NUM_0, cmd, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
+        i2c_scheduler_release(address);
+    }
     i2c_cmd_link_delete(cmd);
 
     return err;
@@ -24,12 +24,18 @@
 /* Littlevgl specific */
 #include "lvgl.h"
 #include "lvgl_helpers.h"
+#include "disp_spi.h"
+
+#include "spi_arbiter.h"
 
 #include "squareline/project/ui.h"
 
 //---------------------------------- MACROS -----------------------------------
 #define LV_TICK_PERIOD_MS (1U)
 
+/* Rows sent per bus grant, bounds how long a sensor transaction can wait behind the display */
+#define GUI_FLUSH_CHUNK_ROWS (8)
+
 //-------------------------------- DATA TYPES ---------------------------------
 
 //---------------------- PRIVATE FUNCTION PROTOTYPES --------------------------
@@ -45,6 +51,28 @@ static void _gui_application_init(void);
  */
 static void _lv_tick_timer(void *p_arg);
 
+/**
+ * @brief Flush callback that sends the area to the display in bounded chunks.
+ *
+ * The VSPI bus is shared with the accelerometer. Each chunk is sent under the SPI arbiter
+ * so pending sensor transactions get the bus between chunks instead of after the whole area.
+ *
+ * @param [in] p_drv Display driver.
+ * @param [in] p_area Area to flush.
+ * @param [in] p_color_map Pixels of the area, row by row.
+ */
+static void _gui_flush_cb(lv_disp_drv_t *p_drv, const lv_area_t *p_area, lv_color_t *p_color_map);
+
+/**
+ * @brief Touch read callback that polls the XPT2046 under the SPI arbiter.
+ *
+ * The touch controller sits on the same VSPI bus as the display and the accelerometer.
+ *
+ * @param [in] p_drv Input device driver.
+ * @param [out] p_data Touch point and state.
+ */
+static void _gui_touch_read_cb(lv_indev_drv_t *p_drv, lv_indev_data_t *p_data);
+
 /**
  * @brief Starts GUI task.
  *
@@ -352,6 +380,36 @@ static void _gui_application_init(void) {
     ui_init();
 }
 
+static void _gui_flush_cb(lv_disp_drv_t *p_drv, const lv_area_t *p_area, lv_color_t *p_color_map) {
+    const lv_coord_t width  = lv_area_get_width(p_area);
+    const int flushing_last = p_drv->draw_buf->flushing_last;
+    lv_area_t chunk         = *p_area;
+
+    while(chunk.y1 <= p_area->y2) {
+        chunk.y2 = LV_MIN(chunk.y1 + GUI_FLUSH_CHUNK_ROWS - 1, p_area->y2);
+
+        /* The display driver signals flush ready after every chunk, restore the flags for the next one */
+        p_drv->draw_buf->flushing      = 1;
+        p_drv->draw_buf->flushing_last = flushing_last;
+
+        spi_arbiter_acquire(SPI_ARBITER_CLIENT_DISPLAY);
+        disp_driver_flush(p_drv, &chunk, p_color_map);
+        /* disp_spi already owns the post callback of the display device (it reports flush ready to LVGL),
+           the queued descriptors have to be collected here anyway, and that sleeps on the driver's result queue */
+        disp_wait_for_pending_transactions();
+        spi_arbiter_release(SPI_ARBITER_CLIENT_DISPLAY);
+
+        p_color_map += (uint32_t) width * (chunk.y2 - chunk.y1 + 1);
+        chunk.y1 = chunk.y2 + 1;
+    }
+}
+
+static void _gui_touch_read_cb(lv_indev_drv_t *p_drv, lv_indev_data_t *p_data) {
+    spi_arbiter_acquire(SPI_ARBITER_CLIENT_TOUCH);
+    touch_driver_read(p_drv, p_data);
+    spi_arbiter_release(SPI_ARBITER_CLIENT_TOUCH);
+}
+
 static void _lv_tick_timer(void *p_arg) {
     (void) p_arg;
 
@@ -384,7 +442,7 @@ static void _gui_task(void *p_parameter) {
     disp_drv.hor_res = LV_HOR_RES_MAX;
     disp_drv.ver_res = LV_VER_RES_MAX;
     lv_disp_drv_init(&disp_drv);
-    disp_drv.flush_cb = disp_driver_flush;
+    disp_drv.flush_cb = _gui_flush_cb;
 
     disp_drv.draw_buf = &disp_draw_buf;
     lv_disp_drv_register(&disp_drv);
@@ -392,7 +450,7 @@ static void _gui_task(void *p_parameter) {
     /* Register an input device */
     static lv_indev_drv_t indev_drv;
     lv_indev_drv_init(&indev_drv);
-    indev_drv.read_cb = touch_driver_read;
+    indev_drv.read_cb = _gui_touch_read_cb;
     indev_drv.type    = LV_INDEV_TYPE_POINTER;
     lv_indev_drv_register(&indev_drv);
 
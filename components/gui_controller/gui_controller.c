@@ -15,6 +15,7 @@
 #include "door_detector.h"
 #include "parking_sensor.h"
 #include "speed_estimator.h"
+#include "vehicle_state.h"
 
 // For temperature sensing
 #include "sht3x.h"
@@ -35,29 +36,131 @@
 static TaskHandle_t gui_controller_task_handle = NULL;
 static EventGroupHandle_t gui_event_group      = NULL;
 
-// Bit definitions for event group
-#define GUI_EVT_SPEED_UPDATE     BIT0
-#define GUI_EVT_PROXIMITY_UPDATE BIT1
-#define GUI_EVT_DOOR_UPDATE      BIT2
-#define GUI_EVT_TIME_UPDATE      BIT3
-#define GUI_EVT_TEMP_UPDATE      BIT4
-#define GUI_EVT_LIGHT_UPDATE     BIT5
-#define GUI_EVT_CRASH_UPDATE     BIT6
-#define GUI_EVT_FUEL_UPDATE      BIT7
-
-// Current state storage
-static float current_speed                          = 0;
-static gui_proximity_t current_proximity            = GUI_PROX_NUM; // Default to invalid value, will be set correctly
-static sht3x_sensors_values_t current_temp_humidity = { 0 };
-static light_state_t current_light_state            = LIGHT_STATE_UNKNOWN;
-static door_state_t door_states[gui_num_of_doors]   = { 0 }; // Match enum in gui.h
-static bool crash_detected                          = false;
-static int fuel_percentage                          = 100; // Mock value
+// Bit definitions for event group, sensor data comes from the vehicle state instead
+#define GUI_EVT_TIME_UPDATE BIT0
+#define GUI_EVT_FUEL_UPDATE BIT1
+
+// Sensor fields that require a redraw of each part of the GUI
+#define GUI_PROXIMITY_FIELDS VEHICLE_FIELD_SECTORS
+#define GUI_WEATHER_FIELDS   (VEHICLE_FIELD_CLIMATE | VEHICLE_FIELD_LIGHT_STATE)
+
+// Current state storage, only touched by the GUI controller task
+static gui_proximity_t current_proximity = GUI_PROX_NUM; // Default to invalid value, will be set correctly
+static int fuel_percentage               = 100;          // Mock value
+
+_Static_assert((int) gui_num_of_doors == (int) DOOR_COUNT, "gui doors out of sync with door_id_t");
 
 // Forward declarations for callbacks
 static void crash_event_callback(crash_event_t *event);
-static void door_state_callback(door_state_t state);
-static void light_state_callback(light_state_t state);
+
+/**
+   * @brief Pick the most urgent parking sector of a snapshot
+   *
+   * The zones already include the collision warning, a tie goes to the nearer obstacle.
+   */
+static parking_sector_t urgent_sector(const vehicle_state_t *state) {
+    parking_sector_t urgent = PARKING_SECTOR_FRONT;
+
+    for(int s = 1; s < PARKING_SECTOR_NUM; s++) {
+        if(state->sector_zone[s] > state->sector_zone[urgent]
+                || (state->sector_zone[s] == state->sector_zone[urgent]
+                        && state->sector_distance_cm[s] < state->sector_distance_cm[urgent])) {
+            urgent = (parking_sector_t) s;
+        }
+    }
+    return urgent;
+}
+
+/**
+   * @brief Map the parking distance map of a snapshot to a proximity value
+   */
+static gui_proximity_t proximity_from_state(const vehicle_state_t *state) {
+    parking_sector_t sector = urgent_sector(state);
+    parking_zone_t zone     = (parking_zone_t) state->sector_zone[sector];
+
+    if(zone == PARKING_ZONE_CLEAR)
+        return GUI_PROX_NOTHING_NEAR;
+
+    // Close, mid and far follow each other in both gui_proximity_t and parking_zone_t
+    gui_proximity_t closest = sector == PARKING_SECTOR_FRONT ? GUI_PROX_FRONT_CLOSE : GUI_PROX_BACK_CLOSE;
+    return (gui_proximity_t) (closest + (PARKING_ZONE_DANGER - zone));
+}
+
+/**
+   * @brief Redraw the parts of the GUI whose sensor data changed
+   * 
+   * @param state Coherent snapshot of the vehicle state
+   * @param changed Mask of VEHICLE_FIELD_* changed since the previous snapshot
+   */
+static void gui_controller_apply_state(const vehicle_state_t *state, uint32_t changed) {
+    char temp_str[16] = { 0 };
+    char hum_str[16]  = { 0 };
+
+    // Handle speed updates
+    if(changed & VEHICLE_FIELD_SPEED) {
+        gui_speed_bar_set(state->speed_kmh);
+        ESP_LOGI(TAG, "Updated speed: %.2f", state->speed_kmh);
+    }
+
+    // Handle proximity updates, the sector map says where the obstacle is
+    if(changed & GUI_PROXIMITY_FIELDS) {
+        gui_proximity_t proximity = proximity_from_state(state);
+
+        // Ensure the proximity value is valid and actually changed before updating
+        if(proximity != current_proximity && proximity >= 0 && proximity < GUI_PROX_NUM) {
+            current_proximity = proximity;
+            ESP_LOGI(TAG,
+                    "Updating proximity: %d (front: %lu cm, rear: %lu cm, TTC: %ld ms)",
+                    current_proximity,
+                    state->sector_distance_cm[PARKING_SECTOR_FRONT],
+                    state->sector_distance_cm[PARKING_SECTOR_REAR],
+                    state->ttc_ms == PARKING_TTC_NONE ? -1L : (long) state->ttc_ms);
+            gui_set_parking_panel();
+            gui_proximity_set(current_proximity);
+        }
+    }
+
+    // Handle door updates, door_id_t and gui_doors_t share the same order
+    if(changed & VEHICLE_FIELD_DOOR) {
+        gui_set_doors_panel();
+        for(int i = 0; i < gui_num_of_doors; i++) {
+            if(state->door_state[i] == DOOR_STATE_OPEN) {
+                gui_set_door_open((gui_doors_t) i);
+            } else if(state->door_state[i] == DOOR_STATE_CLOSED) {
+                gui_set_door_closed((gui_doors_t) i);
+            }
+        }
+    }
+
+    // Handle temperature updates, the weather info also depends on the light state
+    if(changed & GUI_WEATHER_FIELDS) {
+        // Format temperature string
+        sprintf(temp_str, "%.1f°C", state->temperature);
+
+        // Format humidity string
+        sprintf(hum_str, "%.1f%%", state->humidity);
+
+        // Update GUI with temperature and humidity
+        gui_local_temp_set(temp_str);
+        gui_sntp_temp_set(temp_str); // Also update the SNTP temp for consistency
+        gui_hum_temp_set(hum_str);
+
+        // Update weather info based on temperature and light
+        char weather_info[64];
+        if(state->light_state == LIGHT_STATE_DAY) {
+            if(state->temperature > 25) {
+                sprintf(weather_info, "Sunny, %.1f°C", state->temperature);
+            } else {
+                sprintf(weather_info, "Cloudy, %.1f°C", state->temperature);
+            }
+            gui_set_day();
+        } else {
+            gui_set_night();
+            sprintf(weather_info, "Night, %.1f°C", state->temperature);
+        }
+        gui_weather_set(weather_info);
+    }
+}
 
 /**
    * @brief Main task for the GUI controller
@@ -67,8 +170,9 @@ static void light_state_callback(light_state_t state);
 static void gui_controller_task(void *pvParameters) {
     char time_str[16] = { 0 };
     char date_str[16] = { 0 };
-    char temp_str[16] = { 0 };
-    char hum_str[16]  = { 0 };
+
+    vehicle_state_t state;
+    uint32_t state_version = 0;
 
     ESP_LOGI(TAG, "GUI controller task started");
 
@@ -77,37 +181,12 @@ static void gui_controller_task(void *pvParameters) {
     while(1) {
         EventBits_t events = xEventGroupGetBits(gui_event_group);
 
-        // Handle speed updates
-        if(events & GUI_EVT_SPEED_UPDATE) {
-            gui_speed_bar_set(current_speed);
-            xEventGroupClearBits(gui_event_group, GUI_EVT_SPEED_UPDATE);
-            ESP_LOGI(TAG, "Updated speed: %.2f", current_speed);
-        }
+        // Redraw only what the detectors changed since the previous cycle
+        uint32_t changed = vehicle_state_read(&state, state_version);
+        state_version    = state.version;
 
-        // Handle proximity updates
-        if(events & GUI_EVT_PROXIMITY_UPDATE) {
-            // Ensure the proximity value is valid before updating
-            if(current_proximity >= 0 && current_proximity < GUI_PROX_NUM) {
-                ESP_LOGD(TAG, "Setting proximity to: %d", current_proximity);
-                gui_set_parking_panel();
-                gui_proximity_set(current_proximity);
-            } else {
-                ESP_LOGW(TAG, "Skipping proximity update - invalid value: %d", current_proximity);
-            }
-            xEventGroupClearBits(gui_event_group, GUI_EVT_PROXIMITY_UPDATE);
-        }
-
-        // Handle door updates
-        if(events & GUI_EVT_DOOR_UPDATE) {
-            gui_set_doors_panel();
-            for(int i = 0; i < gui_num_of_doors; i++) {
-                if(door_states[i] == DOOR_STATE_OPEN) {
-                    gui_set_door_open((gui_doors_t) i);
-                } else if(door_states[i] == DOOR_STATE_CLOSED) {
-                    gui_set_door_closed((gui_doors_t) i);
-                }
-            }
-            xEventGroupClearBits(gui_event_group, GUI_EVT_DOOR_UPDATE);
+        if(changed) {
+            gui_controller_apply_state(&state, changed);
         }
 
         // Handle time updates
@@ -129,37 +208,6 @@ static void gui_controller_task(void *pvParameters) {
             xEventGroupClearBits(gui_event_group, GUI_EVT_TIME_UPDATE);
         }
 
-        // Handle temperature updates
-        if(events & GUI_EVT_TEMP_UPDATE) {
-            // Format temperature string
-            sprintf(temp_str, "%.1f°C", current_temp_humidity.temperature);
-
-            // Format humidity string
-            sprintf(hum_str, "%.1f%%", current_temp_humidity.humidity);
-
-            // Update GUI with temperature and humidity
-            gui_local_temp_set(temp_str);
-            gui_sntp_temp_set(temp_str); // Also update the SNTP temp for consistency
-            gui_hum_temp_set(hum_str);
-
-            // Update weather info based on temperature and light
-            char weather_info[64];
-            if(current_light_state == LIGHT_STATE_DAY) {
-                if(current_temp_humidity.temperature > 25) {
-                    sprintf(weather_info, "Sunny, %.1f°C", current_temp_humidity.temperature);
-                } else {
-                    sprintf(weather_info, "Cloudy, %.1f°C", current_temp_humidity.temperature);
-                }
-                gui_set_day();
-            } else {
-                gui_set_night();
-                sprintf(weather_info, "Night, %.1f°C", current_temp_humidity.temperature);
-            }
-            gui_weather_set(weather_info);
-
-            xEventGroupClearBits(gui_event_group, GUI_EVT_TEMP_UPDATE);
-        }
-
         // Handle fuel updates
         if(events & GUI_EVT_FUEL_UPDATE) {
             gui_fuel_percentage_set(fuel_percentage);
@@ -179,59 +227,15 @@ static void gui_controller_task(void *pvParameters) {
     }
 }
 
-/**
-   * @brief Updates proximity based on parking sensor data
-   */
-static void update_proximity_from_parking_sensor(void) {
-    uint32_t distance;
-    esp_err_t err = parking_sensor_get_distance(&distance);
-
-    if(err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get parking sensor distance");
-        return;
-    }
-
-    movement_direction_t direction = speed_estimator_get_direction();
-    bool is_forward                = (direction == DIRECTION_FORWARD);
-
-    // Check if current distance is valid for updating proximity
-    if(distance > MAX_DISTANCE) {
-        ESP_LOGW(TAG, "Invalid distance reading: %lu", distance);
-        return;
-    }
-
-    // Determine the appropriate proximity value based on distance and direction
-    if(distance < DISTANCE_DANGER) {
-        current_proximity = is_forward ? GUI_PROX_FRONT_CLOSE : GUI_PROX_BACK_CLOSE;
-    } else if(distance < DISTANCE_WARNING) {
-        current_proximity = is_forward ? GUI_PROX_FRONT_MID : GUI_PROX_BACK_MID;
-    } else if(distance < DISTANCE_SAFE) {
-        current_proximity = is_forward ? GUI_PROX_FRONT_FAR : GUI_PROX_BACK_FAR;
-    } else {
-        // No proximity detected - this needs to be handled differently
-        // since GUI_PROX_NONE is not a valid value in the enum
-        current_proximity = GUI_PROX_NOTHING_NEAR; // Setting to invalid value that will be caught by validation
-    }
-
-    // Only update the GUI if we have a valid proximity value
-    if(current_proximity >= 0 && current_proximity < GUI_PROX_NUM) {
-        ESP_LOGI(TAG,
-                "Updating proximity: %d (distance: %lu cm, direction: %s)",
-                current_proximity,
-                distance,
-                is_forward ? "forward" : "backward");
-        xEventGroupSetBits(gui_event_group, GUI_EVT_PROXIMITY_UPDATE);
-    } else {
-        ESP_LOGW(TAG, "Invalid proximity value: %d", current_proximity);
-    }
-}
-
 /**
     * @brief Crash event callback
     */
 static void crash_event_callback(crash_event_t *event) {
-    crash_detected = true;
-    ESP_LOGI(TAG, "Crash detected! Impact force: %.2f g", event->impact_force);
+    ESP_LOGI(TAG,
+            "Crash detected! Impact force: %.2f g (%s, %s)",
+            event->impact_force,
+            crash_classifier_severity_str(event->severity),
+            crash_classifier_direction_str(event->direction));
 
     // You could add warning indicators to the GUI for crashes
     // For example, make speed indicator flash red
@@ -239,28 +243,6 @@ static void crash_event_callback(crash_event_t *event) {
     // Auto-reset after a while
     vTaskDelay(pdMS_TO_TICKS(CRASH_RESET_TIMEOUT_MS));
     crash_detector_reset();
-    crash_detected = false;
-}
-
-/**
-    * @brief Door state change callback
-    */
-static void door_state_callback(door_state_t state) {
-    // Mock: Update the driver's door for demonstration
-    door_states[front_left] = state; // Use enum from gui.h
-
-    xEventGroupSetBits(gui_event_group, GUI_EVT_DOOR_UPDATE);
-}
-
-/**
-    * @brief Light state change callback
-    */
-static void light_state_callback(light_state_t state) {
-    current_light_state = state;
-    xEventGroupSetBits(gui_event_group, GUI_EVT_LIGHT_UPDATE);
-
-    // Update temperature display which includes light state
-    xEventGroupSetBits(gui_event_group, GUI_EVT_TEMP_UPDATE);
 }
 
 /**
@@ -268,18 +250,16 @@ static void light_state_callback(light_state_t state) {
     */
 static void temp_sensor_task(void *pvParameters) {
     TickType_t last_wake_time = xTaskGetTickCount();
+    sht3x_sensors_values_t temp_humidity;
 
     while(1) {
         // Read temperature and humidity
-        esp_err_t err = sht3x_read_measurement(&current_temp_humidity);
+        esp_err_t err = sht3x_read_measurement(&temp_humidity);
 
         if(err == ESP_OK) {
-            ESP_LOGI(TAG,
-                    "Temperature: %.2f°C, Humidity: %.2f%%",
-                    current_temp_humidity.temperature,
-                    current_temp_humidity.humidity);
+            ESP_LOGI(TAG, "Temperature: %.2f°C, Humidity: %.2f%%", temp_humidity.temperature, temp_humidity.humidity);
 
-            xEventGroupSetBits(gui_event_group, GUI_EVT_TEMP_UPDATE);
+            vehicle_state_publish_climate(temp_humidity.temperature, temp_humidity.humidity);
         } else {
             ESP_LOGE(TAG, "Failed to read SHT3x sensor");
         }
@@ -289,43 +269,6 @@ static void temp_sensor_task(void *pvParameters) {
     }
 }
 
-/**
-    * @brief Sensor reading function for the speed estimator
-    */
-static void speed_sensor_task(void *pvParameters) {
-    TickType_t last_wake_time = xTaskGetTickCount();
-
-    while(1) {
-        // Get speed from the speed estimator
-        float speed_kmh = speed_estimator_get_speed_kmh();
-        current_speed   = speed_kmh;
-
-        // Set the event bit to update the GUI
-        xEventGroupSetBits(gui_event_group, GUI_EVT_SPEED_UPDATE);
-
-        // Also update proximity since direction might have changed
-        update_proximity_from_parking_sensor();
-
-        // Update every 200ms
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(200));
-    }
-}
-
-/**
-   * @brief Task to periodically update proximity readings
-   */
-static void proximity_sensor_task(void *pvParameters) {
-    TickType_t last_wake_time = xTaskGetTickCount();
-
-    while(1) {
-        // Update proximity values
-        update_proximity_from_parking_sensor();
-
-        // Check proximity every 200ms
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(200));
-    }
-}
-
 /**
    * @brief Initialize the GUI controller
    * 
@@ -344,8 +287,6 @@ esp_err_t gui_controller_init(void) {
 
     // Register callbacks for existing modules
     crash_detector_register_callback(crash_event_callback);
-    door_register_callback(door_state_callback);
-    light_register_callback(light_state_callback);
 
     // Create GUI controller task
     BaseType_t task_created = xTaskCreatePinnedToCore(gui_controller_task,
@@ -370,24 +311,8 @@ esp_err_t gui_controller_init(void) {
         return ESP_FAIL;
     }
 
-    // Create speed sensor task
-    task_created = xTaskCreate(speed_sensor_task, "speed_sensor", 2048, NULL, 4, NULL);
-
-    if(task_created != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create speed sensor task");
-        return ESP_FAIL;
-    }
-
-    // Create proximity sensor task
-    task_created = xTaskCreate(proximity_sensor_task, "proximity_sensor", 2048, NULL, 4, NULL);
-
-    if(task_created != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create proximity sensor task");
-        return ESP_FAIL;
-    }
-
     // Trigger initial updates
-    xEventGroupSetBits(gui_event_group, GUI_EVT_SPEED_UPDATE | GUI_EVT_TIME_UPDATE | GUI_EVT_FUEL_UPDATE);
+    xEventGroupSetBits(gui_event_group, GUI_EVT_TIME_UPDATE | GUI_EVT_FUEL_UPDATE);
 
     ESP_LOGI(TAG, "GUI controller initialized successfully");
     return ESP_OK;
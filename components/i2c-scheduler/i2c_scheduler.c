@@ -0,0 +1,376 @@
+/**
+ * @file i2c_scheduler.c
+ *
+ * @brief Priority and deadline scheduling of the shared I2C sensor bus.
+ *
+ * Each device carries a class and a queueing deadline. A request stamps its waiter with
+ * the time it arrived plus that deadline, and the release picks the waiter with the
+ * highest class and, within the class, the earliest absolute deadline. Deadlines are only
+ * used for ordering, a late grant is counted as a miss in the statistics, not dropped.
+ *
+ * A device that holds several register accesses back to back keeps the bus for up to
+ * I2C_SCHEDULER_MAX_BATCH transactions ahead of its own class, never ahead of a higher one.
+ *
+ * Waiters live in a fixed table and each one blocks on its own binary semaphore. Release
+ * moves ownership to the chosen slot under the lock and then gives only that semaphore,
+ * so the bus is never free for a task the scheduler did not pick.
+ *
+ */
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "i2c_scheduler.h"
+
+//---------------------------------- MACROS -----------------------------------
+#define TAG "I2C_SCHED"
+
+#define I2C_SCHEDULER_MAX_DEVICES      (8)
+#define I2C_SCHEDULER_MAX_WAITERS      (8)      // Upper bound of tasks waiting for the bus
+#define I2C_SCHEDULER_MAX_BATCH        (4)      // Transactions in a row to one device before others of its class go
+#define I2C_SCHEDULER_DEFAULT_DEADLINE (100000) // Deadline of devices that were never registered, in us
+#define I2C_SCHEDULER_NO_OWNER         (-1)
+
+//-------------------------------- DATA TYPES ---------------------------------
+typedef struct {
+    uint8_t addr;
+    const char *name;
+    i2c_scheduler_priority_t priority;
+    uint32_t deadline_us;
+    i2c_scheduler_stats_t stats;
+} _device_t;
+
+typedef enum {
+    _WAITER_FREE,
+    _WAITER_WAITING,
+    _WAITER_GRANTED,
+} _waiter_state_t;
+
+typedef struct {
+    _waiter_state_t state;
+    int device;
+    int64_t deadline_us;
+    SemaphoreHandle_t grant;
+} _waiter_t;
+
+//---------------------- PRIVATE FUNCTION PROTOTYPES --------------------------
+static int _device_find(uint8_t addr);
+static int _device_lookup(uint8_t addr);
+static bool _ranks_before(const _waiter_t *a, const _waiter_t *b);
+static _waiter_t *_pick_next(int finished);
+static void _stats_timer_cb(void *arg);
+
+//------------------------- STATIC DATA & CONSTANTS ---------------------------
+static portMUX_TYPE _scheduler_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool _is_initialized    = false;
+static int _owner              = I2C_SCHEDULER_NO_OWNER;
+static int _batch_length       = 0;
+static int64_t _acquired_at_us = 0;
+
+static _device_t _devices[I2C_SCHEDULER_MAX_DEVICES];
+static int _device_count = 0;
+static _waiter_t _waiters[I2C_SCHEDULER_MAX_WAITERS];
+
+static esp_timer_handle_t _stats_timer = NULL;
+
+//------------------------------- GLOBAL DATA ---------------------------------
+
+//------------------------------ PUBLIC FUNCTIONS -----------------------------
+
+esp_err_t i2c_scheduler_init(void) {
+    if(_is_initialized) {
+        return ESP_OK;
+    }
+
+    memset(_waiters, 0, sizeof(_waiters));
+    for(int i = 0; i < I2C_SCHEDULER_MAX_WAITERS; i++) {
+        _waiters[i].grant = xSemaphoreCreateBinary();
+        if(_waiters[i].grant == NULL) {
+            ESP_LOGE(TAG, "Failed to create grant semaphore");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    memset(_devices, 0, sizeof(_devices));
+    _device_count   = 0;
+    _owner          = I2C_SCHEDULER_NO_OWNER;
+    _is_initialized = true;
+
+    if(I2C_SCHEDULER_STATS_PERIOD_MS > 0) {
+        const esp_timer_create_args_t stats_timer_args = { .callback = _stats_timer_cb, .name = "i2c_sched_stats" };
+        if(esp_timer_create(&stats_timer_args, &_stats_timer) != ESP_OK
+                || esp_timer_start_periodic(_stats_timer, I2C_SCHEDULER_STATS_PERIOD_MS * 1000ULL) != ESP_OK) {
+            ESP_LOGW(TAG, "Statistics log timer unavailable");
+        }
+    }
+
+    ESP_LOGI(TAG, "I2C bus scheduler initialized");
+    return ESP_OK;
+}
+
+esp_err_t i2c_scheduler_register(uint8_t addr,
+        const char *name,
+        i2c_scheduler_priority_t priority,
+        uint32_t deadline_us) {
+    if(priority >= I2C_SCHEDULER_PRIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&_scheduler_lock);
+    int device = _device_lookup(addr);
+    if(device != I2C_SCHEDULER_NO_OWNER) {
+        _devices[device].name        = name;
+        _devices[device].priority    = priority;
+        _devices[device].deadline_us = deadline_us;
+    }
+    portEXIT_CRITICAL(&_scheduler_lock);
+
+    if(device == I2C_SCHEDULER_NO_OWNER) {
+        ESP_LOGE(TAG, "Device table full, 0x%02x not registered", addr);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_scheduler_acquire(uint8_t addr) {
+    if(!_is_initialized) {
+        return ESP_OK;
+    }
+
+    int64_t requested_at_us = esp_timer_get_time();
+    _waiter_t *waiter       = NULL;
+    bool granted            = false;
+
+    portENTER_CRITICAL(&_scheduler_lock);
+    int device = _device_lookup(addr);
+    if(device != I2C_SCHEDULER_NO_OWNER) {
+        if(_owner == I2C_SCHEDULER_NO_OWNER) {
+            _owner        = device;
+            _batch_length = 1;
+            granted       = true;
+        } else {
+            for(int i = 0; i < I2C_SCHEDULER_MAX_WAITERS; i++) {
+                if(_waiters[i].state == _WAITER_FREE) {
+                    waiter              = &_waiters[i];
+                    waiter->state       = _WAITER_WAITING;
+                    waiter->device      = device;
+                    waiter->deadline_us = requested_at_us + _devices[device].deadline_us;
+                    break;
+                }
+            }
+        }
+    }
+    portEXIT_CRITICAL(&_scheduler_lock);
+
+    if(device == I2C_SCHEDULER_NO_OWNER || (!granted && waiter == NULL)) {
+        ESP_LOGE(TAG, "Out of device or waiter slots for 0x%02x", addr);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The releasing transaction makes us the owner before giving the semaphore
+    if(!granted) {
+        xSemaphoreTake(waiter->grant, portMAX_DELAY);
+    }
+
+    int64_t now_us   = esp_timer_get_time();
+    uint32_t wait_us = (uint32_t) (now_us - requested_at_us);
+
+    portENTER_CRITICAL(&_scheduler_lock);
+    i2c_scheduler_stats_t *stats = &_devices[device].stats;
+    _acquired_at_us              = now_us;
+    stats->transactions++;
+    stats->total_wait_us += wait_us;
+    if(!granted) {
+        stats->contended++;
+        if(now_us > waiter->deadline_us) {
+            stats->deadline_misses++;
+        }
+        waiter->state = _WAITER_FREE;
+    }
+    if(wait_us > stats->max_wait_us) {
+        stats->max_wait_us = wait_us;
+    }
+    portEXIT_CRITICAL(&_scheduler_lock);
+
+    return ESP_OK;
+}
+
+void i2c_scheduler_release(uint8_t addr) {
+    if(!_is_initialized) {
+        return;
+    }
+
+    _waiter_t *next = NULL;
+    int64_t now_us  = esp_timer_get_time();
+
+    portENTER_CRITICAL(&_scheduler_lock);
+    uint32_t hold_us = (uint32_t) (now_us - _acquired_at_us);
+    int device       = _device_find(addr);
+    if(device == I2C_SCHEDULER_NO_OWNER || _owner != device) {
+        portEXIT_CRITICAL(&_scheduler_lock);
+        ESP_LOGW(TAG, "Device 0x%02x released a bus it does not own", addr);
+        return;
+    }
+
+    if(hold_us > _devices[device].stats.max_hold_us) {
+        _devices[device].stats.max_hold_us = hold_us;
+    }
+
+    next = _pick_next(device);
+    if(next != NULL) {
+        next->state = _WAITER_GRANTED;
+        if(next->device == device) {
+            _batch_length++;
+            _devices[device].stats.batched++;
+        } else {
+            _batch_length = 1;
+        }
+        _owner = next->device;
+    } else {
+        _owner = I2C_SCHEDULER_NO_OWNER;
+    }
+    portEXIT_CRITICAL(&_scheduler_lock);
+
+    if(next != NULL) {
+        xSemaphoreGive(next->grant);
+    }
+}
+
+esp_err_t i2c_scheduler_get_stats(uint8_t addr, i2c_scheduler_stats_t *stats) {
+    if(stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&_scheduler_lock);
+    int device = _device_find(addr);
+    if(device != I2C_SCHEDULER_NO_OWNER) {
+        memcpy(stats, &_devices[device].stats, sizeof(i2c_scheduler_stats_t));
+    }
+    portEXIT_CRITICAL(&_scheduler_lock);
+
+    return device != I2C_SCHEDULER_NO_OWNER ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void i2c_scheduler_log_stats(void) {
+    for(int device = 0; device < _device_count; device++) {
+        i2c_scheduler_stats_t stats;
+        portENTER_CRITICAL(&_scheduler_lock);
+        memcpy(&stats, &_devices[device].stats, sizeof(i2c_scheduler_stats_t));
+        portEXIT_CRITICAL(&_scheduler_lock);
+
+        uint32_t avg_wait_us = stats.transactions ? (uint32_t) (stats.total_wait_us / stats.transactions) : 0;
+        ESP_LOGI(TAG,
+                "%-8s 0x%02x: %lu transactions, %lu contended, %lu batched, wait avg %lu us max %lu us, "
+                "%lu deadline misses, hold max %lu us",
+                _devices[device].name ? _devices[device].name : "?",
+                _devices[device].addr,
+                stats.transactions,
+                stats.contended,
+                stats.batched,
+                avg_wait_us,
+                stats.max_wait_us,
+                stats.deadline_misses,
+                stats.max_hold_us);
+    }
+}
+
+void i2c_scheduler_reset_stats(void) {
+    portENTER_CRITICAL(&_scheduler_lock);
+    for(int device = 0; device < _device_count; device++) {
+        memset(&_devices[device].stats, 0, sizeof(i2c_scheduler_stats_t));
+    }
+    portEXIT_CRITICAL(&_scheduler_lock);
+}
+
+//---------------------------- PRIVATE FUNCTIONS ------------------------------
+
+/**
+  * @brief Index of a known device, call with the lock held.
+  *
+  */
+static int _device_find(uint8_t addr) {
+    for(int device = 0; device < _device_count; device++) {
+        if(_devices[device].addr == addr) {
+            return device;
+        }
+    }
+    return I2C_SCHEDULER_NO_OWNER;
+}
+
+/**
+  * @brief Index of a device, adding it with the default class if it is new, call with the lock held.
+  *
+  */
+static int _device_lookup(uint8_t addr) {
+    int device = _device_find(addr);
+    if(device != I2C_SCHEDULER_NO_OWNER || _device_count >= I2C_SCHEDULER_MAX_DEVICES) {
+        return device;
+    }
+
+    device                       = _device_count++;
+    _devices[device].addr        = addr;
+    _devices[device].name        = NULL;
+    _devices[device].priority    = I2C_SCHEDULER_PRIO_SENSOR;
+    _devices[device].deadline_us = I2C_SCHEDULER_DEFAULT_DEADLINE;
+    return device;
+}
+
+/**
+  * @brief Whether waiter a is served before waiter b: higher class first, then earlier deadline.
+  *
+  */
+static bool _ranks_before(const _waiter_t *a, const _waiter_t *b) {
+    i2c_scheduler_priority_t prio_a = _devices[a->device].priority;
+    i2c_scheduler_priority_t prio_b = _devices[b->device].priority;
+
+    if(prio_a != prio_b) {
+        return prio_a < prio_b;
+    }
+    // Signed difference keeps the comparison valid for deadlines in the past
+    return (a->deadline_us - b->deadline_us) < 0;
+}
+
+/**
+  * @brief Choose the waiter that gets the bus after the finished device, call with the lock held.
+  *
+  */
+static _waiter_t *_pick_next(int finished) {
+    _waiter_t *best  = NULL;
+    _waiter_t *batch = NULL;
+
+    for(int i = 0; i < I2C_SCHEDULER_MAX_WAITERS; i++) {
+        _waiter_t *waiter = &_waiters[i];
+        if(waiter->state != _WAITER_WAITING) {
+            continue;
+        }
+        if(best == NULL || _ranks_before(waiter, best)) {
+            best = waiter;
+        }
+        if(waiter->device == finished && (batch == NULL || _ranks_before(waiter, batch))) {
+            batch = waiter;
+        }
+    }
+
+    // Back-to-back transactions to one device, but never ahead of a higher class
+    if(batch != NULL && _batch_length < I2C_SCHEDULER_MAX_BATCH
+            && _devices[batch->device].priority == _devices[best->device].priority) {
+        return batch;
+    }
+    return best;
+}
+
+/**
+  * @brief Periodic statistics log, runs in the esp_timer task.
+  *
+  */
+static void _stats_timer_cb(void *arg) {
+    (void) arg;
+
+    i2c_scheduler_log_stats();
+}
+
+//---------------------------- INTERRUPT HANDLERS -----------------------------
@@ -0,0 +1,123 @@
+/**
+ * @file i2c_scheduler.h
+ * 
+ * @brief Priority and deadline scheduling of the shared I2C sensor bus.
+ * 
+ */
+
+#ifndef I2C_SCHEDULER_H
+#define I2C_SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <stdint.h>
+#include "esp_err.h"
+
+//---------------------------------- MACROS -----------------------------------
+#ifndef I2C_SCHEDULER_STATS_PERIOD_MS
+#define I2C_SCHEDULER_STATS_PERIOD_MS (60000) // Period of the statistics log, 0 disables it
+#endif
+
+//-------------------------------- DATA TYPES ---------------------------------
+/**
+  * @brief Transaction classes in descending priority order.
+  *
+  */
+typedef enum {
+    I2C_SCHEDULER_PRIO_SAFETY,     // Crash signal and door inputs, never waits behind a sensor
+    I2C_SCHEDULER_PRIO_SENSOR,     // Periodic sensor reads and configuration
+    I2C_SCHEDULER_PRIO_BACKGROUND, // RTC and EEPROM, no latency requirement
+
+    I2C_SCHEDULER_PRIO_COUNT
+} i2c_scheduler_priority_t;
+
+/**
+  * @brief Per-device bus usage statistics.
+  *
+  */
+typedef struct {
+    uint32_t transactions;    // Number of times the bus was granted
+    uint32_t contended;       // Grants that had to wait for another transaction
+    uint32_t batched;         // Grants handed over directly from a transaction to the same device
+    uint32_t deadline_misses; // Grants that came later than the device deadline
+    uint32_t max_wait_us;     // Worst-case queueing delay
+    uint64_t total_wait_us;   // Sum of all queueing delays
+    uint32_t max_hold_us;     // Longest transaction
+} i2c_scheduler_stats_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES --------------------------
+/**
+  * @brief Initialize the scheduler, must be called before any device uses the bus.
+  *
+  * @return esp_err_t ESP_OK on success, fail otherwise.
+  */
+esp_err_t i2c_scheduler_init(void);
+
+/**
+  * @brief Set the transaction class and the queueing deadline of a device.
+  *
+  * A device that was never registered is scheduled as a sensor with a 100 ms deadline.
+  *
+  * @param [in] addr Unshifted 7-bit device address.
+  * @param [in] name Short name used in the statistics log, must stay valid.
+  * @param [in] priority Transaction class.
+  * @param [in] deadline_us Longest acceptable time from request to grant.
+  *
+  * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown class, ESP_ERR_NO_MEM if the table is full.
+  */
+esp_err_t i2c_scheduler_register(uint8_t addr,
+        const char *name,
+        i2c_scheduler_priority_t priority,
+        uint32_t deadline_us);
+
+/**
+  * @brief Block until the bus is granted for one transaction with the device.
+  *
+  * When the bus is released it is handed to the waiter of the highest class, the
+  * earliest deadline wins within a class. A waiter of the device that just finished
+  * goes first within its class, up to 4 transactions in a row, so register accesses
+  * of one driver run back-to-back. Scheduling is bypassed until i2c_scheduler_init().
+  *
+  * @param [in] addr Unshifted 7-bit device address.
+  *
+  * @return esp_err_t ESP_OK once the bus is owned, ESP_ERR_NO_MEM if the device or waiter table is full.
+  */
+esp_err_t i2c_scheduler_acquire(uint8_t addr);
+
+/**
+  * @brief Release the bus previously granted with i2c_scheduler_acquire().
+  *
+  * @param [in] addr Device that owns the bus.
+  */
+void i2c_scheduler_release(uint8_t addr);
+
+/**
+  * @brief Get a copy of the usage statistics of a device.
+  *
+  * @param [in] addr Unshifted 7-bit device address.
+  * @param [out] stats Statistics copy.
+  *
+  * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND for a device that never used the bus.
+  */
+esp_err_t i2c_scheduler_get_stats(uint8_t addr, i2c_scheduler_stats_t *stats);
+
+/**
+  * @brief Log the queueing delay of every device.
+  *
+  * Also called every I2C_SCHEDULER_STATS_PERIOD_MS from a timer started by i2c_scheduler_init().
+  */
+void i2c_scheduler_log_stats(void);
+
+/**
+  * @brief Clear the usage statistics of all devices.
+  */
+void i2c_scheduler_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // I2C_SCHEDULER_H
@@ -36,6 +36,7 @@
 #include <freertos/task.h>
 #include <esp_log.h>
 #include "i2cdev.h"
+#include "i2c_scheduler.h"
 
 static const char *TAG = "i2cdev";
 
@@ -237,10 +238,7 @@ static esp_err_t i2c_setup_port(const i2c_dev_t *dev) {
     return ESP_OK;
 }
 
-esp_err_t i2c_dev_probe(const i2c_dev_t *dev, i2c_dev_type_t operation_type) {
-    if(!dev)
-        return ESP_ERR_INVALID_ARG;
-
+static esp_err_t i2c_dev_probe_scheduled(const i2c_dev_t *dev, i2c_dev_type_t operation_type) {
     SEMAPHORE_TAKE(dev->port);
 
     esp_err_t res = i2c_setup_port(dev);
@@ -260,10 +258,11 @@ esp_err_t i2c_dev_probe(const i2c_dev_t *dev, i2c_dev_type_t operation_type) {
     return res;
 }
 
-esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size) {
-    if(!dev || !in_data || !in_size)
-        return ESP_ERR_INVALID_ARG;
-
+static esp_err_t i2c_dev_read_scheduled(const i2c_dev_t *dev,
+        const void *out_data,
+        size_t out_size,
+        void *in_data,
+        size_t in_size) {
     SEMAPHORE_TAKE(dev->port);
 
     esp_err_t res = i2c_setup_port(dev);
@@ -290,10 +289,11 @@ esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_si
     return res;
 }
 
-esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size) {
-    if(!dev || !out_data || !out_size)
-        return ESP_ERR_INVALID_ARG;
-
+static esp_err_t i2c_dev_write_scheduled(const i2c_dev_t *dev,
+        const void *out_reg,
+        size_t out_reg_size,
+        const void *out_data,
+        size_t out_size) {
     SEMAPHORE_TAKE(dev->port);
 
     esp_err_t res = i2c_setup_port(dev);
@@ -315,6 +315,46 @@ esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_re
     return res;
 }
 
+// The bus scheduler grants the port to one transaction at a time, the port mutex below it stays as a safety net
+esp_err_t i2c_dev_probe(const i2c_dev_t *dev, i2c_dev_type_t operation_type) {
+    if(!dev)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t res = i2c_scheduler_acquire(dev->addr);
+    if(res != ESP_OK)
+        return res;
+
+    res = i2c_dev_probe_scheduled(dev, operation_type);
+    i2c_scheduler_release(dev->addr);
+    return res;
+}
+
+esp_err_t i2c_dev_read(const i2c_dev_t *dev, const void *out_data, size_t out_size, void *in_data, size_t in_size) {
+    if(!dev || !in_data || !in_size)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t res = i2c_scheduler_acquire(dev->addr);
+    if(res != ESP_OK)
+        return res;
+
+    res = i2c_dev_read_scheduled(dev, out_data, out_size, in_data, in_size);
+    i2c_scheduler_release(dev->addr);
+    return res;
+}
+
+esp_err_t i2c_dev_write(const i2c_dev_t *dev, const void *out_reg, size_t out_reg_size, const void *out_data, size_t out_size) {
+    if(!dev || !out_data || !out_size)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t res = i2c_scheduler_acquire(dev->addr);
+    if(res != ESP_OK)
+        return res;
+
+    res = i2c_dev_write_scheduled(dev, out_reg, out_reg_size, out_data, out_size);
+    i2c_scheduler_release(dev->addr);
+    return res;
+}
+
 esp_err_t i2c_dev_read_reg(const i2c_dev_t *dev, uint8_t reg, void *in_data, size_t in_size) {
     return i2c_dev_read(dev, &reg, 1, in_data, in_size);
 }
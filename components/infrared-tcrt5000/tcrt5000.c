@@ -5,14 +5,11 @@
 
 #include "tcrt5000.h"
 #include "esp_log.h"
-#include "pcf8574.h"
+#include "expander_service.h"
 #include <stdbool.h>
 
 static const char *TAG = "TCRT5000";
 
-extern i2c_dev_t expander;
-extern uint8_t expander_state; // shared state for expander
-
 esp_err_t tcrt5000_init(const tcrt5000_config_t *config, tcrt5000_handle_t *handle) {
     if(config == NULL || handle == NULL) {
         return ESP_ERR_INVALID_ARG;
@@ -22,9 +19,9 @@ esp_err_t tcrt5000_init(const tcrt5000_config_t *config, tcrt5000_handle_t *hand
     handle->config = *config;
 
     if(config->use_expander) {
-        // Set expander pin high to enable input mode
-        expander_state |= (1 << config->digital_pin);
-        esp_err_t ret   = pcf8574_port_write(&expander, expander_state);
+        // Set expander pin high to enable input mode, written right away so the first read is valid
+        expander_service_set(EXPANDER_PIN(config->digital_pin));
+        esp_err_t ret = expander_service_flush();
         if(ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to set expander pin %d as input: %s", config->digital_pin, esp_err_to_name(ret));
             return ret;
@@ -91,14 +88,13 @@ esp_err_t tcrt5000_read_digital(tcrt5000_handle_t *handle, bool *detected) {
 
     if(handle->config.use_expander) {
         uint8_t port_val = 0;
-        esp_err_t ret    = pcf8574_port_read(&expander, &port_val);
+        esp_err_t ret    = expander_service_read(&port_val, EXPANDER_SERVICE_CACHE_MS);
         if(ret != ESP_OK) {
             ESP_LOGE(TAG, "Failed to read from expander: %s", esp_err_to_name(ret));
             return ret;
         }
 
-        bool level = port_val & (1 << handle->config.digital_pin);
-        *detected  = handle->config.invert_output ? !level : level;
+        return tcrt5000_decode_port(handle, port_val, detected);
     } else if(handle->config.use_digital) {
         int level = gpio_get_level(handle->config.digital_pin);
         *detected = handle->config.invert_output ? !level : level;
@@ -113,4 +109,13 @@ esp_err_t tcrt5000_read_digital(tcrt5000_handle_t *handle, bool *detected) {
     }
 
     return ESP_OK;
-}
\ No newline at end of file
+}
+esp_err_t tcrt5000_decode_port(const tcrt5000_handle_t *handle, uint8_t port_val, bool *detected) {
+    if(handle == NULL || detected == NULL || !handle->config.use_expander) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool level = port_val & (1 << handle->config.digital_pin);
+    *detected  = handle->config.invert_output ? !level : level;
+    return ESP_OK;
+}
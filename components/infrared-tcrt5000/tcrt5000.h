@@ -59,4 +59,14 @@ esp_err_t tcrt5000_read_raw(tcrt5000_handle_t *handle, uint32_t *value);
  */
 esp_err_t tcrt5000_read_digital(tcrt5000_handle_t *handle, bool *detected);
 
+/**
+ * @brief Evaluate an expander port value that was already read, e.g. by an input-change handler
+ * 
+ * @param handle Pointer to sensor handle, must be configured with use_expander
+ * @param port_val PCF8574 port value
+ * @param detected Pointer to store the detection result (1: detected, 0: not detected)
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t tcrt5000_decode_port(const tcrt5000_handle_t *handle, uint8_t port_val, bool *detected);
+
 #endif /* TCRT5000_H */
@@ -0,0 +1,257 @@
+/**
+ * @file expander_service.c
+ *
+ * @brief Single owner of the PCF8574 I/O expander, coalesces pin writes and caches port reads.
+ *
+ * The PCF8574 has no per-pin access, every change is a full port write. Before this
+ * service each user kept its own copy of the port and the last writer silently undid
+ * the others' pins. Now there is one shadow register, changed atomically under a
+ * spinlock, and a small task writes it out once the coalescing window has passed, so
+ * a burst of pin changes costs a single transfer. Reads go through the same bus lock
+ * and are shared between concurrent readers.
+ *
+ */
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "pcf8574.h"
+#include "expander_service.h"
+
+//---------------------------------- MACROS -----------------------------------
+#define TAG "EXPANDER"
+
+#define EXPANDER_SERVICE_TASK_STACK    2048
+#define EXPANDER_SERVICE_TASK_PRIORITY 7 // Above the sensor tasks that change pins
+
+//-------------------------------- DATA TYPES ---------------------------------
+
+//---------------------- PRIVATE FUNCTION PROTOTYPES --------------------------
+static void _change(uint8_t set_mask, uint8_t clear_mask, uint8_t toggle_mask);
+static void _writer_task(void *arg);
+
+//------------------------- STATIC DATA & CONSTANTS ---------------------------
+static portMUX_TYPE _shadow_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool _is_initialized            = false;
+static i2c_dev_t _dev                  = { 0 };
+static SemaphoreHandle_t _bus_lock     = NULL; // Orders port transfers, a stale value never overwrites a newer one
+static TaskHandle_t _writer_handle     = NULL;
+static uint8_t _shadow                 = 0x00; // Port value after all pending changes
+static uint8_t _written                = 0x00; // Port value last written to the chip
+static bool _write_scheduled           = false;
+static bool _read_valid                = false;
+static uint8_t _read_value             = 0x00;
+static int64_t _read_at_us             = 0;
+static expander_service_stats_t _stats = { 0 };
+
+//------------------------------- GLOBAL DATA ---------------------------------
+
+//------------------------------ PUBLIC FUNCTIONS -----------------------------
+
+esp_err_t expander_service_init(uint8_t addr,
+        i2c_port_t port,
+        gpio_num_t sda_gpio,
+        gpio_num_t scl_gpio,
+        uint8_t initial) {
+    if(_is_initialized) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = pcf8574_init_desc(&_dev, addr, port, sda_gpio, scl_gpio);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to init PCF8574 descriptor: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = pcf8574_port_write(&_dev, initial);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write to PCF8574: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    _bus_lock = xSemaphoreCreateMutex();
+    if(_bus_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create bus lock");
+        return ESP_ERR_NO_MEM;
+    }
+
+    _shadow  = initial;
+    _written = initial;
+    memset(&_stats, 0, sizeof(_stats));
+
+    BaseType_t created = xTaskCreate(_writer_task,
+            "expander",
+            EXPANDER_SERVICE_TASK_STACK,
+            NULL,
+            EXPANDER_SERVICE_TASK_PRIORITY,
+            &_writer_handle);
+    if(created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    _is_initialized = true;
+
+    ESP_LOGI(TAG, "PCF8574 at 0x%02x initialized, port 0x%02x", addr, initial);
+    return ESP_OK;
+}
+
+void expander_service_set(uint8_t mask) {
+    _change(mask, 0, 0);
+}
+
+void expander_service_clear(uint8_t mask) {
+    _change(0, mask, 0);
+}
+
+void expander_service_toggle(uint8_t mask) {
+    _change(0, 0, mask);
+}
+
+esp_err_t expander_service_flush(void) {
+    if(!_is_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(_bus_lock, portMAX_DELAY);
+
+    // Changes made after this snapshot schedule another write of their own
+    portENTER_CRITICAL(&_shadow_lock);
+    uint8_t value    = _shadow;
+    bool pending     = value != _written;
+    _write_scheduled = false;
+    portEXIT_CRITICAL(&_shadow_lock);
+
+    esp_err_t ret = ESP_OK;
+    if(pending) {
+        ret = pcf8574_port_write(&_dev, value);
+
+        portENTER_CRITICAL(&_shadow_lock);
+        if(ret == ESP_OK) {
+            _written    = value;
+            _read_valid = false; // Output pins read back their new level
+            _stats.port_writes++;
+        } else {
+            _stats.errors++;
+        }
+        portEXIT_CRITICAL(&_shadow_lock);
+    }
+
+    xSemaphoreGive(_bus_lock);
+
+    if(ret != ESP_OK) {
+        ESP_LOGE(TAG, "Port write failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+uint8_t expander_service_get_output(void) {
+    portENTER_CRITICAL(&_shadow_lock);
+    uint8_t value = _shadow;
+    portEXIT_CRITICAL(&_shadow_lock);
+    return value;
+}
+
+esp_err_t expander_service_read(uint8_t *value, uint32_t max_age_ms) {
+    if(value == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if(!_is_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(_bus_lock, portMAX_DELAY);
+
+    // The age is taken after the lock, so a caller that waited for another reader gets its result
+    int64_t age_us = esp_timer_get_time() - _read_at_us;
+    esp_err_t ret  = ESP_OK;
+
+    if(_read_valid && max_age_ms > 0 && age_us <= (int64_t) max_age_ms * 1000) {
+        *value = _read_value;
+
+        portENTER_CRITICAL(&_shadow_lock);
+        _stats.cached_reads++;
+        portEXIT_CRITICAL(&_shadow_lock);
+    } else {
+        uint8_t port = 0;
+        ret          = pcf8574_port_read(&_dev, &port);
+
+        portENTER_CRITICAL(&_shadow_lock);
+        if(ret == ESP_OK) {
+            _read_value = port;
+            _read_at_us = esp_timer_get_time();
+            _read_valid = true;
+            _stats.port_reads++;
+        } else {
+            _stats.errors++;
+        }
+        portEXIT_CRITICAL(&_shadow_lock);
+
+        *value = port;
+    }
+
+    xSemaphoreGive(_bus_lock);
+    return ret;
+}
+
+esp_err_t expander_service_get_stats(expander_service_stats_t *stats) {
+    if(stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&_shadow_lock);
+    memcpy(stats, &_stats, sizeof(expander_service_stats_t));
+    portEXIT_CRITICAL(&_shadow_lock);
+
+    return ESP_OK;
+}
+
+//---------------------------- PRIVATE FUNCTIONS ------------------------------
+
+/**
+  * @brief Apply a pin change to the shadow register and make sure a write is scheduled.
+  *
+  */
+static void _change(uint8_t set_mask, uint8_t clear_mask, uint8_t toggle_mask) {
+    bool wake = false;
+
+    portENTER_CRITICAL(&_shadow_lock);
+    uint8_t value = (uint8_t) (((_shadow | set_mask) & ~clear_mask) ^ toggle_mask);
+    if(value != _shadow) {
+        _shadow = value;
+        _stats.pin_changes++;
+    }
+    if(_shadow != _written && !_write_scheduled) {
+        _write_scheduled = true;
+        wake             = true;
+    }
+    portEXIT_CRITICAL(&_shadow_lock);
+
+    if(wake && _writer_handle) {
+        xTaskNotifyGive(_writer_handle);
+    }
+}
+
+/**
+  * @brief Write the shadow register out once the coalescing window after the first change has passed.
+  *
+  * The window is rounded to whole ticks and lasts at least one. The delay ends on a tick boundary,
+  * so at 100 Hz the port is written 0-10 ms after the first change and later changes join it.
+  *
+  */
+static void _writer_task(void *arg) {
+    while(1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(MAX(1, pdMS_TO_TICKS(EXPANDER_SERVICE_COALESCE_MS)));
+        expander_service_flush();
+    }
+}
+
+//---------------------------- INTERRUPT HANDLERS -----------------------------
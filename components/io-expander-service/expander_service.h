@@ -0,0 +1,124 @@
+/**
+ * @file expander_service.h
+ * 
+ * @brief Single owner of the PCF8574 I/O expander, coalesces pin writes and caches port reads.
+ * 
+ */
+
+#ifndef EXPANDER_SERVICE_H
+#define EXPANDER_SERVICE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+
+//---------------------------------- MACROS -----------------------------------
+#define EXPANDER_SERVICE_COALESCE_MS 10 // Pin changes within this window share one port write, one tick at 100 Hz
+#define EXPANDER_SERVICE_CACHE_MS    20 // Default age up to which a port read is served from the cache
+
+#define EXPANDER_PIN(n) ((uint8_t) (1u << (n)))
+
+//-------------------------------- DATA TYPES ---------------------------------
+/**
+  * @brief Expander bus usage statistics.
+  *
+  */
+typedef struct {
+    uint32_t pin_changes;  // set/clear/toggle calls that changed the shadow register
+    uint32_t port_writes;  // I2C port writes actually issued
+    uint32_t port_reads;   // I2C port reads actually issued
+    uint32_t cached_reads; // Reads served from the cache without bus traffic
+    uint32_t errors;       // Failed I2C transfers
+} expander_service_stats_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES --------------------------
+/**
+  * @brief Set up the expander descriptor, write the initial port value and start the write coalescer.
+  *
+  * i2cdev_init() must have been called before.
+  *
+  * @param [in] addr I2C address of the PCF8574.
+  * @param [in] port I2C port.
+  * @param [in] sda_gpio SDA pin.
+  * @param [in] scl_gpio SCL pin.
+  * @param [in] initial Initial port value, inputs must be kept high.
+  *
+  * @return esp_err_t ESP_OK on success, fail otherwise.
+  */
+esp_err_t expander_service_init(uint8_t addr,
+        i2c_port_t port,
+        gpio_num_t sda_gpio,
+        gpio_num_t scl_gpio,
+        uint8_t initial);
+
+/**
+  * @brief Drive the pins in mask high (releases them, required for inputs).
+  *
+  * The shadow register is updated atomically, the port write is deferred by up to
+  * EXPANDER_SERVICE_COALESCE_MS so that concurrent changes share one transfer.
+  *
+  * @param [in] mask Pins to change, see EXPANDER_PIN().
+  */
+void expander_service_set(uint8_t mask);
+
+/**
+  * @brief Pull the pins in mask low.
+  *
+  * @param [in] mask Pins to change, see EXPANDER_PIN().
+  */
+void expander_service_clear(uint8_t mask);
+
+/**
+  * @brief Invert the pins in mask.
+  *
+  * @param [in] mask Pins to change, see EXPANDER_PIN().
+  */
+void expander_service_toggle(uint8_t mask);
+
+/**
+  * @brief Write pending pin changes now instead of waiting for the coalescing window, e.g. for an alarm.
+  *
+  * @return esp_err_t ESP_OK on success or if nothing was pending, fail otherwise.
+  */
+esp_err_t expander_service_flush(void);
+
+/**
+  * @brief Current shadow register, i.e. the port value after all pending writes.
+  *
+  * @return uint8_t Shadow register.
+  */
+uint8_t expander_service_get_output(void);
+
+/**
+  * @brief Read the port, reusing a recent read of another caller when it is fresh enough.
+  *
+  * Concurrent callers are serialized and the later ones are served from the read the first one made.
+  * A read also releases the expander INT line, so an input-change handler should pass max_age_ms 0.
+  *
+  * @param [out] value Port value.
+  * @param [in] max_age_ms Oldest cached value accepted, 0 forces a bus read.
+  *
+  * @return esp_err_t ESP_OK on success, fail otherwise.
+  */
+esp_err_t expander_service_read(uint8_t *value, uint32_t max_age_ms);
+
+/**
+  * @brief Get a copy of the bus usage statistics.
+  *
+  * @param [out] stats Statistics copy.
+  *
+  * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for NULL stats.
+  */
+esp_err_t expander_service_get_stats(expander_service_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXPANDER_SERVICE_H
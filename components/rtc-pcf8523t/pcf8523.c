@@ -1,4 +1,5 @@
 #include "pcf8523.h"
+#include "i2c_scheduler.h"
 #include <string.h>
 
 #define PCF8523_REG_CONTROL_1 0x00
@@ -23,6 +24,25 @@ static uint8_t dec2bcd(uint8_t val) {
     return ((val / 10) << 4) + (val % 10);
 }
 
+// Register accesses go through the bus scheduler like every other device on the port
+static esp_err_t pcf8523_write(const uint8_t *data, size_t len) {
+    esp_err_t ret = i2c_scheduler_acquire(PCF8523_I2C_ADDR);
+    if(ret != ESP_OK)
+        return ret;
+    ret = i2c_master_write_to_device(g_port, PCF8523_I2C_ADDR, data, len, pdMS_TO_TICKS(1000));
+    i2c_scheduler_release(PCF8523_I2C_ADDR);
+    return ret;
+}
+
+static esp_err_t pcf8523_read(uint8_t reg, uint8_t *data, size_t len) {
+    esp_err_t ret = i2c_scheduler_acquire(PCF8523_I2C_ADDR);
+    if(ret != ESP_OK)
+        return ret;
+    ret = i2c_master_write_read_device(g_port, PCF8523_I2C_ADDR, &reg, 1, data, len, pdMS_TO_TICKS(1000));
+    i2c_scheduler_release(PCF8523_I2C_ADDR);
+    return ret;
+}
+
 esp_err_t pcf8523_init(i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio) {
     g_port = port;
 
@@ -49,7 +69,7 @@ esp_err_t pcf8523_set_time(const struct tm *time) {
         time->tm_wday,
         dec2bcd(time->tm_mon + 1),
         dec2bcd(time->tm_year - 100) };
-    return i2c_master_write_to_device(g_port, PCF8523_I2C_ADDR, data, sizeof(data), pdMS_TO_TICKS(1000));
+    return pcf8523_write(data, sizeof(data));
 }
 
 esp_err_t pcf8523_get_time(struct tm *time) {
@@ -57,8 +77,7 @@ esp_err_t pcf8523_get_time(struct tm *time) {
         return ESP_ERR_INVALID_ARG;
     uint8_t reg = PCF8523_REG_SECONDS;
     uint8_t data[7];
-    ESP_ERROR_CHECK_WITHOUT_ABORT(
-            i2c_master_write_read_device(g_port, PCF8523_I2C_ADDR, &reg, 1, data, 7, pdMS_TO_TICKS(1000)));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(pcf8523_read(reg, data, 7));
 
     time->tm_sec   = bcd2dec(data[0] & 0x7F);
     time->tm_min   = bcd2dec(data[1] & 0x7F);
@@ -76,7 +95,7 @@ esp_err_t pcf8523_check_status(pcf8523_status_t *status) {
         return ESP_ERR_INVALID_ARG;
     uint8_t reg = PCF8523_REG_SECONDS;
     uint8_t data;
-    esp_err_t ret = i2c_master_write_read_device(g_port, PCF8523_I2C_ADDR, &reg, 1, &data, 1, pdMS_TO_TICKS(1000));
+    esp_err_t ret = pcf8523_read(reg, &data, 1);
     if(ret != ESP_OK) {
         *status = PCF8523_ERROR;
         return ret;
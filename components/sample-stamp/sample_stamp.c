@@ -0,0 +1,49 @@
+/**
+ * @file sample_stamp.c
+ *
+ * @brief Microsecond capture timestamps and per-source sequence numbers for sensor samples.
+ *
+ * All pipelines stamp their samples from the same esp_timer clock at the point of acquisition,
+ * so samples of different sensors can be ordered and latencies measured across pipelines.
+ *
+ */
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <stdatomic.h>
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "sample_stamp.h"
+
+//---------------------------------- MACROS -----------------------------------
+
+//-------------------------------- DATA TYPES ---------------------------------
+
+//---------------------- PRIVATE FUNCTION PROTOTYPES --------------------------
+
+//------------------------- STATIC DATA & CONSTANTS ---------------------------
+static atomic_uint_fast32_t _next_seq[SAMPLE_SOURCE_COUNT];
+
+//------------------------------- GLOBAL DATA ---------------------------------
+
+//------------------------------ PUBLIC FUNCTIONS -----------------------------
+
+sample_stamp_t IRAM_ATTR sample_stamp_take(sample_source_t source) {
+    return sample_stamp_at(source, esp_timer_get_time());
+}
+
+sample_stamp_t IRAM_ATTR sample_stamp_at(sample_source_t source, int64_t time_us) {
+    sample_stamp_t stamp = {
+        .time_us = time_us,
+        .seq     = 0,
+    };
+
+    if(source < SAMPLE_SOURCE_COUNT) {
+        stamp.seq = (uint32_t) atomic_fetch_add_explicit(&_next_seq[source], 1, memory_order_relaxed);
+    }
+
+    return stamp;
+}
+
+//---------------------------- PRIVATE FUNCTIONS ------------------------------
+
+//---------------------------- INTERRUPT HANDLERS -----------------------------
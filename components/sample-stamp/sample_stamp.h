@@ -0,0 +1,79 @@
+/**
+ * @file sample_stamp.h
+ * 
+ * @brief Microsecond capture timestamps and per-source sequence numbers for sensor samples.
+ * 
+ */
+
+#ifndef SAMPLE_STAMP_H
+#define SAMPLE_STAMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <stdint.h>
+
+//---------------------------------- MACROS -----------------------------------
+
+//-------------------------------- DATA TYPES ---------------------------------
+/**
+  * @brief Sample pipelines, each one numbers its samples independently.
+  *
+  */
+typedef enum {
+    SAMPLE_SOURCE_ACC,        // LIS2DH12 accelerometer samples
+    SAMPLE_SOURCE_DOOR,       // TCRT5000 door sensor reads
+    SAMPLE_SOURCE_ULTRASONIC, // HC-SR04 distance measurements
+    SAMPLE_SOURCE_LIGHT,      // VEML7700 ambient light readings
+
+    SAMPLE_SOURCE_COUNT
+} sample_source_t;
+
+/**
+  * @brief Capture time and sequence number of one sample.
+  *
+  */
+typedef struct {
+    int64_t time_us; // esp_timer_get_time() at the moment the sample was captured
+    uint32_t seq;    // Per-source sequence number, a gap means samples were lost
+} sample_stamp_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES --------------------------
+/**
+  * @brief Stamp a sample captured right now. Safe to call from an ISR.
+  *
+  * @param [in] source Pipeline the sample belongs to.
+  *
+  * @return sample_stamp_t Stamp with the current time and the next sequence number.
+  */
+sample_stamp_t sample_stamp_take(sample_source_t source);
+
+/**
+  * @brief Stamp a sample captured at a known earlier time, e.g. an older FIFO entry
+  *        or an edge timestamped by a driver. Safe to call from an ISR.
+  *
+  * @param [in] source Pipeline the sample belongs to.
+  * @param [in] time_us Capture time on the esp_timer clock.
+  *
+  * @return sample_stamp_t Stamp with the given time and the next sequence number.
+  */
+sample_stamp_t sample_stamp_at(sample_source_t source, int64_t time_us);
+
+/**
+  * @brief Capture time in milliseconds, for code that works on a millisecond clock.
+  *
+  * @param [in] stamp Sample stamp.
+  *
+  * @return uint32_t Milliseconds since boot, wraps after ~49 days.
+  */
+static inline uint32_t sample_stamp_ms(const sample_stamp_t *stamp) {
+    return (uint32_t) (stamp->time_us / 1000);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLE_STAMP_H
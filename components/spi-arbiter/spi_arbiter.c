@@ -0,0 +1,167 @@
+/**
+ * @file spi_arbiter.c
+ *
+ * @brief Priority arbitration of the shared VSPI bus between the display and the sensors.
+ *
+ * The display flushes large frame regions with DMA while the accelerometer needs short,
+ * latency critical register accesses on the same bus. Every client brackets its bus use
+ * with acquire/release. On release the bus is handed directly to the highest priority
+ * waiter, so the display can never re-take the bus ahead of a pending sensor request.
+ *
+ */
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "spi_arbiter.h"
+
+//---------------------------------- MACROS -----------------------------------
+#define TAG "SPI_ARBITER"
+
+#define SPI_ARBITER_NO_OWNER    (SPI_ARBITER_CLIENT_COUNT)
+#define SPI_ARBITER_MAX_WAITERS (8) // Upper bound of tasks waiting per client
+
+//-------------------------------- DATA TYPES ---------------------------------
+
+//---------------------- PRIVATE FUNCTION PROTOTYPES --------------------------
+
+//------------------------- STATIC DATA & CONSTANTS ---------------------------
+static portMUX_TYPE _arbiter_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool _is_initialized        = false;
+static spi_arbiter_client_t _owner = SPI_ARBITER_NO_OWNER;
+static int64_t _acquired_at_us     = 0;
+
+static uint32_t _waiting[SPI_ARBITER_CLIENT_COUNT];
+static SemaphoreHandle_t _grant_sem[SPI_ARBITER_CLIENT_COUNT];
+static spi_arbiter_stats_t _stats[SPI_ARBITER_CLIENT_COUNT];
+
+//------------------------------- GLOBAL DATA ---------------------------------
+
+//------------------------------ PUBLIC FUNCTIONS -----------------------------
+
+esp_err_t spi_arbiter_init(void) {
+    if(_is_initialized) {
+        return ESP_OK;
+    }
+
+    for(int client = 0; client < SPI_ARBITER_CLIENT_COUNT; client++) {
+        _grant_sem[client] = xSemaphoreCreateCounting(SPI_ARBITER_MAX_WAITERS, 0);
+        if(_grant_sem[client] == NULL) {
+            ESP_LOGE(TAG, "Failed to create grant semaphore");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    memset(_waiting, 0, sizeof(_waiting));
+    memset(_stats, 0, sizeof(_stats));
+    _owner          = SPI_ARBITER_NO_OWNER;
+    _is_initialized = true;
+
+    ESP_LOGI(TAG, "SPI bus arbiter initialized");
+    return ESP_OK;
+}
+
+esp_err_t spi_arbiter_acquire(spi_arbiter_client_t client) {
+    if(client >= SPI_ARBITER_CLIENT_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if(!_is_initialized) {
+        return ESP_OK;
+    }
+
+    int64_t requested_at_us = esp_timer_get_time();
+    bool granted            = false;
+
+    portENTER_CRITICAL(&_arbiter_lock);
+    if(_owner == SPI_ARBITER_NO_OWNER) {
+        _owner  = client;
+        granted = true;
+    } else {
+        _waiting[client]++;
+    }
+    portEXIT_CRITICAL(&_arbiter_lock);
+
+    // The releasing client makes us the owner before giving the semaphore
+    if(!granted) {
+        xSemaphoreTake(_grant_sem[client], portMAX_DELAY);
+    }
+
+    int64_t now_us   = esp_timer_get_time();
+    uint32_t wait_us = (uint32_t) (now_us - requested_at_us);
+
+    portENTER_CRITICAL(&_arbiter_lock);
+    _acquired_at_us = now_us;
+    _stats[client].acquisitions++;
+    _stats[client].total_wait_us += wait_us;
+    if(!granted) {
+        _stats[client].contended++;
+    }
+    if(wait_us > _stats[client].max_wait_us) {
+        _stats[client].max_wait_us = wait_us;
+    }
+    portEXIT_CRITICAL(&_arbiter_lock);
+
+    return ESP_OK;
+}
+
+void spi_arbiter_release(spi_arbiter_client_t client) {
+    if(!_is_initialized || client >= SPI_ARBITER_CLIENT_COUNT) {
+        return;
+    }
+
+    spi_arbiter_client_t next = SPI_ARBITER_NO_OWNER;
+    uint32_t hold_us          = (uint32_t) (esp_timer_get_time() - _acquired_at_us);
+
+    portENTER_CRITICAL(&_arbiter_lock);
+    if(_owner != client) {
+        portEXIT_CRITICAL(&_arbiter_lock);
+        ESP_LOGW(TAG, "Client %d released a bus it does not own", client);
+        return;
+    }
+
+    if(hold_us > _stats[client].max_hold_us) {
+        _stats[client].max_hold_us = hold_us;
+    }
+
+    // Hand the bus over to the highest priority waiter
+    for(int candidate = 0; candidate < SPI_ARBITER_CLIENT_COUNT; candidate++) {
+        if(_waiting[candidate] > 0) {
+            _waiting[candidate]--;
+            next = (spi_arbiter_client_t) candidate;
+            break;
+        }
+    }
+    _owner = next;
+    portEXIT_CRITICAL(&_arbiter_lock);
+
+    if(next != SPI_ARBITER_NO_OWNER) {
+        xSemaphoreGive(_grant_sem[next]);
+    }
+}
+
+esp_err_t spi_arbiter_get_stats(spi_arbiter_client_t client, spi_arbiter_stats_t *stats) {
+    if(client >= SPI_ARBITER_CLIENT_COUNT || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&_arbiter_lock);
+    memcpy(stats, &_stats[client], sizeof(spi_arbiter_stats_t));
+    portEXIT_CRITICAL(&_arbiter_lock);
+
+    return ESP_OK;
+}
+
+void spi_arbiter_reset_stats(void) {
+    portENTER_CRITICAL(&_arbiter_lock);
+    memset(_stats, 0, sizeof(_stats));
+    portEXIT_CRITICAL(&_arbiter_lock);
+}
+
+//---------------------------- PRIVATE FUNCTIONS ------------------------------
+
+//---------------------------- INTERRUPT HANDLERS -----------------------------
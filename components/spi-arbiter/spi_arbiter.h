@@ -0,0 +1,93 @@
+/**
+ * @file spi_arbiter.h
+ * 
+ * @brief Priority arbitration of the shared VSPI bus between the display and the sensors.
+ * 
+ */
+
+#ifndef SPI_ARBITER_H
+#define SPI_ARBITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------- INCLUDES ----------------------------------
+#include <stdint.h>
+#include "esp_err.h"
+
+//---------------------------------- MACROS -----------------------------------
+
+//-------------------------------- DATA TYPES ---------------------------------
+/**
+  * @brief Bus clients in descending priority order.
+  *
+  */
+typedef enum {
+    SPI_ARBITER_CLIENT_SENSOR,  // Short accelerometer transactions, latency critical
+    SPI_ARBITER_CLIENT_TOUCH,   // XPT2046 touch controller polls, a few bytes each
+    SPI_ARBITER_CLIENT_DISPLAY, // Display flush chunks, throughput oriented
+
+    SPI_ARBITER_CLIENT_COUNT
+} spi_arbiter_client_t;
+
+/**
+  * @brief Per-client bus usage statistics.
+  *
+  */
+typedef struct {
+    uint32_t acquisitions;  // Number of times the bus was granted
+    uint32_t contended;     // Grants that had to wait for another client
+    uint32_t max_wait_us;   // Worst-case time from request to grant
+    uint64_t total_wait_us; // Sum of all waiting times
+    uint32_t max_hold_us;   // Longest time the client kept the bus
+} spi_arbiter_stats_t;
+
+//---------------------- PUBLIC FUNCTION PROTOTYPES --------------------------
+/**
+  * @brief Initialize the arbiter, must be called before the display and the sensors are started.
+  *
+  * @return esp_err_t ESP_OK on success, fail otherwise.
+  */
+esp_err_t spi_arbiter_init(void);
+
+/**
+  * @brief Block until the bus is granted to the client.
+  *
+  * When the bus is released it is handed to the highest priority waiting client,
+  * so a sensor request never waits for more than the transaction currently in flight.
+  * Arbitration is bypassed until spi_arbiter_init() has been called.
+  *
+  * @param [in] client Requesting client.
+  *
+  * @return esp_err_t ESP_OK once the bus is owned, ESP_ERR_INVALID_ARG for an unknown client.
+  */
+esp_err_t spi_arbiter_acquire(spi_arbiter_client_t client);
+
+/**
+  * @brief Release the bus previously granted with spi_arbiter_acquire().
+  *
+  * @param [in] client Client that owns the bus.
+  */
+void spi_arbiter_release(spi_arbiter_client_t client);
+
+/**
+  * @brief Get a copy of the usage statistics of a client.
+  *
+  * @param [in] client Client to query.
+  * @param [out] stats Statistics copy.
+  *
+  * @return esp_err_t ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown client or NULL stats.
+  */
+esp_err_t spi_arbiter_get_stats(spi_arbiter_client_t client, spi_arbiter_stats_t *stats);
+
+/**
+  * @brief Clear the usage statistics of all clients.
+  */
+void spi_arbiter_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPI_ARBITER_H
@@ -15,15 +15,22 @@
 #include <esp_idf_lib_helpers.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <driver/mcpwm_cap.h>
+#include <esp_idf_version.h>
+#include <soc/soc.h>
 #include <esp_timer.h>
 #include <ets_sys.h>
+#include <stdlib.h>
 
 //---------------------------------- MACROS -----------------------------------
 #define TRIGGER_LOW_DELAY  4
 #define TRIGGER_HIGH_DELAY 10
 #define PING_TIMEOUT       6000
 #define ROUNDTRIP_M        5800.0f
-#define ROUNDTRIP_CM       58
+#define ROUNDTRIP_CM       ULTRASONIC_ROUNDTRIP_CM
+#define CAPTURE_GROUPS     2  // MCPWM groups, each with one capture timer and three channels
+#define CAPTURE_MARGIN_MS  10 // Extra wait of the blocking measurement on top of the timeouts
 
 #define PORT_ENTER_CRITICAL         portENTER_CRITICAL(&mux)
 #define PORT_EXIT_CRITICAL          portEXIT_CRITICAL(&mux)
@@ -50,10 +57,44 @@
 
 
 //-------------------------------- DATA TYPES ---------------------------------
+struct ultrasonic_capture_s {
+    gpio_num_t trigger_pin;
+    gpio_num_t echo_pin;
+    mcpwm_cap_channel_handle_t channel;
+    int group; // MCPWM group of the channel
+    esp_timer_handle_t timeout_timer;
+    SemaphoreHandle_t done; // Given by the blocking measurement callback
+    portMUX_TYPE lock;
+
+    // Ping in flight, owned by the ISR and the timeout once busy is set
+    volatile bool busy;
+    bool echo_started;
+    uint32_t echo_start_ticks;
+    int64_t echo_start_us;
+    int64_t ping_start_us;
+    uint32_t max_time_us;
+    ultrasonic_capture_cb_t cb;
+    void *cb_arg;
+
+    ultrasonic_capture_result_t result; // Result of the blocking measurement
+};
+
+//---------------------- PRIVATE FUNCTION PROTOTYPES --------------------------
+static bool echo_capture_isr(mcpwm_cap_channel_handle_t channel, const mcpwm_capture_event_data_t *edata, void *arg);
+static void echo_timeout_cb(void *arg);
+static bool capture_blocking_cb(const ultrasonic_capture_result_t *result, void *arg);
+static void capture_release(ultrasonic_capture_handle_t handle);
+static esp_err_t cap_timer_acquire(int group);
+static void cap_timer_release(int group);
 
 //------------------------- STATIC DATA & CONSTANTS ---------------------------
 static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
 
+// Capture timer per group, shared by all hardware timed sensors of that group
+static mcpwm_cap_timer_handle_t cap_timer[CAPTURE_GROUPS] = { NULL };
+static int cap_timer_users[CAPTURE_GROUPS]                = { 0 };
+static uint32_t cap_ticks_per_us                          = 0;
+
 //------------------------------- GLOBAL DATA ---------------------------------
 
 //------------------------------ PUBLIC FUNCTIONS -----------------------------
@@ -69,6 +110,13 @@ esp_err_t ultrasonic_init(const ultrasonic_sensor_t *dev) {
 
 
 esp_err_t ultrasonic_measure_raw(const ultrasonic_sensor_t *dev, uint32_t max_time_us, uint32_t *time_us) {
+    return ultrasonic_measure_raw_at(dev, max_time_us, time_us, NULL);
+}
+
+esp_err_t ultrasonic_measure_raw_at(const ultrasonic_sensor_t *dev,
+        uint32_t max_time_us,
+        uint32_t *time_us,
+        int64_t *capture_us) {
     CHECK_ARG(dev && time_us);
 
     PORT_ENTER_CRITICAL;
@@ -103,6 +151,10 @@ esp_err_t ultrasonic_measure_raw(const ultrasonic_sensor_t *dev, uint32_t max_ti
 
     *time_us = time - echo_start;
 
+    // The burst reached the target halfway through the round trip
+    if(capture_us)
+        *capture_us = echo_start + *time_us / 2;
+
     return ESP_OK;
 }
 
@@ -117,14 +169,307 @@ esp_err_t ultrasonic_measure(const ultrasonic_sensor_t *dev, float max_distance,
 }
 
 esp_err_t ultrasonic_measure_cm(const ultrasonic_sensor_t *dev, uint32_t max_distance, uint32_t *distance) {
+    return ultrasonic_measure_cm_at(dev, max_distance, distance, NULL);
+}
+
+esp_err_t ultrasonic_measure_cm_at(const ultrasonic_sensor_t *dev,
+        uint32_t max_distance,
+        uint32_t *distance,
+        int64_t *capture_us) {
     CHECK_ARG(dev && distance);
 
     uint32_t time_us;
-    CHECK(ultrasonic_measure_raw(dev, max_distance * ROUNDTRIP_CM, &time_us));
+    CHECK(ultrasonic_measure_raw_at(dev, max_distance * ROUNDTRIP_CM, &time_us, capture_us));
     *distance = time_us / ROUNDTRIP_CM;
 
     return ESP_OK;
 }
+
+esp_err_t ultrasonic_capture_init(const ultrasonic_sensor_t *dev, ultrasonic_capture_handle_t *handle) {
+    CHECK_ARG(dev && handle);
+
+    ultrasonic_capture_handle_t h = calloc(1, sizeof(struct ultrasonic_capture_s));
+    if(h == NULL)
+        return ESP_ERR_NO_MEM;
+
+    h->trigger_pin = dev->trigger_pin;
+    h->echo_pin    = dev->echo_pin;
+    portMUX_INITIALIZE(&h->lock);
+
+    esp_err_t err = gpio_set_direction(dev->trigger_pin, GPIO_MODE_OUTPUT);
+    if(err == ESP_OK)
+        err = gpio_set_level(dev->trigger_pin, 0);
+
+    // Fill the first group, the next one is only powered once its channels are needed
+    mcpwm_capture_channel_config_t channel_config = {
+        .gpio_num       = dev->echo_pin,
+        .prescale       = 1,
+        .flags.pos_edge = true,
+        .flags.neg_edge = true,
+    };
+    for(int group = 0; err == ESP_OK && h->channel == NULL && group < CAPTURE_GROUPS; group++) {
+        err = cap_timer_acquire(group);
+        if(err != ESP_OK)
+            break;
+
+        err = mcpwm_new_capture_channel(cap_timer[group], &channel_config, &h->channel);
+        if(err == ESP_OK) {
+            h->group = group;
+        } else {
+            cap_timer_release(group);
+            if(err == ESP_ERR_NOT_FOUND)
+                err = ESP_OK; // All channels of the group taken, try the next one
+        }
+    }
+    if(err == ESP_OK && h->channel == NULL)
+        err = ESP_ERR_NOT_FOUND;
+    if(err == ESP_OK) {
+        mcpwm_capture_event_callbacks_t callbacks = { .on_cap = echo_capture_isr };
+        err = mcpwm_capture_channel_register_event_callbacks(h->channel, &callbacks, h);
+    }
+    if(err == ESP_OK)
+        err = mcpwm_capture_channel_enable(h->channel);
+
+    if(err == ESP_OK) {
+        esp_timer_create_args_t timer_args = {
+            .callback        = echo_timeout_cb,
+            .arg             = h,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name            = "ultrasonic",
+        };
+        err = esp_timer_create(&timer_args, &h->timeout_timer);
+    }
+    if(err == ESP_OK) {
+        h->done = xSemaphoreCreateBinary();
+        if(h->done == NULL)
+            err = ESP_ERR_NO_MEM;
+    }
+
+    if(err != ESP_OK) {
+        capture_release(h);
+        return err;
+    }
+
+    *handle = h;
+    return ESP_OK;
+}
+
+esp_err_t ultrasonic_capture_deinit(ultrasonic_capture_handle_t handle) {
+    CHECK_ARG(handle);
+
+    if(handle->busy)
+        return ESP_ERR_ULTRASONIC_PING;
+
+    capture_release(handle);
+    return ESP_OK;
+}
+
+esp_err_t ultrasonic_capture_start(ultrasonic_capture_handle_t handle,
+        uint32_t max_time_us,
+        ultrasonic_capture_cb_t cb,
+        void *arg) {
+    CHECK_ARG(handle && cb);
+
+    // Previous ping isn't ended
+    if(gpio_get_level(handle->echo_pin))
+        return ESP_ERR_ULTRASONIC_PING;
+
+    portENTER_CRITICAL(&handle->lock);
+    if(handle->busy) {
+        portEXIT_CRITICAL(&handle->lock);
+        return ESP_ERR_ULTRASONIC_PING;
+    }
+    handle->busy          = true;
+    handle->echo_started  = false;
+    handle->max_time_us   = max_time_us;
+    handle->cb            = cb;
+    handle->cb_arg        = arg;
+    handle->ping_start_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&handle->lock);
+
+    // A timeout left over from a previous ping must not complete this one
+    esp_timer_stop(handle->timeout_timer);
+    esp_timer_start_once(handle->timeout_timer, PING_TIMEOUT + max_time_us);
+
+    // Ping: Low for 2..4 us, then high 10 us, the edges are timed by the capture unit
+    gpio_set_level(handle->trigger_pin, 0);
+    ets_delay_us(TRIGGER_LOW_DELAY);
+    gpio_set_level(handle->trigger_pin, 1);
+    ets_delay_us(TRIGGER_HIGH_DELAY);
+    gpio_set_level(handle->trigger_pin, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t ultrasonic_capture_measure_cm(ultrasonic_capture_handle_t handle,
+        uint32_t max_distance,
+        uint32_t *distance,
+        int64_t *capture_us) {
+    CHECK_ARG(handle && distance);
+
+    uint32_t max_time_us = max_distance * ROUNDTRIP_CM;
+
+    xSemaphoreTake(handle->done, 0);
+    CHECK(ultrasonic_capture_start(handle, max_time_us, capture_blocking_cb, handle));
+
+    // The timeout always completes the ping, the margin only covers a stalled esp_timer task
+    TickType_t wait = pdMS_TO_TICKS((PING_TIMEOUT + max_time_us) / 1000 + CAPTURE_MARGIN_MS);
+    if(xSemaphoreTake(handle->done, wait) != pdTRUE)
+        return ESP_ERR_TIMEOUT;
+
+    CHECK(handle->result.err);
+    *distance = handle->result.time_us / ROUNDTRIP_CM;
+    if(capture_us)
+        *capture_us = handle->result.capture_us;
+
+    return ESP_OK;
+}
 //---------------------------- PRIVATE FUNCTIONS ------------------------------
 
+/**
+ * @brief Report the result of the ping in flight, called by whoever cleared busy
+ */
+static bool IRAM_ATTR capture_complete(ultrasonic_capture_handle_t handle,
+        esp_err_t err,
+        uint32_t time_us,
+        int64_t capture_us) {
+    ultrasonic_capture_result_t result = { .err = err, .time_us = time_us, .capture_us = capture_us };
+    return handle->cb(&result, handle->cb_arg);
+}
+
+static void echo_timeout_cb(void *arg) {
+    ultrasonic_capture_handle_t handle = arg;
+
+    portENTER_CRITICAL(&handle->lock);
+    // Ignore a timeout that was already pending when the next ping started
+    if(!handle->busy || esp_timer_get_time() - handle->ping_start_us < PING_TIMEOUT + handle->max_time_us) {
+        portEXIT_CRITICAL(&handle->lock);
+        return;
+    }
+    esp_err_t err = handle->echo_started ? ESP_ERR_ULTRASONIC_ECHO_TIMEOUT : ESP_ERR_ULTRASONIC_PING_TIMEOUT;
+    handle->busy  = false;
+    portEXIT_CRITICAL(&handle->lock);
+
+    capture_complete(handle, err, 0, 0);
+}
+
+static bool IRAM_ATTR capture_blocking_cb(const ultrasonic_capture_result_t *result, void *arg) {
+    ultrasonic_capture_handle_t handle = arg;
+    BaseType_t woken                   = pdFALSE;
+
+    handle->result = *result;
+    if(xPortInIsrContext()) {
+        xSemaphoreGiveFromISR(handle->done, &woken);
+    } else {
+        xSemaphoreGive(handle->done);
+    }
+
+    return woken == pdTRUE;
+}
+
+static void capture_release(ultrasonic_capture_handle_t handle) {
+    if(handle->channel) {
+        mcpwm_capture_channel_disable(handle->channel);
+        mcpwm_del_capture_channel(handle->channel);
+        cap_timer_release(handle->group);
+    }
+    if(handle->timeout_timer) {
+        esp_timer_stop(handle->timeout_timer);
+        esp_timer_delete(handle->timeout_timer);
+    }
+    if(handle->done)
+        vSemaphoreDelete(handle->done);
+
+    free(handle);
+}
+
+/**
+ * @brief Take a reference on the capture timer of a group, starting it for the first user
+ *
+ * The timer free-runs from then on, channels only latch its value.
+ */
+static esp_err_t cap_timer_acquire(int group) {
+    if(cap_timer[group] == NULL) {
+        mcpwm_capture_timer_config_t timer_config = {
+            .group_id = group,
+            .clk_src  = MCPWM_CAPTURE_CLK_SRC_DEFAULT,
+        };
+        esp_err_t err = mcpwm_new_capture_timer(&timer_config, &cap_timer[group]);
+        if(err == ESP_OK)
+            err = mcpwm_capture_timer_enable(cap_timer[group]);
+        if(err == ESP_OK)
+            err = mcpwm_capture_timer_start(cap_timer[group]);
+        if(err != ESP_OK) {
+            if(cap_timer[group]) {
+                mcpwm_capture_timer_disable(cap_timer[group]);
+                mcpwm_del_capture_timer(cap_timer[group]);
+                cap_timer[group] = NULL;
+            }
+            return err;
+        }
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+        uint32_t resolution_hz = 0;
+        mcpwm_capture_timer_get_resolution(cap_timer[group], &resolution_hz);
+#else
+        // Before 5.1 the capture timer always counts APB, which the driver's PM lock holds at full speed
+        uint32_t resolution_hz = APB_CLK_FREQ;
+#endif
+        cap_ticks_per_us = resolution_hz / 1000000;
+    }
+
+    cap_timer_users[group]++;
+    return ESP_OK;
+}
+
+/**
+ * @brief Drop a reference on the capture timer of a group, the last user stops it
+ */
+static void cap_timer_release(int group) {
+    if(--cap_timer_users[group] > 0)
+        return;
+
+    mcpwm_capture_timer_stop(cap_timer[group]);
+    mcpwm_capture_timer_disable(cap_timer[group]);
+    mcpwm_del_capture_timer(cap_timer[group]);
+    cap_timer[group] = NULL;
+}
+
 //---------------------------- INTERRUPT HANDLERS -----------------------------
+
+/**
+ * @brief Echo edge latched by the capture unit
+ */
+static bool IRAM_ATTR echo_capture_isr(mcpwm_cap_channel_handle_t channel,
+        const mcpwm_capture_event_data_t *edata,
+        void *arg) {
+    ultrasonic_capture_handle_t handle = arg;
+
+    portENTER_CRITICAL_ISR(&handle->lock);
+    if(!handle->busy) {
+        portEXIT_CRITICAL_ISR(&handle->lock);
+        return false;
+    }
+
+    if(edata->cap_edge == MCPWM_CAP_EDGE_POS) {
+        handle->echo_start_ticks = edata->cap_value;
+        handle->echo_start_us    = esp_timer_get_time();
+        handle->echo_started     = true;
+        portEXIT_CRITICAL_ISR(&handle->lock);
+        return false;
+    }
+
+    if(!handle->echo_started) {
+        portEXIT_CRITICAL_ISR(&handle->lock);
+        return false;
+    }
+
+    // Unsigned difference of the capture values is exact across a timer wrap
+    uint32_t time_us = (edata->cap_value - handle->echo_start_ticks) / cap_ticks_per_us;
+    esp_err_t err    = time_us > handle->max_time_us ? ESP_ERR_ULTRASONIC_ECHO_TIMEOUT : ESP_OK;
+    handle->busy     = false;
+    portEXIT_CRITICAL_ISR(&handle->lock);
+
+    // The burst reached the target halfway through the round trip
+    return capture_complete(handle, err, time_us, handle->echo_start_us + time_us / 2);
+}
@@ -9,6 +9,7 @@
 
 #include <driver/gpio.h>
 #include <esp_err.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,6 +19,8 @@ extern "C" {
 #define ESP_ERR_ULTRASONIC_PING_TIMEOUT 0x201
 #define ESP_ERR_ULTRASONIC_ECHO_TIMEOUT 0x202
 
+#define ULTRASONIC_ROUNDTRIP_CM 58 //!< Echo time in us per cm of distance
+
 /**
  * Device descriptor
  */
@@ -26,6 +29,32 @@ typedef struct {
     gpio_num_t echo_pin;    //!< GPIO input pin for echo
 } ultrasonic_sensor_t;
 
+/**
+ * Handle of a sensor measured by the MCPWM capture unit
+ */
+typedef struct ultrasonic_capture_s *ultrasonic_capture_handle_t;
+
+/**
+ * Result of a hardware timed measurement
+ */
+typedef struct {
+    esp_err_t err;      //!< `ESP_OK` or one of the ESP_ERR_ULTRASONIC_* codes
+    uint32_t time_us;   //!< Time between ping and echo, us
+    int64_t capture_us; //!< esp_timer time at which the burst reached the target
+} ultrasonic_capture_result_t;
+
+/**
+ * @brief Completion callback of ultrasonic_capture_start()
+ *
+ * Runs in the capture ISR when the echo ends, or in the esp_timer task when the
+ * measurement times out. Use xPortInIsrContext() to pick the right FreeRTOS API.
+ *
+ * @param result Measurement result
+ * @param arg User argument
+ * @return true if a higher priority task was woken
+ */
+typedef bool (*ultrasonic_capture_cb_t)(const ultrasonic_capture_result_t *result, void *arg);
+
 /**
  * @brief Init ranging module
  *
@@ -47,6 +76,20 @@ esp_err_t ultrasonic_init(const ultrasonic_sensor_t *dev);
  */
 esp_err_t ultrasonic_measure_raw(const ultrasonic_sensor_t *dev, uint32_t max_time_us, uint32_t *time_us);
 
+/**
+ * @brief Measure time between ping and echo and report when the measurement was taken
+ *
+ * @param dev Pointer to the device descriptor
+ * @param max_time_us Maximal time to wait for echo
+ * @param[out] time_us Time, us
+ * @param[out] capture_us Optional, esp_timer time at which the burst reached the target
+ * @return `ESP_OK` on success, otherwise see ultrasonic_measure_raw()
+ */
+esp_err_t ultrasonic_measure_raw_at(const ultrasonic_sensor_t *dev,
+        uint32_t max_time_us,
+        uint32_t *time_us,
+        int64_t *capture_us);
+
 /**
  * @brief Measure distance in meters
  *
@@ -73,6 +116,71 @@ esp_err_t ultrasonic_measure(const ultrasonic_sensor_t *dev, float max_distance,
  */
 esp_err_t ultrasonic_measure_cm(const ultrasonic_sensor_t *dev, uint32_t max_distance, uint32_t *distance);
 
+/**
+ * @brief Measure distance in centimeters and report when the measurement was taken
+ *
+ * @param dev Pointer to the device descriptor
+ * @param max_distance Maximal distance to measure, centimeters
+ * @param[out] distance Distance in centimeters
+ * @param[out] capture_us Optional, esp_timer time at which the burst reached the target
+ * @return `ESP_OK` on success, otherwise see ultrasonic_measure_cm()
+ */
+esp_err_t ultrasonic_measure_cm_at(const ultrasonic_sensor_t *dev,
+        uint32_t max_distance,
+        uint32_t *distance,
+        int64_t *capture_us);
+
+/**
+ * @brief Init ranging module for hardware timed measurements
+ *
+ * The echo edges are timestamped by the MCPWM capture unit, a measurement costs
+ * two short interrupts instead of busy-waiting with interrupts disabled.
+ * Sensors share the capture timer of an MCPWM group, up to six sensors can be
+ * attached, three per group.
+ *
+ * @param dev Pointer to the device descriptor
+ * @param[out] handle Handle of the sensor
+ * @return `ESP_OK` on success
+ */
+esp_err_t ultrasonic_capture_init(const ultrasonic_sensor_t *dev, ultrasonic_capture_handle_t *handle);
+
+/**
+ * @brief Release a sensor initialized with ultrasonic_capture_init()
+ *
+ * @param handle Handle of the sensor
+ * @return `ESP_OK` on success
+ */
+esp_err_t ultrasonic_capture_deinit(ultrasonic_capture_handle_t handle);
+
+/**
+ * @brief Send a ping and return immediately, the result is reported to the callback
+ *
+ * @param handle Handle of the sensor
+ * @param max_time_us Maximal time to wait for echo
+ * @param cb Completion callback
+ * @param arg User argument for the callback
+ * @return `ESP_OK` if the ping was sent, otherwise:
+ *         - ::ESP_ERR_ULTRASONIC_PING - Invalid state (previous ping is not ended)
+ */
+esp_err_t ultrasonic_capture_start(ultrasonic_capture_handle_t handle,
+        uint32_t max_time_us,
+        ultrasonic_capture_cb_t cb,
+        void *arg);
+
+/**
+ * @brief Measure distance in centimeters, blocks the calling task until the echo ends
+ *
+ * @param handle Handle of the sensor
+ * @param max_distance Maximal distance to measure, centimeters
+ * @param[out] distance Distance in centimeters
+ * @param[out] capture_us Optional, esp_timer time at which the burst reached the target
+ * @return `ESP_OK` on success, otherwise see ultrasonic_measure_cm()
+ */
+esp_err_t ultrasonic_capture_measure_cm(ultrasonic_capture_handle_t handle,
+        uint32_t max_distance,
+        uint32_t *distance,
+        int64_t *capture_us);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/i2c.h"
+#include "nvs_flash.h"
 
 #include "gui/gui.h"
 #include "LIS2DH12TR.h"
@@ -26,13 +27,16 @@
 #include "door_detector.h"
 #include "speed_estimator.h"
 #include "crash_detector.h"
+#include "crash_recorder.h"
 
 #include "i2cdev.h"
-#include "pcf8574.h"
+#include "i2c_scheduler.h"
+#include "expander_service.h"
 #include "speaker.h"
 #include "my_mqtt.h"
 #include "gui_controller.h"
 #include "acc_data_provider.h"
+#include "spi_arbiter.h"
 
 
 /*******************************************************************************/
@@ -44,8 +48,9 @@
 #define SDA_GPIO          GPIO_NUM_22 // Check schematic if different
 #define SCL_GPIO          GPIO_NUM_21
 
-i2c_dev_t expander;
-uint8_t expander_state;
+// Devices on the shared I2C bus without an address macro in their driver
+#define SHT3X_I2C_ADDR  0x44 // ADDR pin low, check schematic if different
+#define EEPROM_I2C_ADDR 0x50 // AT24C32, same as registered in my_sntp.c
 
 #define TAG                  "MAIN"
 #define TEMP_TASK_STACK_SIZE 2048
@@ -69,6 +74,20 @@ uint8_t expander_state;
 /*                          STATIC DATA & CONSTANTS                            */
 /*******************************************************************************/
 
+// Bus classes and queueing deadlines, the expander carries the crash signal and the door inputs
+static const struct {
+    uint8_t addr;
+    const char *name;
+    i2c_scheduler_priority_t priority;
+    uint32_t deadline_us;
+} _i2c_devices[] = {
+    { EXPANDER_I2C_ADDR, "PCF8574", I2C_SCHEDULER_PRIO_SAFETY, 2000 },
+    { VEML7700_I2C_ADDR, "VEML7700", I2C_SCHEDULER_PRIO_SENSOR, 50000 },
+    { SHT3X_I2C_ADDR, "SHT3x", I2C_SCHEDULER_PRIO_SENSOR, 100000 },
+    { PCF8523_I2C_ADDR, "PCF8523", I2C_SCHEDULER_PRIO_BACKGROUND, 500000 },
+    { EEPROM_I2C_ADDR, "AT24C32", I2C_SCHEDULER_PRIO_BACKGROUND, 1000000 },
+};
+
 static const i2c_config_t _i2c_config = {
     .mode             = I2C_MODE_MASTER,
     .scl_io_num       = GPIO_NUM_21,
@@ -90,10 +109,26 @@ TaskHandle_t audio_task_handle;
 void initialization_peripheral_creator() {
     ESP_LOGI(TAG, "System boot...");
 
+    // --- NVS, holds the crash record and the light sensor range across boots ---
+    esp_err_t nvs_ret = nvs_flash_init();
+    if(nvs_ret == ESP_ERR_NVS_NO_FREE_PAGES || nvs_ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        nvs_ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(nvs_ret);
 
     // --- Init i2cdev mutex system (MUST come before any pcf8574 or other i2cdev use) ---
     i2cdev_init();
 
+    // --- I2C bus scheduler, every device on port 0 queues its transactions here ---
+    ESP_ERROR_CHECK(i2c_scheduler_init());
+    for(size_t i = 0; i < sizeof(_i2c_devices) / sizeof(_i2c_devices[0]); i++) {
+        i2c_scheduler_register(_i2c_devices[i].addr,
+                _i2c_devices[i].name,
+                _i2c_devices[i].priority,
+                _i2c_devices[i].deadline_us);
+    }
+
     // --- I2C Master Init ---
     ESP_LOGI(TAG, "Initializing I2C master...");
     esp_err_t i2c_ret;
@@ -110,22 +145,13 @@ void initialization_peripheral_creator() {
         return;
     }
 
-    // --- PCF8574 I/O Expander Init ---
-    esp_err_t err = pcf8574_init_desc(&expander, EXPANDER_I2C_ADDR, I2C_PORT, SDA_GPIO, SCL_GPIO);
-    if(err != ESP_OK) {
-        ESP_LOGE("EXPANDER", "Failed to init PCF8574 descriptor: %s", esp_err_to_name(err));
-        return;
-    }
-
-    expander_state = 0x00;
-    err            = pcf8574_port_write(&expander, expander_state); // Set all I/O expander pins LOW
+    // --- PCF8574 I/O Expander Init, all pins LOW until their users claim them ---
+    esp_err_t err = expander_service_init(EXPANDER_I2C_ADDR, I2C_PORT, SDA_GPIO, SCL_GPIO, 0x00);
     if(err != ESP_OK) {
-        ESP_LOGE("EXPANDER", "Failed to write to PCF8574: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to init I/O expander: %s", esp_err_to_name(err));
         return;
     }
 
-    ESP_LOGI("EXPANDER", "PCF8574 initialized and all pins set LOW");
-
     // --- Start I2C Temperature/Humidity Sensor ---
     if(sht3x_start_periodic_measurement() != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start SHT3x periodic measurement!");
@@ -135,6 +161,9 @@ void initialization_peripheral_creator() {
     ESP_ERROR_CHECK(mqtt_client_init());
     vTaskDelay(pdMS_TO_TICKS(3000));
 
+    // --- SPI bus arbiter, shared by the display and the accelerometer ---
+    ESP_ERROR_CHECK(spi_arbiter_init());
+
     // --- Initialize UI + perf monitor ---
     gui_init();
     //perfmon_start();
@@ -158,6 +187,9 @@ void initialization_peripheral_creator() {
 
     ESP_LOGI(TAG, "Accelerometer data provider started successfully");
 
+    // --- Buzzer pattern engine, shared by the parking beeps and the crash alarm ---
+    ESP_ERROR_CHECK(buzzer_init());
+
     i2s_dac_init();
 
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -174,8 +206,10 @@ void initailization_task_creator() {
     vTaskDelay(pdMS_TO_TICKS(2000));
 
     // --- Crash detector ---
+    ESP_ERROR_CHECK(crash_recorder_init());
     ESP_ERROR_CHECK(crash_detector_init());
     ESP_ERROR_CHECK(speed_estimator_init());
+    xTaskCreatePinnedToCore(crash_recorder_task, "crash_recorder", 4096, NULL, 6, NULL, 0);
     xTaskCreatePinnedToCore(crash_detector_task, "crash_detector", 4096, NULL, 9, NULL, 0);
     vTaskDelay(pdMS_TO_TICKS(1000));
     xTaskCreatePinnedToCore(audio_task, "audioTask", 4096, NULL, 9, NULL, 0);